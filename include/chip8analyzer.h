@@ -0,0 +1,84 @@
+#ifndef CHIP8ANALYZER_H
+#define CHIP8ANALYZER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+// control flow analysis of a CHIP-8 image by recursive traversal from its entry point
+// code is followed along JP, CALL and skip edges, bytes which are only reached as sprites (LD I, addr + DRW)
+// or memory operands are marked as data, bytes which are never reached are left unknown (which is data as well)
+// NOTE SCHIP and XO-CHIP commands are followed as well, s.t. code of extended programmes is found
+// NOTE all tables are flat arrays over the image, so images of XO-CHIP size (64K) are analyzed in linear time
+class chip8analyzer
+{
+public:
+    enum flag : uint8_t
+    {
+        UNKNOWN  = 0x00,
+        CODE     = 0x01, // first byte of a command
+        OPERAND  = 0x02, // second byte of a command
+        DATA     = 0x04, // referenced as sprite or memory operand
+        LEADER   = 0x08, // first command of a basic block
+        FUNCTION = 0x10, // entry point of programme or target of CALL
+        TARGET   = 0x20, // target of JP or JP V0, addr
+    };
+
+    struct block
+    {
+        uint32_t start;               // address of first command
+        uint32_t end;                 // address behind last command
+        std::vector<uint32_t> succ;   // addresses of successor blocks
+    };
+
+    struct call
+    {
+        uint32_t caller;              // entry of calling function
+        uint32_t site;                // address of CALL command
+        uint32_t callee;              // entry of called function
+    };
+
+    chip8analyzer(const uint8_t *image, size_t len, uint32_t base = 0x200);
+    ~chip8analyzer() {};
+
+    void analyze();
+    void print(FILE *out) const;
+    void printSource(FILE *out) const;
+
+    uint8_t flags(uint32_t addr) const { return contains(addr) ? flagTable[addr - base] : uint8_t(UNKNOWN); }
+    bool contains(uint32_t addr) const { return addr >= base && addr - base < len; }
+    uint16_t word(uint32_t addr) const;
+    uint32_t length(uint32_t addr) const;
+
+    std::vector<block> blocks;        // sorted by start address
+    std::vector<call> calls;          // call graph edges, sorted by caller
+    size_t codeBytes;
+    size_t dataBytes;
+
+private:
+    struct item
+    {
+        uint32_t addr;
+        uint32_t function;            // function the address belongs to
+        int32_t I;                    // value of I if known, -1 otherwise
+    };
+
+    std::string label(uint32_t addr) const;
+    bool visit(uint32_t addr, int32_t I);
+    void traverse();
+    void buildBlocks();
+    void markData(int32_t I, uint32_t n);
+    void push(uint32_t addr, uint32_t function, int32_t I, uint8_t reason);
+
+    const uint8_t *image;
+    size_t len;
+    uint32_t base;
+    std::vector<uint8_t> flagTable;   // one entry per byte of image
+    std::vector<int32_t> knownI;      // value of I at the last visit of each command
+    std::vector<uint8_t> nVisits;     // number of visits of each command
+    std::vector<item> worklist;
+};
+
+#endif
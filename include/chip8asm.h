@@ -0,0 +1,303 @@
+#ifndef CHIP8ASM_H
+#define CHIP8ASM_H
+
+#include "chip8opcodes.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string_view>
+
+// compile time CHIP-8 assembler, accepts the same syntax as chip8assembler and emits the same machine code
+//
+//   constexpr auto rom = CHIP8_ASM(R"(
+//       LD V0, 0
+//   loop:
+//       ADD V0, 1
+//       SE V0, 10
+//       JP loop
+//   )");
+//
+// rom is a std::array<uint8_t, N> holding the big endian machine code as it is stored in CHIP-8 memory
+// NOTE C++17 can't derive N from a function parameter, so the macro computes it in a first pass,
+// chip8_asm<N>(src) can be used directly if the size is known
+// NOTE invalid sources abort compilation, the failing throw expression names the error
+struct chip8asm
+{
+    struct command
+    {
+        std::string_view marker;
+        std::string_view tok[4]; // mnemonic and up to 3 arguments
+        int ntok = 0;
+    };
+    struct marker
+    {
+        std::string_view name;
+        uint16_t addr = 0;
+    };
+
+    // NOTE the null check gives fail() a non-throwing path, which C++17 requires from constexpr functions
+    static constexpr bool fail(const char *msg) { return msg == nullptr ? false : throw std::logic_error(msg); }
+
+    static constexpr bool isSeparator(char c) { return c == ' ' || c == '\t' || c == '\r' || c == ','; }
+
+    // read next command from src starting at pos, lines holding only a marker are merged with the next command
+    static constexpr bool next(std::string_view src, size_t &pos, command &cmd)
+    {
+        cmd = command{};
+        while(pos < src.size())
+        {
+            size_t end = src.find('\n', pos);
+            if(end == std::string_view::npos) end = src.size();
+            std::string_view line = src.substr(pos, end - pos);
+            pos = end + 1;
+            line = line.substr(0, line.find('#'));
+            for(size_t i = 0; i < line.size();)
+            {
+                for(; i < line.size() && isSeparator(line[i]); ++i);
+                size_t start = i;
+                for(; i < line.size() && !isSeparator(line[i]); ++i);
+                if(i == start) continue;
+                std::string_view token = line.substr(start, i - start);
+                if(cmd.ntok == 0 && token.back() == ':')
+                {
+                    if(!cmd.marker.empty()) fail("only one marker per command allowed");
+                    cmd.marker = token.substr(0, token.size() - 1);
+                }
+                else
+                {
+                    if(cmd.ntok == 4) fail("too many arguments");
+                    cmd.tok[cmd.ntok++] = token;
+                }
+            }
+            if(cmd.ntok > 0) return true;
+        }
+        if(!cmd.marker.empty()) fail("marker without command at end of source");
+        return false;
+    }
+
+    static constexpr bool is(std::string_view token, std::string_view upper, std::string_view lower)
+    {
+        return token == upper || token == lower;
+    }
+
+    // DB with a single byte ends odd sized programmes, it occupies only 1 byte
+    static constexpr bool isSingleByte(const command &c) { return is(c.tok[0], "DB", "db") && c.ntok == 2; }
+
+    // number of bytes of machine code of src
+    static constexpr size_t size(std::string_view src)
+    {
+        size_t pos = 0, n = 0;
+        command cmd;
+        while(next(src, pos, cmd))
+        {
+            if(n & 1) fail("DB with a single byte is only allowed at the end of the programme");
+            n += isSingleByte(cmd) ? 1 : 2;
+        }
+        return n;
+    }
+
+    static constexpr bool isRegister(std::string_view arg) { return arg.front() == 'V' || arg.front() == 'v'; }
+
+    static constexpr int digit(char c)
+    {
+        if(c >= '0' && c <= '9') return c - '0';
+        if(c >= 'a' && c <= 'f') return c - 'a' + 10;
+        if(c >= 'A' && c <= 'F') return c - 'A' + 10;
+        return -1;
+    }
+
+    static constexpr long number(std::string_view s, int base)
+    {
+        if(s.empty()) fail("number expected");
+        long n = 0;
+        for(char c : s)
+        {
+            int d = digit(c);
+            if(d < 0 || d >= base) fail("invalid digit in number");
+            n = n * base + d;
+            if(n > 0xFFFF) fail("number out of range");
+        }
+        return n;
+    }
+
+    // registers are coded {V,v}0-{V,v}15 or {V,v}0-{V,v}F, same as chip8assembler::getRegister
+    static constexpr uint8_t reg(std::string_view arg)
+    {
+        if(!isRegister(arg)) fail("register expected");
+        std::string_view regno = arg.substr(1);
+        bool decimal = !regno.empty();
+        for(char c : regno) decimal = decimal && c >= '0' && c <= '9';
+        long r = number(regno, decimal ? 10 : 16);
+        if(r >= 16) fail("register out of range, registers range from V0-VF");
+        return r;
+    }
+
+    // constants are coded decimal or hexadecimal with prefix 0x, same as chip8assembler::getConst
+    static constexpr long constant(std::string_view arg)
+    {
+        if(arg.substr(0, 2) == "0x") return number(arg.substr(2), 16);
+        return number(arg, 10);
+    }
+
+    static constexpr uint8_t byte(std::string_view arg)
+    {
+        long b = constant(arg);
+        if(b > 0xFF) fail("constant is not representable by 1 byte");
+        return b;
+    }
+
+    static constexpr uint8_t nibble(std::string_view arg)
+    {
+        long n = constant(arg);
+        if(n > 0xF) fail("nibble is not representable by 4 bit");
+        return n;
+    }
+
+    // addresses are markers or hexadecimal with prefix 0x, same as chip8assembler::getAddress
+    template<size_t M>
+    static constexpr uint16_t addr(std::string_view name, const std::array<marker, M> &markers, size_t nmarkers)
+    {
+        for(size_t i = 0; i < nmarkers; ++i)
+            if(markers[i].name == name) return markers[i].addr;
+        if(name.substr(0, 2) == "0x")
+        {
+            long a = number(name.substr(2), 16);
+            if(a > 0xFFF) fail("address out of range, CHIP-8 only consists of 4K memory");
+            return a;
+        }
+        fail("marker is not defined");
+        return 0;
+    }
+
+    // encode one command, mirrors chip8assembler::assembleCommand
+    template<size_t M>
+    static constexpr uint16_t encode(const command &c, const std::array<marker, M> &markers, size_t nmarkers)
+    {
+        std::string_view m = c.tok[0];
+        int nargs = c.ntok - 1;
+        auto args = [nargs](int n) { if(nargs != n) fail("invalid number of arguments"); };
+        const std::string_view *a = c.tok;
+
+        if(is(m, "CLS", "cls")) { args(0); return chip8opcodes::CLS(); }
+        if(is(m, "RET", "ret")) { args(0); return chip8opcodes::RET(); }
+        if(is(m, "SYS", "sys")) fail("mnemonic SYS is not supported with this version of CHIP-8");
+        if(is(m, "JP", "jp"))
+        {
+            if(nargs == 1 && !isRegister(a[1])) return chip8opcodes::JP_addr(addr(a[1], markers, nmarkers));
+            args(2);
+            if(reg(a[1]) != 0) fail("JP with 2 arguments requires V0 as first argument");
+            return chip8opcodes::JP_V0_addr(addr(a[2], markers, nmarkers));
+        }
+        if(is(m, "CALL", "call")) { args(1); return chip8opcodes::CALL_addr(addr(a[1], markers, nmarkers)); }
+        if(is(m, "SE", "se"))
+        {
+            args(2);
+            if(isRegister(a[2])) return chip8opcodes::SE_Vx_Vy(reg(a[1]), reg(a[2]));
+            return chip8opcodes::SE_Vx_byte(reg(a[1]), byte(a[2]));
+        }
+        if(is(m, "SNE", "sne"))
+        {
+            args(2);
+            if(isRegister(a[2])) return chip8opcodes::SNE_Vx_Vy(reg(a[1]), reg(a[2]));
+            return chip8opcodes::SNE_Vx_byte(reg(a[1]), byte(a[2]));
+        }
+        if(is(m, "LD", "ld"))
+        {
+            args(2);
+            if(a[1] == "I") return chip8opcodes::LD_I_addr(addr(a[2], markers, nmarkers));
+            if(isRegister(a[1]))
+            {
+                uint8_t x = reg(a[1]);
+                if(isRegister(a[2])) return chip8opcodes::LD_Vx_Vy(x, reg(a[2]));
+                if(is(a[2], "DT", "dt")) return chip8opcodes::LD_Vx_DT(x);
+                if(is(a[2], "K", "k")) return chip8opcodes::LD_Vx_K(x);
+                if(is(a[2], "[I]", "[i]")) return chip8opcodes::LD_Vx_I(x);
+                return chip8opcodes::LD_Vx_byte(x, byte(a[2]));
+            }
+            uint8_t x = reg(a[2]);
+            if(is(a[1], "DT", "dt")) return chip8opcodes::LD_DT_Vx(x);
+            if(is(a[1], "ST", "st")) return chip8opcodes::LD_ST_Vx(x);
+            if(is(a[1], "F", "f")) return chip8opcodes::LD_F_Vx(x);
+            if(is(a[1], "B", "b")) return chip8opcodes::LD_B_Vx(x);
+            if(is(a[1], "[I]", "[i]")) return chip8opcodes::LD_I_Vx(x);
+            fail("invalid arguments passed to LD");
+        }
+        if(is(m, "ADD", "add"))
+        {
+            args(2);
+            if(a[1] == "I") return chip8opcodes::ADD_I_Vx(reg(a[2]));
+            if(isRegister(a[2])) return chip8opcodes::ADD_Vx_Vy(reg(a[1]), reg(a[2]));
+            return chip8opcodes::ADD_Vx_byte(reg(a[1]), byte(a[2]));
+        }
+        if(is(m, "OR", "or")) { args(2); return chip8opcodes::OR_Vx_Vy(reg(a[1]), reg(a[2])); }
+        if(is(m, "AND", "and")) { args(2); return chip8opcodes::AND_Vx_Vy(reg(a[1]), reg(a[2])); }
+        if(is(m, "XOR", "xor")) { args(2); return chip8opcodes::XOR_Vx_Vy(reg(a[1]), reg(a[2])); }
+        if(is(m, "SUB", "sub")) { args(2); return chip8opcodes::SUB_Vx_Vy(reg(a[1]), reg(a[2])); }
+        if(is(m, "SHR", "shr")) { args(1); return chip8opcodes::SHR_Vx(reg(a[1])); }
+        if(is(m, "SUBN", "subn")) { args(2); return chip8opcodes::SUBN_Vx_Vy(reg(a[1]), reg(a[2])); }
+        if(is(m, "SHL", "shl")) { args(1); return chip8opcodes::SHL_Vx(reg(a[1])); }
+        if(is(m, "RND", "rnd")) { args(2); return chip8opcodes::RND_Vx_byte(reg(a[1]), byte(a[2])); }
+        if(is(m, "DRW", "drw")) { args(3); return chip8opcodes::DRW_Vx_Vy_nibble(reg(a[1]), reg(a[2]), nibble(a[3])); }
+        if(is(m, "SKP", "skp")) { args(1); return chip8opcodes::SKP_Vx(reg(a[1])); }
+        if(is(m, "SKNP", "sknp")) { args(1); return chip8opcodes::SKNP_Vx(reg(a[1])); }
+        if(is(m, "DB", "db"))
+        {
+            if(nargs != 1 && nargs != 2) fail("DB requires 1 or 2 bytes");
+            return (byte(a[1]) << 8) | (nargs == 2 ? byte(a[2]) : 0);
+        }
+        fail("undefined mnemonic");
+        return 0;
+    }
+};
+
+template<size_t N, size_t L>
+constexpr std::array<uint8_t, N> chip8_asm(const char (&src)[L])
+{
+    std::string_view code(src, L - 1);
+    if(chip8asm::size(code) != N) chip8asm::fail("size of machine code differs from N");
+    if(0x200 + N > 0x1000) chip8asm::fail("code doesn't fit into 4K of CHIP-8 memory");
+
+    // 1st pass: find markers, each command is 2 bytes long and programmes start at 0x200
+    std::array<chip8asm::marker, N/2 + 1> markers{};
+    size_t nmarkers = 0, pos = 0;
+    uint16_t addr = 0x200;
+    chip8asm::command cmd;
+    while(chip8asm::next(code, pos, cmd))
+    {
+        if(!cmd.marker.empty()) markers[nmarkers++] = chip8asm::marker{cmd.marker, addr};
+        addr += 2;
+    }
+
+    // 2nd pass: encode commands big endian
+    std::array<uint8_t, N> rom{};
+    pos = 0;
+    for(size_t i = 0; chip8asm::next(code, pos, cmd); i += 2)
+    {
+        uint16_t w = chip8asm::encode(cmd, markers, nmarkers);
+        rom[i] = w >> 8;
+        if(i+1 < N) rom[i+1] = w & 0xFF;
+    }
+    return rom;
+}
+
+#define CHIP8_ASM(src) chip8_asm<chip8asm::size(src)>(src)
+
+// build time check of the assembler against the ground truth of code/TEST.ch8, done wherever it is included
+static_assert([] {
+                  constexpr auto rom = CHIP8_ASM(R"(
+    LD V0, 0
+loop:
+    ADD V0, 1
+    SE V0, 10
+    JP loop
+end:
+    JP end
+)");
+                  const uint8_t gt[] = {0x60, 0x00, 0x70, 0x01, 0x30, 0x0A, 0x12, 0x02, 0x12, 0x08};
+                  for(size_t i=0; i<sizeof(gt); ++i)
+                      if(rom[i] != gt[i]) return false;
+                  return rom.size() == sizeof(gt);
+              }(), "compile time assembler doesn't match ground truth of code/TEST.ch8");
+
+#endif
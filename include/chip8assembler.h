@@ -1,6 +1,8 @@
 #ifndef CHIP8ASSEMBLER_H
 #define CHIP8ASSEMBLER_H
 
+#include "chip8debuginfo.h"
+#include "chip8optimizer.h"
 #include <cstdint>
 #include <string>
 #include <deque>
@@ -11,18 +13,29 @@ class chip8assembler
 {
 public:
     chip8assembler(const std::string &file, bool verbose);
+    chip8assembler(bool verbose);
     ~chip8assembler() {};
 
+    bool load(const std::string &file);
+    void loadSource(const std::string &source, const std::string &name);
     bool compile();
-    void writeMachinecode(const std::string &out);
+    void optimize(chip8optimizer &optimizer);
+    bool writeMachinecode(const std::string &out);
+    bool writeDebuginfo(const std::string &out);
     void swapEndian();
+    size_t lines() const;
+    size_t bytes() const;
+    const std::map<std::string, uint16_t>& getMarkers() const { return markers; }
 
     bool verbose;
+    bool quiet; // suppress info messages and collect errors in 'errors' instead of printing them
+    std::string errors;
     std::vector<uint16_t> machinecode;
 
 private:
-    void parse(std::vector<std::deque<std::string>>& tokens);
-    bool assemble(std::vector<std::deque<std::string>>& tokens);
+    void parse();
+    void storeLine();
+    bool assemble();
 
     bool assembleCommand(const std::deque<std::string> &command, const std::string &cmd);
     bool isRegister(const std::string& arg);
@@ -39,12 +52,23 @@ private:
     bool getRegister(const std::string& cmd, const std::string& reg, uint8_t& ret);
     bool getConst(const std::string& cmd, const std::string& sconst, uint8_t& ret);
     bool getNibble(const std::string& cmd, const std::string& snibble, uint8_t& ret);
+    bool getAddress(const std::string& cmd, const std::string& saddr, uint16_t& ret);
+    void error(const char* fmt, ...) __attribute__((format(printf, 2, 3)));
 
-    std::map<std::string, int> map_mnemonic;
+    static const std::map<std::string, int> map_mnemonic;
     std::map<std::string, uint16_t> markers;
     std::string code;
+    std::string file;
+    // tokens of each line of code, lines beyond nLines are left over from earlier sources and are reused by later ones,
+    // s.t. an assembler compiling many files only allocates token lines for sources longer than any before
+    std::vector<std::deque<std::string>> tokens;
+    std::deque<std::string> tokensLine;
+    size_t nLines = 0;
+    std::vector<int> sourceLines; // source line of each command in machine code
+    std::vector<bool> dataWords;  // word of machine code was defined by DB
+    bool oddTail = false;         // last word was defined by DB with a single byte
 
-    enum mnemonics {CLS,RET,SYS,JP,CALL,SE,SNE,LD,ADD,OR,AND,XOR,SUB,SHR,SUBN,SHL,RND,DRW,SKP,SKNP};
+    enum mnemonics {CLS,RET,SYS,JP,CALL,SE,SNE,LD,ADD,OR,AND,XOR,SUB,SHR,SUBN,SHL,RND,DRW,SKP,SKNP,DB};
 
     /* special symbols */
     char sWhitespace = ' '; char sIndent = '\t'; char sNewline = '\n';
@@ -0,0 +1,61 @@
+#ifndef CHIP8BEEPER_H
+#define CHIP8BEEPER_H
+
+#include "chip8ring.h"
+#include <atomic>
+#include <cstdint>
+#include <stdio.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+// square wave beeper of CHIP-8, sounding while the sound timer ST is nonzero
+// samples are 16 bit signed mono PCM, generated one frame (1/60 s) at a time and handed to
+// - a WAV file, rendered as fast as emulation runs
+// - a stream, played by a thread of its own in real time, e.g. into a FIFO read by "aplay -f S16_LE -r 44100"
+// NOTE while streaming, a frame waits for room in the ring, so emulation is paced by the audio clock
+class chip8beeper
+{
+public:
+    static const int FRAME_RATE = 60;
+
+    chip8beeper(uint32_t sampleRate = 44100, uint32_t frequency = 440, int16_t amplitude = 8000);
+    ~chip8beeper();
+    chip8beeper(const chip8beeper &o) = delete;
+    chip8beeper& operator=(const chip8beeper &o) = delete;
+
+    bool open_wav(const std::string &path);
+    bool start_stream(const std::string &path);
+    // finishes the WAV file and stops streaming once all samples are played
+    void close();
+
+    // renders the samples of one frame into every output
+    void frame(bool on);
+
+    // statistics, underruns are samples the stream had to play silence for, since emulation didn't deliver in time
+    void print(FILE *out) const;
+
+private:
+    void player();
+
+    uint32_t sampleRate;
+    uint32_t phase;             // of the square wave, the sign is its highest bit
+    uint32_t phaseStep;
+    int16_t amplitude;
+    uint64_t frames;
+    uint64_t beepFrames;
+    uint64_t samples;
+    std::vector<int16_t> buffer; // samples of the current frame
+
+    FILE *wav;
+    std::string wavPath;
+
+    chip8ring<int16_t, 8192> ring;
+    std::thread thread;
+    int stream;                 // file descriptor the player writes to
+    std::atomic<bool> closing;
+    std::atomic<bool> playing;  // false once the stream is closed, s.t. frames don't wait for it anymore
+    std::atomic<uint64_t> underruns;
+};
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef CHIP8BULKASSEMBLER_H
+#define CHIP8BULKASSEMBLER_H
+
+#include "chip8optimizer.h"
+#include "chip8parallel.h"
+#include <cstddef>
+#include <string>
+#include <vector>
+
+class chip8assembler;
+
+class chip8bulkassembler
+{
+public:
+    chip8bulkassembler(const std::vector<std::string> &inputs, const std::string &outdir, int nthreads,
+                       bool optimize = false, bool measure = false, bool debuginfo = false);
+    ~chip8bulkassembler() {};
+
+    bool run();
+    void printSummary();
+
+private:
+    struct job
+    {
+        std::string input;
+        std::string output;
+        size_t lines = 0;
+        size_t bytes = 0;
+        bool ok = false;
+        bool collision = false; // another input has the same output
+        std::string errors;
+        chip8optimizer::report report;
+    };
+
+    void worker(chip8parallel::cursor &c);
+    void optimizeJob(chip8assembler &assembler, job &j);
+
+    std::vector<job> jobs;
+    int nthreads;
+    bool optimize;
+    bool measure;
+    bool debuginfo;
+    double seconds;
+};
+
+std::string outputFilename(const std::string &input);
+
+// max. number of commands executed per program when measuring the dynamic effect of the optimizer
+const uint64_t nExecutionBudget = 1000000;
+
+#endif
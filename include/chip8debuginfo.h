@@ -0,0 +1,95 @@
+#ifndef CHIP8DEBUGINFO_H
+#define CHIP8DEBUGINFO_H
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+// debug info sidecar file (.dbg) written by the assembler
+// layout (host byte order, all offsets in bytes from start of file):
+//   header | location[nLocations] | symbol[nSymbols] | file[nFiles] | string table
+// location i describes the byte at address base+i, s.t. a lookup is a single array access on the mapped file
+class chip8debuginfo
+{
+public:
+    struct header
+    {
+        char magic[4];        // "C8DG"
+        uint32_t version;
+        uint16_t base;        // address of first location
+        uint16_t reserved;
+        uint32_t nLocations;
+        uint32_t nSymbols;
+        uint32_t nFiles;
+        uint32_t offLocations;
+        uint32_t offSymbols;
+        uint32_t offFiles;
+        uint32_t offStrings;
+        uint32_t lenStrings;
+    };
+    struct location
+    {
+        uint32_t line;        // source line, 0 if address holds no code
+        uint16_t file;        // index into files
+        uint16_t symbol;      // closest symbol in front of address, NO_SYMBOL if none
+    };
+    struct symbol
+    {
+        uint32_t name;        // offset into string table
+        uint16_t addr;
+        uint16_t reserved;
+    };
+    struct file
+    {
+        uint32_t name;        // offset into string table
+    };
+
+    static const uint32_t VERSION = 1;
+    static const uint16_t NO_SYMBOL = 0xFFFF;
+
+    // collects debug info while assembling and writes it to disk
+    class builder
+    {
+    public:
+        void setFile(const std::string &name);
+        void addLine(uint16_t addr, int line);
+        void addSymbol(const std::string &name, uint16_t addr);
+        bool write(const std::string &path) const;
+
+    private:
+        std::vector<std::string> files;
+        std::map<uint16_t, std::pair<int, uint16_t>> lines; // address -> (line, file)
+        std::multimap<uint16_t, std::string> symbols;     // address -> name
+    };
+
+    chip8debuginfo();
+    ~chip8debuginfo();
+    chip8debuginfo(const chip8debuginfo &o) = delete;
+    chip8debuginfo& operator=(const chip8debuginfo &o) = delete;
+
+    bool open(const std::string &path);
+    void close();
+    bool is_open() const { return data != nullptr; }
+
+    const location* lookup(uint16_t addr) const;
+    const char* fileName(const location &loc) const;
+    const char* symbolName(const location &loc) const;
+    uint16_t symbolAddress(const location &loc) const;
+    const char* symbolAt(uint16_t addr) const;
+    std::string describe(uint16_t addr) const;
+
+private:
+    const char* string(uint32_t offset) const;
+
+    const uint8_t *data;
+    size_t size;
+    const header *hdr;
+    const location *locations;
+    const symbol *symbols;
+    const file *files;
+    const char *strings;
+};
+
+#endif
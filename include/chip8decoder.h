@@ -0,0 +1,197 @@
+#ifndef CHIP8DECODER_H
+#define CHIP8DECODER_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <stdio.h>
+
+class chip8output;
+
+// stateless CHIP-8 decoder shared by interpreter and disassembler
+// the kind of every possible 16 bit command is precomputed at compile time, s.t. decoding is a single table lookup
+struct chip8decoder
+{
+    enum kind : uint8_t
+    {
+        UNKNOWN,
+        CLS, RET, SYS,
+        JP_addr, CALL_addr,
+        SE_Vx_byte, SNE_Vx_byte, SE_Vx_Vy,
+        LD_Vx_byte, ADD_Vx_byte,
+        LD_Vx_Vy, OR_Vx_Vy, AND_Vx_Vy, XOR_Vx_Vy, ADD_Vx_Vy, SUB_Vx_Vy, SHR_Vx, SUBN_Vx_Vy, SHL_Vx,
+        SNE_Vx_Vy,
+        LD_I_addr, JP_V0_addr,
+        RND_Vx_byte, DRW_Vx_Vy_nibble,
+        SKP_Vx, SKNP_Vx,
+        LD_Vx_DT, LD_Vx_K, LD_DT_Vx, LD_ST_Vx, ADD_I_Vx, LD_F_Vx, LD_B_Vx, LD_I_Vx, LD_Vx_I,
+        NUM_KINDS
+    };
+
+    struct instruction
+    {
+        kind k;
+        uint8_t x;      // 0x0X00
+        uint8_t y;      // 0x00Y0
+        uint8_t n;      // 0x000N
+        uint8_t kk;     // 0x00KK
+        uint16_t nnn;   // 0x0NNN
+    };
+
+    // classify a command, this is the only place where CHIP-8 commands are told apart
+    static constexpr kind classify(uint16_t w)
+    {
+        uint8_t n = w & 0x000F;
+        uint8_t kk = w & 0x00FF;
+        switch(w >> 12)
+        {
+        case 0x0:
+            if(w == 0x00E0) return CLS;
+            if(w == 0x00EE) return RET;
+            return SYS;
+        case 0x1: return JP_addr;
+        case 0x2: return CALL_addr;
+        case 0x3: return SE_Vx_byte;
+        case 0x4: return SNE_Vx_byte;
+        case 0x5: return SE_Vx_Vy; // NOTE the least significant nibble is ignored, like the interpreter always did
+        case 0x6: return LD_Vx_byte;
+        case 0x7: return ADD_Vx_byte;
+        case 0x8:
+            switch(n)
+            {
+            case 0x0: return LD_Vx_Vy;
+            case 0x1: return OR_Vx_Vy;
+            case 0x2: return AND_Vx_Vy;
+            case 0x3: return XOR_Vx_Vy;
+            case 0x4: return ADD_Vx_Vy;
+            case 0x5: return SUB_Vx_Vy;
+            case 0x6: return SHR_Vx;
+            case 0x7: return SUBN_Vx_Vy;
+            case 0xE: return SHL_Vx;
+            default: return UNKNOWN;
+            }
+        case 0x9: return SNE_Vx_Vy;
+        case 0xA: return LD_I_addr;
+        case 0xB: return JP_V0_addr;
+        case 0xC: return RND_Vx_byte;
+        case 0xD: return DRW_Vx_Vy_nibble;
+        case 0xE:
+            if(kk == 0x9E) return SKP_Vx;
+            if(kk == 0xA1) return SKNP_Vx;
+            return UNKNOWN;
+        case 0xF:
+            switch(kk)
+            {
+            case 0x07: return LD_Vx_DT;
+            case 0x0A: return LD_Vx_K;
+            case 0x15: return LD_DT_Vx;
+            case 0x18: return LD_ST_Vx;
+            case 0x1E: return ADD_I_Vx;
+            case 0x29: return LD_F_Vx;
+            case 0x33: return LD_B_Vx;
+            case 0x55: return LD_I_Vx;
+            case 0x65: return LD_Vx_I;
+            default: return UNKNOWN;
+            }
+        }
+        return UNKNOWN;
+    }
+
+    static constexpr std::array<uint8_t, 65536> makeTable()
+    {
+        std::array<uint8_t, 65536> t{};
+        for(uint32_t w = 0; w < 65536; ++w)
+            t[w] = classify(w);
+        return t;
+    }
+
+    // mnemonic format of each kind, placeholders are replaced by format():
+    // %x, %y: register numbers, %n: nibble, %k: byte, %a: address, %w: complete command
+    static constexpr const char* formats[NUM_KINDS] = {
+        "unknown command %w",
+        "CLS", "RET", "SYS %a",
+        "JP %a", "CALL %a",
+        "SE V%x, %k", "SNE V%x, %k", "SE V%x, V%y",
+        "LD V%x, %k", "ADD V%x, %k",
+        "LD V%x, V%y", "OR V%x, V%y", "AND V%x, V%y", "XOR V%x, V%y", "ADD V%x, V%y", "SUB V%x, V%y", "SHR V%x", "SUBN V%x, V%y", "SHL V%x",
+        "SNE V%x, V%y",
+        "LD I, %a", "JP V0, %a",
+        "RND V%x, %k", "DRW V%x, V%y, %n",
+        "SKP V%x", "SKNP V%x",
+        "LD V%x, DT", "LD V%x, K", "LD DT, V%x", "LD ST, V%x", "ADD I, V%x", "LD F, V%x", "LD B, V%x", "LD [I], V%x", "LD V%x, [I]"
+    };
+
+    // commands of the SCHIP and XO-CHIP extensions, which are unknown or SYS commands to a CHIP-8 interpreter
+    // NOTE they are classified separately, s.t. the interpreter and the kinds above keep plain CHIP-8 semantics
+    enum extension : uint8_t
+    {
+        NO_EXTENSION,
+        // SCHIP
+        SCD_n, SCR, SCL, EXIT, LOW, HIGH, DRW_Vx_Vy_0, LD_HF_Vx, LD_R_Vx, LD_Vx_R,
+        // XO-CHIP
+        SCU_n, SAVE_Vx_Vy, LOAD_Vx_Vy, LD_I_long, PLANE_n, AUDIO, PITCH_Vx,
+        NUM_EXTENSIONS
+    };
+
+    static constexpr extension classifyExtension(uint16_t w)
+    {
+        uint8_t kk = w & 0x00FF;
+        switch(w >> 12)
+        {
+        case 0x0:
+            if((w & 0xFFF0) == 0x00C0) return SCD_n;
+            if((w & 0xFFF0) == 0x00D0) return SCU_n;
+            if(w == 0x00FB) return SCR;
+            if(w == 0x00FC) return SCL;
+            if(w == 0x00FD) return EXIT;
+            if(w == 0x00FE) return LOW;
+            if(w == 0x00FF) return HIGH;
+            return NO_EXTENSION;
+        case 0x5:
+            if((w & 0xF) == 0x2) return SAVE_Vx_Vy;
+            if((w & 0xF) == 0x3) return LOAD_Vx_Vy;
+            return NO_EXTENSION;
+        case 0xD:
+            return (w & 0xF) == 0 ? DRW_Vx_Vy_0 : NO_EXTENSION;
+        case 0xF:
+            if(w == 0xF000) return LD_I_long;
+            if(w == 0xF002) return AUDIO;
+            if(kk == 0x01) return PLANE_n;
+            if(kk == 0x30) return LD_HF_Vx;
+            if(kk == 0x3A) return PITCH_Vx;
+            if(kk == 0x75) return LD_R_Vx;
+            if(kk == 0x85) return LD_Vx_R;
+            return NO_EXTENSION;
+        default:
+            return NO_EXTENSION;
+        }
+    }
+
+    static constexpr bool isXOCHIP(extension e) { return e >= SCU_n; }
+
+    // opcode pattern and mnemonic of each extension
+    static constexpr const char* extensionNames[NUM_EXTENSIONS] = {
+        "",
+        "00Cn SCD", "00FB SCR", "00FC SCL", "00FD EXIT", "00FE LOW", "00FF HIGH", "Dxy0 DRW", "Fx30 LD HF", "Fx75 LD R", "Fx85 LD Vx, R",
+        "00Dn SCU", "5xy2 SAVE", "5xy3 LOAD", "F000 LD I, long", "Fn01 PLANE", "F002 AUDIO", "Fx3A PITCH"
+    };
+
+    static constexpr instruction decode(uint16_t w);
+    static int format(uint16_t w, char *buf, size_t len);
+    static int formatSource(uint16_t w, const char *label, char *buf, size_t len);
+};
+
+inline constexpr std::array<uint8_t, 65536> chip8decodetable = chip8decoder::makeTable();
+
+constexpr chip8decoder::instruction chip8decoder::decode(uint16_t w)
+{
+    return instruction{kind(chip8decodetable[w]), uint8_t((w >> 8) & 0xF), uint8_t((w >> 4) & 0xF),
+                       uint8_t(w & 0xF), uint8_t(w & 0xFF), uint16_t(w & 0xFFF)};
+}
+
+// disassemble len bytes of a ROM which is loaded at address addr, one command per line
+// NOTE if len is odd the last command is completed by a zero byte, like it would be in memory
+void chip8disassemble(const uint8_t *rom, size_t len, uint16_t addr, FILE *out);
+void chip8disassemble(const uint8_t *rom, size_t len, uint16_t addr, chip8output &out);
+
+#endif
@@ -0,0 +1,89 @@
+#ifndef CHIP8EXPORT_H
+#define CHIP8EXPORT_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <stdio.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+// streams every Nth frame of the display to a file, FIFO or inherited file descriptor, e.g. into a video encoder
+// formats:
+// - RAW: 256 bytes per frame, rows top down, 8 pixels per byte with the leftmost in the highest bit and lit pixels 1,
+//   i.e. "ffmpeg -f rawvideo -pix_fmt monob -s 64x32 -i PATH"
+// - PPM: a binary PPM (P6) per frame, white on black, zoomed by an integer factor, i.e. "ffmpeg -f image2pipe -c:v ppm"
+// - RLE: the magic "C8RL" and a version byte, then per frame the XOR of its RAW bytes with those of the frame exported
+//   before (a blank display before the first) as pairs of LEB128 varints SKIP, COUNT each followed by COUNT XOR
+//   bytes, until the pairs covered all 256 bytes; an unchanged frame takes 3 bytes
+// frames are encoded into one of two large buffers while a thread of its own writes the other, so emulation only
+// waits if the reader takes longer for a buffer than emulation to fill the next one
+// NOTE a buffer is handed on once it is full or once it waited for maxLatency, s.t. a live reader doesn't starve
+class chip8export
+{
+public:
+    enum format { RAW, PPM, RLE };
+
+    static constexpr std::chrono::milliseconds maxLatency{50};
+
+    chip8export(format fmt = RAW, uint32_t every = 1, int scale = 1, size_t bufferSize = 4 << 20);
+    ~chip8export();
+    chip8export(const chip8export &o) = delete;
+    chip8export& operator=(const chip8export &o) = delete;
+
+    // path is a file or FIFO, "fd:N" writes to the inherited file descriptor N
+    // NOTE opening a FIFO blocks till its reader opened it as well
+    bool open(const std::string &path);
+    // hands on what is buffered and waits till all of it is written
+    void close();
+
+    // encodes the frame if it is an Nth one
+    void frame(const uint64_t *framebuffer);
+
+    // parses "raw", "rle", "ppm" or "ppm:SCALE"
+    static bool parse_format(const char *str, format &fmt, int &scale);
+    static const char* name(format f);
+
+    // statistics, stalls are frames which had to wait for the writer
+    void print(FILE *out) const;
+
+private:
+    void writer();
+    void handOff(bool wait);
+    void encodeRaw(const uint64_t *framebuffer, uint8_t *out);
+    size_t encodePPM(const uint64_t *framebuffer, uint8_t *out);
+    size_t encodeRLE(const uint64_t *framebuffer, uint8_t *out);
+
+    format fmt;
+    uint32_t every;
+    int scale;
+    size_t frameMax;                // bytes a frame can take at most
+    uint8_t previous[256];          // RAW bytes of the frame exported last, for RLE
+    int fd;
+    std::string path;
+
+    std::vector<uint8_t> buffers[2];
+    int fill;                       // buffer frames are encoded into, the other one belongs to the writer
+    size_t used;                    // bytes encoded into it
+    std::chrono::steady_clock::time_point lastHandOff;
+
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable cv;
+    size_t pending;                 // bytes of the writer's buffer still to write, 0 while it is idle
+    bool closing;
+    std::atomic<bool> failed;       // the reader went away, frames are dropped from then on
+
+    uint64_t frames;
+    uint64_t exported;
+    uint64_t bytes;
+    uint64_t batches;
+    uint64_t stalls;
+    double stallSeconds;
+};
+
+#endif
@@ -0,0 +1,68 @@
+#ifndef CHIP8GIF_H
+#define CHIP8GIF_H
+
+#include <cstddef>
+#include <cstdint>
+#include <stdio.h>
+#include <string>
+
+// records the display into an animated GIF, e.g. to attach a failing run to a bug report
+// frames are fed in at 60 per second and written as they come, which takes a fixed amount of memory however long the
+// recording runs: the palette has the 2 colors of the display, every frame is only the rectangle that changed since the
+// frame written before, drawn over it, and the pixels are LZW compressed
+// NOTE GIF delays are 1/100 s and players slow down delays below 2/100 s, so a frame shown shorter is replaced by the
+// next one, i.e. a display changing every frame is recorded at 30 frames per second; delays are rounded such that
+// they add up to the time of the run
+class chip8gif
+{
+public:
+    static const int FRAME_RATE = 60;
+
+    // dedup drops frames equal to the one before and shows that one longer instead
+    chip8gif(int scale = 4, bool dedup = false, uint32_t on = 0xFFFFFF, uint32_t off = 0x000000);
+    ~chip8gif();
+    chip8gif(const chip8gif &o) = delete;
+    chip8gif& operator=(const chip8gif &o) = delete;
+
+    bool open(const std::string &path);
+    // writes the last frame and finishes the file
+    bool close();
+
+    // takes the display at the end of a frame
+    void frame(const uint64_t *framebuffer);
+
+    // statistics, dropped frames are duplicates or were shown too short
+    void print(FILE *out) const;
+
+private:
+    void writeFrame(uint32_t end);
+    void writeCode(uint32_t code);
+    void flushBlock();
+
+    int scale;
+    bool dedup;
+    uint8_t palette[6];
+    FILE *file;
+    std::string path;
+    bool ok;
+
+    uint64_t canvas[32];    // display as the frames written so far show it
+    uint64_t pending[32];   // display still to write, it is shown since frame start
+    bool hasPending;
+    uint32_t start;         // frame the pending display is shown from
+    uint32_t frames;
+
+    // LZW dictionary, the code of a string followed by a pixel is next[code][pixel], 0 if it isn't in yet
+    uint16_t next[4096][2];
+    uint32_t bits;          // bits not yet complete to a byte
+    int nBits;
+    int codeSize;
+    uint8_t block[255];     // data sub-block being filled
+    int blockSize;
+
+    uint64_t written;
+    uint64_t dropped;
+    uint64_t bytes;
+};
+
+#endif
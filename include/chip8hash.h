@@ -0,0 +1,18 @@
+#ifndef CHIP8HASH_H
+#define CHIP8HASH_H
+
+#include <cstddef>
+#include <cstdint>
+
+// FNV-1a of a memory block, identifies ROMs in indices, archives and save states
+inline constexpr uint64_t chip8hashOffset = 0xcbf29ce484222325ULL;
+inline constexpr uint64_t chip8hashPrime = 0x100000001b3ULL;
+
+inline uint64_t chip8hash(const uint8_t *data, size_t len, uint64_t h = chip8hashOffset)
+{
+    for(size_t i=0; i<len; ++i)
+        h = (h ^ data[i]) * chip8hashPrime;
+    return h;
+}
+
+#endif
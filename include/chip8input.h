@@ -0,0 +1,75 @@
+#ifndef CHIP8INPUT_H
+#define CHIP8INPUT_H
+
+#include "chip8ring.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <stdio.h>
+#include <termios.h>
+#include <thread>
+
+// keyboard input for interactive runs, read from the terminal in raw mode by a thread of its own
+// the keypad is mapped to the left side of a QWERTY keyboard:
+//   1 2 3 C      1 2 3 4
+//   4 5 6 D      q w e r
+//   7 8 9 E  <-  a s d f
+//   A 0 B F      z x c v
+// key presses are handed to the emulation thread through a chip8ring with the time they were read at
+// NOTE terminals report presses only, so a key counts as down till holdTime after its last press, which autorepeat
+// renews while the key is held
+class chip8input
+{
+public:
+    struct event
+    {
+        std::chrono::steady_clock::time_point time;
+        uint8_t key;
+    };
+
+    static constexpr std::chrono::milliseconds holdTime{200};
+
+    chip8input();
+    ~chip8input();
+    chip8input(const chip8input &o) = delete;
+    chip8input& operator=(const chip8input &o) = delete;
+
+    // puts the terminal into raw mode and starts reading it, fails if stdin is no terminal
+    bool start();
+    // stops reading and restores the terminal
+    void stop();
+
+    // consumer: takes all pending presses and returns the keys down, bit k is set while key k is down
+    uint16_t keys();
+    // consumer: parks the calling thread without spinning till a press is pending or the timeout expired
+    void wait(std::chrono::milliseconds timeout);
+    bool pending() const { return !ring.empty(); }
+
+    // statistics of the time between reading a press and the emulation taking it
+    void print(FILE *out) const;
+
+private:
+    void reader();
+
+    chip8ring<event, 256> ring;
+    std::thread thread;
+    int wakeup[2];                  // pipe to end the reader
+    bool rawMode;
+    struct termios savedMode;
+
+    // NOTE the consumer announces to be parked before it checks the ring for the last time and the producer checks
+    // for a parked consumer after pushing, s.t. one of both always sees the other and no press is missed
+    std::atomic<bool> parked;
+    std::mutex mutex;
+    std::condition_variable cv;
+
+    std::chrono::steady_clock::time_point lastPress[16];
+    uint64_t presses;
+    std::atomic<uint64_t> dropped;  // presses lost because the ring was full
+    double latencySum;
+    double latencyMax;
+};
+
+#endif
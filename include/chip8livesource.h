@@ -0,0 +1,32 @@
+#ifndef CHIP8LIVESOURCE_H
+#define CHIP8LIVESOURCE_H
+
+#include "chip8assembler.h"
+#include "chip8processor.h"
+#include <cstdint>
+#include <map>
+#include <string>
+#include <time.h>
+
+// assembles a CHIP-8 source file straight into the memory of a processor and patches it in again whenever the file changes
+class chip8livesource
+{
+public:
+    chip8livesource(const std::string &file, bool verbose);
+    ~chip8livesource() {};
+
+    bool load(chip8processor &chip8);
+    int reload(chip8processor &chip8);
+
+private:
+    bool modified();
+    int relocate(uint16_t addr, const std::map<std::string, uint16_t> &newMarkers);
+
+    chip8assembler assembler;
+    std::string file;
+    std::map<std::string, uint16_t> markers;
+    uint16_t lenProgram;
+    struct timespec mtime;
+};
+
+#endif
@@ -0,0 +1,83 @@
+#ifndef CHIP8MOVIE_H
+#define CHIP8MOVIE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class chip8processor;
+
+// input movie file (.c8m): the keys pressed during a run, keyed to frame numbers, s.t. the run can be replayed exactly
+// layout (host byte order, all offsets in bytes from start of file):
+//   header | event[nEvents] | checksum[nChecksums]
+// an event holds the key state from its frame on, so only changes are stored; checksum i is the state hash at the end
+// of frame i * checksumInterval, which lets a replay tell the first frame it diverges in
+class chip8movie
+{
+public:
+    struct header
+    {
+        char magic[4];            // "C8MV"
+        uint32_t version;
+        uint8_t quirks;           // chip8quirks the movie was recorded with
+        uint8_t reserved;
+        uint16_t commandsPerFrame;
+        uint32_t seed;            // seed of the random generator
+        uint64_t romHash;         // chip8processor::rom_hash() of the ROM the movie belongs to
+        uint64_t startHash;       // chip8processor::state_hash() when recording started
+        uint32_t nFrames;
+        uint32_t nEvents;
+        uint32_t checksumInterval; // 0 if no checksums are stored
+        uint32_t nChecksums;
+        uint32_t offEvents;
+        uint32_t offChecksums;
+    };
+    struct event
+    {
+        uint32_t frame;
+        uint16_t keys;            // bit k is set while key k is down
+        uint16_t reserved;
+    };
+
+    static const uint32_t VERSION = 1;
+
+    // reads a key script, one event per line: FRAME KEYS, where KEYS are the hex digits of the keys down or '-' for none
+    // empty lines and lines starting with '#' are skipped, frames have to increase
+    static bool read_script(const std::string &path, std::vector<event> &events);
+
+    chip8movie();
+    ~chip8movie();
+    chip8movie(const chip8movie &o) = delete;
+    chip8movie& operator=(const chip8movie &o) = delete;
+
+    // recording: start with the machine as it is, seeded with seed, then per frame input() and end_frame()
+    void record(const chip8processor &chip8, uint32_t seed, uint16_t commandsPerFrame, uint32_t checksumInterval);
+    void input(uint16_t keys);          // key state of the current frame
+    void end_frame(uint64_t stateHash);
+    bool write(const std::string &path) const;
+
+    // replay
+    bool open(const std::string &path, bool verbose = true);
+    void close();
+    bool is_open() const { return data != nullptr; }
+
+    // header of the opened movie, or of the one being recorded
+    const header& info() const { return *hdr; }
+    uint16_t keys(uint32_t frame) const;
+    // returns false if no checksum is stored for the frame
+    bool checksum(uint32_t frame, uint64_t &hash) const;
+
+private:
+    const uint8_t *data;
+    size_t length;
+    const header *hdr;
+    const event *events;
+    const uint64_t *checksums;
+
+    header rec;
+    std::vector<event> recEvents;
+    std::vector<uint64_t> recChecksums;
+};
+
+#endif
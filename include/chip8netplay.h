@@ -0,0 +1,148 @@
+#ifndef CHIP8NETPLAY_H
+#define CHIP8NETPLAY_H
+
+#include "chip8savestate.h"
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <netinet/in.h>
+#include <random>
+#include <stdio.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+class chip8processor;
+
+// rollback netplay of two emulators over UDP, both players press keys of the same keypad, a frame's keys are the OR
+// of both; remote keys of frames not received yet are predicted to be the last ones received, s.t. emulation never
+// waits for the network; the state before each frame is saved, and once remote keys arrive which differ from the
+// prediction, emulation goes back to the frame they belong to and emulates the frames since again
+// a packet carries all local keys the peer hasn't acknowledged yet, so lost packets are made up for by the next
+// NOTE emulation is only ever window frames ahead of the remote keys received, otherwise it stalls till they arrive;
+// an emulator ahead of its peer by more than a frame waits a frame now and then, s.t. rollbacks stay short
+// NOTE both emulators must run the same ROM from the same state with the same seed, quirks and commands per frame,
+// which is verified by the state hash of the first frame and then of every frame both have all keys of
+class chip8netplay
+{
+public:
+    static const uint32_t RING = 64;    // frames of states and keys kept
+
+    chip8netplay();
+    ~chip8netplay();
+    chip8netplay(const chip8netplay &o) = delete;
+    chip8netplay& operator=(const chip8netplay &o) = delete;
+
+    // spec is "LOCALPORT:HOST:PORT", e.g. "7000:127.0.0.1:7001"
+    bool open(const std::string &spec);
+    void close();
+
+    // frames emulation may run ahead of the remote keys received (default: 8)
+    bool set_window(uint32_t frames);
+    // delays each packet sent by latency plus a uniform jitter of +-jitter ms and drops loss percent of them,
+    // emulating a network on loopback; spec is "LATENCY[:JITTER[:LOSS]]"
+    bool set_impairment(const std::string &spec);
+
+    // waits for the peer; chip8 is at the start of frame 0, keys are the local ones of it
+    bool start(chip8processor &chip8, uint16_t keys, int commandsPerFrame, int fps);
+    // chip8 completed frame f, keys are the local ones of frame f + 1; emulates again what was mispredicted and sets
+    // the keys of frame f + 1, false on desync or if the peer is gone
+    bool end_frame(uint32_t f, chip8processor &chip8, uint16_t keys);
+    // waits for the remote keys of all frames emulated and corrects chip8 by them, s.t. both emulators end in the same
+    // state, then waits a little for the peer to have all local keys
+    // NOTE a chip8 stopped within a frame is left as is
+    bool finish(chip8processor &chip8);
+
+    // whether the last end_frame() emulated frames again, i.e. anything on the display may have changed
+    bool rolled_back() const { return rolledBack; }
+    bool desynced() const { return desync; }
+
+    void print(FILE *out) const;
+
+private:
+    // NOTE all fields in host byte order, peers share the architecture
+    struct packet
+    {
+        char magic[4];          // "C8NP"
+        uint32_t first;         // frame of keys[0]
+        uint32_t count;         // keys following
+        uint32_t ack;           // frames of the receiver's keys the sender has, i.e. needn't be sent again
+        int32_t advantage;      // frames the sender is ahead of the receiver's keys it has
+        uint32_t checkFrame;    // frame whose start state the sender has all keys for
+        uint64_t checkHash;     // state hash of it
+        uint64_t startHash;     // state hash of frame 0
+        uint16_t keys[RING];
+    };
+
+    void receive(int timeoutMs);
+    void send();
+    void transmit(const void *data, size_t size);
+    void injector();
+    void save(uint32_t frame, const chip8processor &chip8);
+    void rollback(chip8processor &chip8);
+    void emulate(chip8processor &chip8, uint32_t frame);
+    uint16_t remoteKeys(uint32_t frame);
+    bool check();
+    bool stalled() const;
+    double since(std::chrono::steady_clock::time_point t) const;
+
+    int sock;
+    sockaddr_in peer;
+    uint32_t window;
+    int latency;                // of the impairment, in ms
+    int jitter;
+    int loss;                   // percent
+    int commandsPerFrame;
+    std::chrono::steady_clock::duration framePeriod;
+
+    // per frame, indexed by frame % RING
+    std::vector<chip8state> states;     // before the frame
+    uint64_t hashes[RING];
+    uint16_t local[RING];
+    uint16_t remote[RING];
+    uint32_t received[RING];    // frame remote[] holds keys of, remote keys arrive in any order
+    uint16_t used[RING];        // remote keys the frame was emulated with
+    uint32_t next;              // frames emulated, i.e. chip8 is at the start of frame next
+    uint32_t confirmed;         // frames all remote keys are received of
+    uint32_t remoteNext;        // frames any remote keys are received of
+    uint16_t lastRemote;        // keys of the last confirmed frame, predicted for the frames after it
+    uint32_t acked;             // frames of local keys the peer has
+    int32_t remoteAdvantage;
+    uint32_t rollbackFrom;      // earliest frame emulated with mispredicted keys, UINT32_MAX if none
+    uint32_t peerCheckFrame;    // latest state hash of the peer, not yet compared if beyond checkedFrame
+    uint64_t peerCheckHash;
+    uint32_t checkedFrame;
+    uint64_t startHash;
+    bool rolledBack;
+    bool desync;
+    std::chrono::steady_clock::time_point lastReceived;
+    std::chrono::steady_clock::time_point lastSent;
+
+    // impairment, packets wait in the delay line for a thread of their own to send them when due
+    std::multimap<std::chrono::steady_clock::time_point, std::vector<uint8_t>> delayLine;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::thread thread;
+    bool stopping;
+    std::mt19937 rng;
+
+    // statistics
+    uint64_t rollbacks;
+    uint64_t resimulated;
+    uint64_t mispredicted;
+    uint32_t maxDepth;
+    double rollbackSeconds;
+    double maxRollbackSeconds;
+    uint64_t stalls;
+    double stallSeconds;
+    uint64_t waits;             // frames waited for a peer behind
+    uint64_t sent;
+    uint64_t receivedPackets;
+    uint64_t dropped;           // by the impairment
+    uint64_t lagSum;            // frames ahead of the remote keys, summed over frames
+    uint64_t checks;            // state hashes compared with the peer's
+};
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef CHIP8OPCODES_H
+#define CHIP8OPCODES_H
+
+#include <cstdint>
+
+// encoding rules of all CHIP-8 commands, named like in Cowgod's CHIP-8 reference
+// NOTE these are shared by chip8assembler and the constexpr assembler (chip8asm.h), s.t. both always emit the same machine code
+// NOTE callers are responsible for range checks, registers need to be in [0,15], addresses in [0,0xFFF] and nibbles in [0,15]
+struct chip8opcodes
+{
+    static constexpr uint16_t CLS() { return 0x00E0; }
+    static constexpr uint16_t RET() { return 0x00EE; }
+    static constexpr uint16_t JP_addr(uint16_t addr) { return 0x1000 | addr; }
+    static constexpr uint16_t CALL_addr(uint16_t addr) { return 0x2000 | addr; }
+    static constexpr uint16_t SE_Vx_byte(uint8_t x, uint8_t kk) { return 0x3000 | (x << 8) | kk; }
+    static constexpr uint16_t SNE_Vx_byte(uint8_t x, uint8_t kk) { return 0x4000 | (x << 8) | kk; }
+    static constexpr uint16_t SE_Vx_Vy(uint8_t x, uint8_t y) { return 0x5000 | (x << 8) | (y << 4); }
+    static constexpr uint16_t LD_Vx_byte(uint8_t x, uint8_t kk) { return 0x6000 | (x << 8) | kk; }
+    static constexpr uint16_t ADD_Vx_byte(uint8_t x, uint8_t kk) { return 0x7000 | (x << 8) | kk; }
+    static constexpr uint16_t LD_Vx_Vy(uint8_t x, uint8_t y) { return 0x8000 | (x << 8) | (y << 4); }
+    static constexpr uint16_t OR_Vx_Vy(uint8_t x, uint8_t y) { return 0x8001 | (x << 8) | (y << 4); }
+    static constexpr uint16_t AND_Vx_Vy(uint8_t x, uint8_t y) { return 0x8002 | (x << 8) | (y << 4); }
+    static constexpr uint16_t XOR_Vx_Vy(uint8_t x, uint8_t y) { return 0x8003 | (x << 8) | (y << 4); }
+    static constexpr uint16_t ADD_Vx_Vy(uint8_t x, uint8_t y) { return 0x8004 | (x << 8) | (y << 4); }
+    static constexpr uint16_t SUB_Vx_Vy(uint8_t x, uint8_t y) { return 0x8005 | (x << 8) | (y << 4); }
+    static constexpr uint16_t SHR_Vx(uint8_t x) { return 0x8006 | (x << 8); } // NOTE y is not used and set to 0
+    static constexpr uint16_t SUBN_Vx_Vy(uint8_t x, uint8_t y) { return 0x8007 | (x << 8) | (y << 4); }
+    static constexpr uint16_t SHL_Vx(uint8_t x) { return 0x800E | (x << 8); } // NOTE y is not used and set to 0
+    static constexpr uint16_t SNE_Vx_Vy(uint8_t x, uint8_t y) { return 0x9000 | (x << 8) | (y << 4); }
+    static constexpr uint16_t LD_I_addr(uint16_t addr) { return 0xA000 | addr; }
+    static constexpr uint16_t JP_V0_addr(uint16_t addr) { return 0xB000 | addr; }
+    static constexpr uint16_t RND_Vx_byte(uint8_t x, uint8_t kk) { return 0xC000 | (x << 8) | kk; }
+    static constexpr uint16_t DRW_Vx_Vy_nibble(uint8_t x, uint8_t y, uint8_t n) { return 0xD000 | (x << 8) | (y << 4) | n; }
+    static constexpr uint16_t SKP_Vx(uint8_t x) { return 0xE09E | (x << 8); }
+    static constexpr uint16_t SKNP_Vx(uint8_t x) { return 0xE0A1 | (x << 8); }
+    static constexpr uint16_t LD_Vx_DT(uint8_t x) { return 0xF007 | (x << 8); }
+    static constexpr uint16_t LD_Vx_K(uint8_t x) { return 0xF00A | (x << 8); }
+    static constexpr uint16_t LD_DT_Vx(uint8_t x) { return 0xF015 | (x << 8); }
+    static constexpr uint16_t LD_ST_Vx(uint8_t x) { return 0xF018 | (x << 8); }
+    static constexpr uint16_t ADD_I_Vx(uint8_t x) { return 0xF01E | (x << 8); }
+    static constexpr uint16_t LD_F_Vx(uint8_t x) { return 0xF029 | (x << 8); }
+    static constexpr uint16_t LD_B_Vx(uint8_t x) { return 0xF033 | (x << 8); }
+    static constexpr uint16_t LD_I_Vx(uint8_t x) { return 0xF055 | (x << 8); } // LD [I], Vx
+    static constexpr uint16_t LD_Vx_I(uint8_t x) { return 0xF065 | (x << 8); } // LD Vx, [I]
+};
+
+#endif
@@ -0,0 +1,63 @@
+#ifndef CHIP8OPTIMIZER_H
+#define CHIP8OPTIMIZER_H
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+// peephole optimizer working on the machine code of chip8assembler
+// NOTE all addresses referenced by markers and by JP/CALL/LD I instructions are rewritten, s.t. labels keep their meaning
+// NOTE words marked as data are neither interpreted nor moved relative to their neighbours
+class chip8optimizer
+{
+public:
+    struct report
+    {
+        size_t wordsBefore = 0;
+        size_t wordsAfter = 0;
+        size_t jumpsThreaded = 0;
+        size_t jumpsRemoved = 0;
+        size_t deadRemoved = 0;
+        size_t foldsApplied = 0;
+        size_t skipsShrunk = 0;
+        uint64_t executedBefore = 0;
+        uint64_t executedAfter = 0;
+
+        report& operator+=(const report &o);
+        void print() const;
+    };
+
+    chip8optimizer() {};
+    ~chip8optimizer() {};
+
+    void optimize(std::vector<uint16_t> &code, std::map<std::string, uint16_t> &markers,
+                  const std::vector<bool> &data = std::vector<bool>());
+    static uint64_t countExecuted(const std::vector<uint16_t> &code, uint64_t budget);
+
+    report stats;
+    std::vector<int> remap; // index of each word of the input in the optimized code, -1 if the word was removed
+
+private:
+    bool threadJumps();
+    bool removeJumpsToNext();
+    bool removeDeadCode();
+    bool foldRegisterChains();
+    bool shrinkSkips();
+    void analyze();
+    void compact();
+
+    bool isSkip(size_t i) const;
+    bool followsSkip(size_t i) const;
+    bool removable(size_t i) const;
+
+    std::vector<uint16_t> *code;
+    std::map<std::string, uint16_t> *markers;
+    std::vector<bool> data;       // word is data defined by DB
+    std::vector<bool> removed;
+    std::vector<bool> referenced; // word is target of marker, JP, CALL or LD I
+    std::vector<bool> pinned;     // word must not be moved relative to its neighbours (jump tables, data)
+    bool computedJumps;           // program contains JP V0, addr
+};
+
+#endif
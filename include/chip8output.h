@@ -0,0 +1,45 @@
+#ifndef CHIP8OUTPUT_H
+#define CHIP8OUTPUT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <unistd.h>
+#include <vector>
+
+// buffered text output for dumps and listings
+// text is formatted into one large buffer which is reused and handed to the kernel with a single write() per flush,
+// numbers are converted by table lookups, s.t. large dumps are limited by I/O and not by printf or stdio locking
+// NOTE stdout is flushed before writing to STDOUT_FILENO, s.t. text printed before keeps its order
+class chip8output
+{
+public:
+    chip8output(int fd = STDOUT_FILENO, size_t capacity = 1 << 16);
+    ~chip8output();
+
+    // get space for at least n chars, which is committed by advance()
+    char* reserve(size_t n) { if(used + n > buf.size()) grow(n); return buf.data() + used; }
+    void advance(size_t n) { used += n; }
+
+    void put(char c) { *reserve(1) = c; ++used; }
+    void put(const char *s);
+    void put(const char *s, size_t n);
+    void hex(uint32_t v, int digits); // like printf("%0*x", digits, v)
+    void dec(long v);                 // like printf("%li", v)
+
+    // one line per cols bytes of data: "0x<addr>: xx xx ... \n", like printf("0x%03x: ") followed by printf("%02x ")
+    void hexdump(const uint8_t *data, size_t len, uint32_t addr, int cols);
+
+    bool flush();
+
+private:
+    void grow(size_t n);
+
+    int fd;
+    std::vector<char> buf;
+    size_t used;
+};
+
+// writes "xx " for each of n bytes to dst, returns number of chars written (3*n)
+size_t chip8hexbytes(const uint8_t *src, size_t n, char *dst);
+
+#endif
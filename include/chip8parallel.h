@@ -0,0 +1,49 @@
+#ifndef CHIP8PARALLEL_H
+#define CHIP8PARALLEL_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+// runs independent jobs, e.g. one per file, on a few threads, each pulling the next job index from a shared cursor,
+// s.t. threads which got short jobs take over more of them
+struct chip8parallel
+{
+    // hands out every job index exactly once
+    class cursor
+    {
+    public:
+        explicit cursor(size_t jobs) : pos{0}, jobs{jobs} {}
+        bool next(size_t &i) { i = pos++; return i < jobs; }
+
+    private:
+        std::atomic<size_t> pos;
+        const size_t jobs;
+    };
+
+    // one thread per core if nthreads <= 0, but never more threads than jobs
+    static int threads(int nthreads, size_t jobs)
+    {
+        if(nthreads <= 0)
+            nthreads = std::max(1u, std::thread::hardware_concurrency());
+        return std::max(1, std::min(nthreads, int(jobs)));
+    }
+
+    // calls worker(cursor&) on nthreads threads, the calling one included, and returns once all of them returned
+    // NOTE a worker keeps what it reuses across its jobs, e.g. buffers, in locals of its own call
+    template<typename Worker>
+    static void run(int nthreads, size_t jobs, Worker worker)
+    {
+        cursor c(jobs);
+        std::vector<std::thread> pool;
+        for(int i = 1; i < nthreads; ++i)
+            pool.emplace_back([&]() { worker(c); });
+        worker(c);
+        for(auto &t : pool)
+            t.join();
+    }
+};
+
+#endif
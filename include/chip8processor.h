@@ -2,12 +2,16 @@
 #define CHIP8_H
 
 #include <cstdint>
+#include <functional>
 #include <string>
+#include <vector>
+
+struct chip8state;
 
 class chip8processor
 {
 public:
-    chip8processor();
+    chip8processor(bool _quiet = false);
     ~chip8processor();
     chip8processor(const chip8processor &o);
     chip8processor(chip8processor &&o) noexcept;
@@ -16,15 +20,64 @@ public:
     chip8processor& operator=(chip8processor &&o) noexcept;
 
     int load_ROM(std::string _filename);
+    int load_program(const uint8_t *_data, size_t _len);
+    int load_machinecode(const std::vector<uint16_t> &_code);
+    // 1 if PC and stack were relocated into the new program, 0 if it restarted, -1 if it was rejected and memory is untouched
+    int patch_machinecode(const std::vector<uint16_t> &_code, const std::function<int(uint16_t)> &_relocate);
     bool is_running();
+    int program_size() const { return lenProgram; }
+    uint16_t program_counter() const { return PC; }
+    uint16_t current_command() const { return command; }
     int fetch_command();
     int exec_command();
     void disassemble_command();
+    void tick_timers() { if(DT) --DT; if(ST) --ST; } // to be called at 60 Hz
+    bool timers_running() const { return DT || ST; }
+    uint16_t sound_timer() const { return ST; } // the beeper sounds while it is nonzero
+    uint16_t delay_timer() const { return DT; }
+    const uint8_t* registers() const { return V; } // V0 to VF
+    uint16_t index_register() const { return I; }
+    uint8_t stack_pointer() const { return SP; }
+    const uint16_t* call_stack() const { return stack; }
+    // LD Vx, K is waiting for a key, nothing but input changes the machine then besides running timers
+    bool waiting_for_key() const { return (command & 0xF0FF) == 0xF00A && !keys; }
     void print_complete_memory_map(int _cols);
     void print_memory(int _cols);
     void print_registers();
     void print_ROM(int _len, int _cols);
 
+    // behaviour and randomness, s.t. runs can be reproduced
+    void set_quirks(uint8_t _quirks) { quirks = _quirks; }
+    uint8_t get_quirks() const { return quirks; }
+    void seed(uint32_t _seed) { rng = _seed ? _seed : 1; }
+    // state of the hex keypad, bit k is set while key k is down
+    void set_keys(uint16_t _keys);
+    uint16_t get_keys() const { return keys; }
+    // hash of the program as loaded, identifies the ROM a state belongs to
+    uint64_t rom_hash() const { return romHash; }
+    // 64x32 display, one row per word, the leftmost pixel is the highest bit
+    const uint64_t* framebuffer() const { return display; }
+    // rows and coarse columns of the display written since clear_dirty(), s.t. frontends only present what changed
+    // bit r of the rows is display row r, bit b of the columns covers pixel columns 8b to 8b+7
+    // NOTE written doesn't mean changed, a sprite XORed twice leaves its rows dirty
+    uint32_t dirty_rows() const { return dirtyRows; }
+    uint8_t dirty_columns() const { return dirtyCols; }
+    void clear_dirty() { dirtyRows = 0; dirtyCols = 0; }
+
+    // hash of the complete machine state in O(1), see chip8zobrist
+    // NOTE memory, stack and display are hashed incrementally by every write, registers when asked for
+    uint64_t state_hash() const;
+    uint64_t hash_memory() const; // hash of memory, stack and display computed from scratch
+    // stop once the machine returns to a state it was in before, i.e. it runs in an infinite loop
+    void detect_cycles(bool _detect) { detectCycles = _detect; }
+    uint64_t cycle_period() const { return cyclePeriod; } // number of commands per iteration of the loop, 0 if none
+
+    // complete machine state, see chip8savestate
+    void get_state(chip8state &_state) const;
+    void set_state(const chip8state &_state);
+    // NOTE the state hash is trusted to belong to the state, s.t. nothing has to be hashed
+    void set_state(const chip8state &_state, uint64_t _hash);
+
 private:
     uint8_t *memory;
     uint8_t *V;
@@ -35,6 +88,26 @@ private:
     uint16_t ST;
     uint16_t DT;
     uint16_t I;
+    uint16_t lenProgram;
+    uint64_t display[32];
+    uint32_t dirtyRows;
+    uint8_t dirtyCols;
+    uint32_t rng;
+    uint16_t keys;
+    uint8_t quirks;         // chip8quirks, chip8quirks::CLIP unless set
+    uint64_t romHash;
+    uint64_t memoryHash;    // hash of memory, stack and display
+    bool detectCycles;
+    uint64_t cycleMark;     // hash of the state the current one is compared with (Brent)
+    uint16_t cycleMarkPC;
+    uint64_t cycleSteps;    // number of commands since the mark was set
+    uint64_t cyclePower;
+    uint64_t cyclePeriod;
+
+    void poke(uint16_t addr, uint8_t value);
+    uint64_t hash_registers() const;
+    void copy_state(const chip8state &_state);
+    void restart_cycle_detection();
 
     const uint16_t FAIL_COMMAND = 0xFFFF; // NOTE 0xFFFF is an invalid opcode, so it will not interfere with other commands
     bool running;
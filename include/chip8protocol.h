@@ -0,0 +1,60 @@
+#ifndef CHIP8PROTOCOL_H
+#define CHIP8PROTOCOL_H
+
+#include <cstdint>
+
+// binary protocol of chip8-server over a Unix domain socket (host byte order, client and server share the host)
+// every message starts with a header, whose size covers header and payload; requests of a connection are answered in
+// order, so clients can pipeline them, e.g. INPUT, STEP and FRAME of many sessions in a single write
+// requests and their payloads:
+//   CREATE   create      -> session id in the response header
+//   LOAD     ROM bytes, at most 3584
+//   INPUT    uint16_t keys, bit k is set while key k is down
+//   STEP     uint32_t frames to emulate -> stepped
+//   FRAME    -> uint32_t rows changed since the last FRAME of the session, followed by each of them as uint64_t, top
+//            down, the leftmost pixel in the highest bit
+//   SNAPSHOT -> uint64_t state hash followed by the chip8state, see chip8savestate.h
+//   DESTROY
+// sessions belong to the connection which created them and are destroyed with it
+namespace chip8protocol
+{
+    enum type : uint8_t { CREATE, LOAD, INPUT, STEP, FRAME, SNAPSHOT, DESTROY, NUM_TYPES };
+    enum status : uint8_t
+    {
+        OK,
+        BAD_REQUEST,    // unknown type or payload of the wrong size
+        NO_SESSION,     // id unknown or of another connection
+        FULL,           // no session left
+        HALTED,         // the programme couldn't be executed any further, the frames emulated are returned anyway
+        NO_ROM          // STEP before LOAD
+    };
+
+    struct header
+    {
+        uint32_t size;          // of the message in bytes, header included
+        uint8_t type;
+        uint8_t status;         // of responses, 0 in requests
+        uint16_t tag;           // chosen by the client and returned with the response
+        uint32_t session;
+    };
+
+    struct create
+    {
+        uint8_t quirks;         // chip8quirks
+        uint8_t reserved;
+        uint16_t commandsPerFrame;
+        uint32_t seed;
+    };
+
+    struct stepped
+    {
+        uint32_t frames;        // emulated, fewer than asked for if halted
+        uint32_t reserved;
+        uint64_t commands;      // of the session so far
+    };
+
+    static const uint32_t MAX_ROM = 0x1000 - 0x200;
+    static const uint32_t MAX_REQUEST = sizeof(header) + MAX_ROM; // a LOAD of the largest ROM
+}
+
+#endif
@@ -0,0 +1,54 @@
+#ifndef CHIP8QUIRKS_H
+#define CHIP8QUIRKS_H
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+// behaviours in which CHIP-8 interpreters differ, programmes usually rely on those of the platform they were written for
+struct chip8quirks
+{
+    enum flag : uint8_t
+    {
+        VF_RESET     = 0x01, // AND, OR and XOR reset VF
+        INCREMENT_I  = 0x02, // LD [I], Vx and LD Vx, [I] increment I
+        SHIFT_VY     = 0x04, // SHR and SHL shift Vy into Vx instead of shifting Vx
+        JUMP_VX      = 0x08, // JP V0, addr jumps to addr + Vx (x is the high nibble of addr)
+        CLIP         = 0x10, // sprites are clipped at the screen border instead of wrapped
+    };
+
+    // profiles of the common platforms
+    static const uint8_t CHIP8 = VF_RESET | INCREMENT_I | SHIFT_VY | CLIP;
+    static const uint8_t SCHIP = JUMP_VX | CLIP;
+    static const uint8_t XOCHIP = INCREMENT_I | SHIFT_VY;
+
+    static const char* name(uint8_t quirks)
+    {
+        switch(quirks)
+        {
+        case CHIP8: return "chip8";
+        case SCHIP: return "schip";
+        case XOCHIP: return "xochip";
+        default: return "custom";
+        }
+    }
+
+    // profile name or hex mask of flags, e.g. "schip" or "13"
+    static bool parse(const char *s, uint8_t &quirks)
+    {
+        if(!std::strcmp(s, "chip8")) quirks = CHIP8;
+        else if(!std::strcmp(s, "schip")) quirks = SCHIP;
+        else if(!std::strcmp(s, "xochip")) quirks = XOCHIP;
+        else
+        {
+            char *end;
+            unsigned long mask = std::strtoul(s, &end, 16);
+            if(!*s || *end || mask > 0x1F)
+                return false;
+            quirks = uint8_t(mask);
+        }
+        return true;
+    }
+};
+
+#endif
@@ -0,0 +1,77 @@
+#ifndef CHIP8RING_H
+#define CHIP8RING_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+
+// lock-free ring buffer for exactly one producer and one consumer thread
+// NOTE indices only grow and are masked on access, s.t. full and empty are told apart without wasting a slot; head and
+// tail live on their own cache lines, so the threads don't invalidate each other's line on every access
+template<typename T, size_t N>
+class chip8ring
+{
+    static_assert(N > 0 && (N & (N - 1)) == 0, "capacity of chip8ring must be a power of two");
+
+public:
+    chip8ring() : head{0}, tail{0} {}
+    chip8ring(const chip8ring &o) = delete;
+    chip8ring& operator=(const chip8ring &o) = delete;
+
+    // producer, returns false if the ring is full
+    bool push(const T &value)
+    {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if(t - head.load(std::memory_order_acquire) == N)
+            return false;
+        buffer[t & (N - 1)] = value;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    // consumer, returns false if the ring is empty
+    bool pop(T &value)
+    {
+        size_t h = head.load(std::memory_order_relaxed);
+        if(h == tail.load(std::memory_order_acquire))
+            return false;
+        value = buffer[h & (N - 1)];
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    // producer, copies as many values as fit and publishes them at once, returns their number
+    size_t write(const T *values, size_t n)
+    {
+        size_t t = tail.load(std::memory_order_relaxed);
+        n = std::min(n, N - (t - head.load(std::memory_order_acquire)));
+        size_t i = t & (N - 1), first = std::min(n, N - i);
+        std::copy(values, values + first, buffer + i);
+        std::copy(values + first, values + n, buffer);
+        tail.store(t + n, std::memory_order_release);
+        return n;
+    }
+
+    // consumer, takes as many values as are available up to n, returns their number
+    size_t read(T *values, size_t n)
+    {
+        size_t h = head.load(std::memory_order_relaxed);
+        n = std::min(n, tail.load(std::memory_order_acquire) - h);
+        size_t i = h & (N - 1), first = std::min(n, N - i);
+        std::copy(buffer + i, buffer + i + first, values);
+        std::copy(buffer, buffer + n - first, values + first);
+        head.store(h + n, std::memory_order_release);
+        return n;
+    }
+
+    bool empty() const { return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire); }
+    size_t size() const { return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire); }
+    static constexpr size_t capacity() { return N; }
+
+private:
+    alignas(64) std::atomic<size_t> head;
+    alignas(64) std::atomic<size_t> tail;
+    alignas(64) T buffer[N];
+};
+
+#endif
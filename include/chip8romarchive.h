@@ -0,0 +1,61 @@
+#ifndef CHIP8ROMARCHIVE_H
+#define CHIP8ROMARCHIVE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// archive of many ROMs packed into one file (.c8a), written by chip8-pack
+// layout (host byte order, all offsets in bytes from start of file):
+//   header | entry[nEntries] | string table | ROM data
+// entries are sorted by name, s.t. a ROM is found by bisection on the mapped file and loaded without any syscall
+class chip8romarchive
+{
+public:
+    struct header
+    {
+        char magic[4];        // "C8RA"
+        uint32_t version;
+        uint32_t nEntries;
+        uint32_t offEntries;
+        uint32_t offStrings;
+        uint32_t lenStrings;
+    };
+    struct entry
+    {
+        uint32_t name;        // offset into string table, file name without directories
+        uint32_t size;        // size of ROM in bytes
+        uint64_t hash;        // chip8hash of ROM
+        uint64_t offset;      // offset of ROM data
+    };
+
+    static const uint32_t VERSION = 1;
+
+    // packs ROM files into an archive, ROMs are named by their file names, which thus have to be unique
+    static bool pack(const std::vector<std::string> &files, const std::string &path);
+
+    chip8romarchive();
+    ~chip8romarchive();
+    chip8romarchive(const chip8romarchive &o) = delete;
+    chip8romarchive& operator=(const chip8romarchive &o) = delete;
+
+    bool open(const std::string &path, bool verbose = true);
+    void close();
+    bool is_open() const { return data != nullptr; }
+
+    uint32_t size() const { return is_open() ? hdr->nEntries : 0; }
+    const entry& at(uint32_t i) const { return entries[i]; }
+    const entry* find(const std::string &name) const;
+    const char* name(const entry &e) const { return strings + e.name; }
+    const uint8_t* rom(const entry &e) const { return data + e.offset; }
+
+private:
+    const uint8_t *data;
+    size_t length;
+    const header *hdr;
+    const entry *entries;
+    const char *strings;
+};
+
+#endif
@@ -0,0 +1,125 @@
+#ifndef CHIP8ROMINDEX_H
+#define CHIP8ROMINDEX_H
+
+#include "chip8decoder.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// persistent cross reference index over a ROM library (.idx), written by chip8-index
+// layout (host byte order, all offsets in bytes from start of file):
+//   header | rom[nRoms] | subroutine[nSubroutines] | word[nWords] | string table
+// roms are sorted by name and refer to ranges of the word and subroutine tables, s.t. queries run on the mapped
+// file without any parsing
+class chip8romindex
+{
+public:
+    struct header
+    {
+        char magic[4];            // "C8IX"
+        uint32_t version;
+        uint32_t nRoms;
+        uint32_t nWords;
+        uint32_t nSubroutines;
+        uint32_t offRoms;
+        uint32_t offWords;
+        uint32_t offSubroutines;
+        uint32_t offStrings;
+        uint32_t lenStrings;
+    };
+    struct rom
+    {
+        uint32_t name;            // offset into string table
+        uint32_t size;            // file size in bytes
+        int64_t mtime;            // modification time of file in ns, used for incremental updates
+        uint64_t hash;            // chip8hash of content
+        uint32_t firstWord;       // distinct commands reached from the entry point, sorted
+        uint32_t nWords;
+        uint32_t firstSubroutine; // entry points, the first one is the programme entry at 0x200
+        uint32_t nSubroutines;
+        uint32_t codeBytes;
+        uint32_t dataBytes;
+        uint32_t extensions;      // bit e is set if extension e of chip8decoder::extension is used
+        uint8_t quirks;           // recommended chip8quirks profile
+        uint8_t reserved[3];
+        uint32_t histogram[chip8decoder::NUM_KINDS]; // number of reached commands per kind
+    };
+    struct subroutine
+    {
+        uint64_t pattern;         // hash of the commands of the subroutine with addresses masked out
+        uint16_t addr;
+        uint16_t length;          // number of commands hashed
+        uint32_t reserved;
+    };
+
+    static const uint32_t VERSION = 1;
+
+    // scans ROM files in parallel and writes the index, unchanged files are taken over from a previous index
+    class builder
+    {
+    public:
+        builder(int nthreads) : nthreads(nthreads), nScanned(0), nReused(0), nFailed(0) {};
+
+        void scan(const std::vector<std::string> &files, const chip8romindex *previous);
+        bool write(const std::string &path) const;
+
+        int nthreads;
+        size_t nScanned;
+        size_t nReused;
+        size_t nFailed;
+        std::string errors;
+
+    private:
+        struct entry
+        {
+            std::string name;
+            rom r;
+            std::vector<uint16_t> words;
+            std::vector<subroutine> subroutines;
+            bool ok = false;
+            bool reused = false;
+            std::string error;
+        };
+
+        std::vector<entry> entries;
+    };
+
+    chip8romindex();
+    ~chip8romindex();
+    chip8romindex(const chip8romindex &o) = delete;
+    chip8romindex& operator=(const chip8romindex &o) = delete;
+
+    bool open(const std::string &path, bool verbose = true);
+    void close();
+    bool is_open() const { return data != nullptr; }
+
+    uint32_t size() const { return is_open() ? hdr->nRoms : 0; }
+    const rom& at(uint32_t i) const { return roms[i]; }
+    const rom* find(const std::string &name) const;
+    const char* name(const rom &r) const;
+    const uint16_t* words(const rom &r) const { return words_ + r.firstWord; }
+    const subroutine* subroutines(const rom &r) const { return subroutines_ + r.firstSubroutine; }
+
+    // queries, each returns the matching ROMs in the order of the index
+    std::vector<const rom*> usingOpcode(uint16_t mask, uint16_t value) const;
+    std::vector<const rom*> usingExtensions(uint32_t extensions) const;
+    std::vector<const rom*> withSubroutine(uint64_t pattern) const;
+
+    static bool analyze(const uint8_t *data, size_t len, rom &r, std::vector<uint16_t> &words,
+                        std::vector<subroutine> &subroutines);
+
+private:
+    const uint8_t *data;
+    size_t length;
+    const header *hdr;
+    const rom *roms;
+    const uint16_t *words_;
+    const subroutine *subroutines_;
+    const char *strings;
+};
+
+// parse opcode pattern like "Fx75" or "00FF", hex digits have to match and any other char is a wildcard
+bool parseOpcodePattern(const std::string &pattern, uint16_t &mask, uint16_t &value);
+
+#endif
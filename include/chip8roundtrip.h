@@ -0,0 +1,39 @@
+#ifndef CHIP8ROUNDTRIP_H
+#define CHIP8ROUNDTRIP_H
+
+#include "chip8parallel.h"
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// verifies disassembler and assembler against each other: every ROM is disassembled to source,
+// assembled again and the result is compared byte by byte with the original ROM
+class chip8roundtrip
+{
+public:
+    chip8roundtrip(const std::vector<std::string> &inputs, int nthreads, bool keepSource = false);
+    ~chip8roundtrip() {};
+
+    bool run();
+    void printSummary();
+
+private:
+    struct job
+    {
+        std::string input;
+        size_t bytes = 0;
+        size_t lines = 0;
+        long mismatch = -1; // offset of first differing byte, -1 if identical
+        bool ok = false;
+        std::string errors;
+    };
+
+    void worker(chip8parallel::cursor &c);
+
+    std::vector<job> jobs;
+    int nthreads;
+    bool keepSource;
+    double seconds;
+};
+
+#endif
@@ -0,0 +1,89 @@
+#ifndef CHIP8SAVESTATE_H
+#define CHIP8SAVESTATE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+class chip8processor;
+
+// complete state of a chip8processor, one section after the other at fixed offsets
+struct chip8state
+{
+    uint8_t ram[4096];
+    struct
+    {
+        uint8_t V[16];
+        uint16_t PC;
+        uint16_t I;
+        uint8_t SP;
+        uint8_t running;
+        uint16_t lenProgram;
+        uint16_t command;     // last fetched command
+        uint16_t reserved[3];
+    } registers;
+    uint16_t stack[16];
+    struct
+    {
+        uint16_t DT;
+        uint16_t ST;
+    } timers;
+    uint32_t rng;             // state of xorshift32
+    uint64_t framebuffer[32];
+};
+static_assert(sizeof(chip8state) == 4096 + 32 + 32 + 4 + 4 + 256, "layout of chip8state must not change");
+
+// save state file (.c8s)
+// layout (host byte order): header | chip8state, either as is or LZ compressed
+// uncompressed states are used straight from the mapped file, s.t. restoring one is a copy of each section into place
+class chip8savestate
+{
+public:
+    struct header
+    {
+        char magic[4];        // "C8SS"
+        uint32_t version;
+        uint8_t quirks;       // chip8quirks the state was recorded with
+        uint8_t compressed;
+        uint16_t reserved;
+        uint32_t size;        // size of state behind header in bytes
+        uint64_t romHash;     // chip8processor::rom_hash() of the ROM the state belongs to
+        uint64_t stateHash;   // chip8processor::state_hash() of the state, verified when restoring
+    };
+
+    static const uint32_t VERSION = 2;
+
+    static bool save(const chip8processor &chip8, const std::string &path, bool compress);
+
+    chip8savestate();
+    ~chip8savestate();
+    chip8savestate(const chip8savestate &o) = delete;
+    chip8savestate& operator=(const chip8savestate &o) = delete;
+
+    bool open(const std::string &path, bool verbose = true);
+    void close();
+    bool is_open() const { return data != nullptr; }
+
+    const header& info() const { return *hdr; }
+    const chip8state& state() const { return *pState; }
+
+    // sets state and quirks of chip8, which has to run the ROM the state was saved for
+    // if verified the state is hashed and compared with the saved hash, otherwise the saved hash is taken over
+    bool restore(chip8processor &chip8, bool verify = true) const;
+
+private:
+    const uint8_t *data;
+    size_t length;
+    const header *hdr;
+    const chip8state *pState;
+    std::unique_ptr<chip8state> decompressed;
+};
+
+// LZ77 compression in the block format of LZ4, returns size of dst
+size_t chip8lzCompress(const uint8_t *src, size_t len, std::vector<uint8_t> &dst);
+// returns false if src is corrupt or doesn't decompress to exactly dstLen bytes
+bool chip8lzDecompress(const uint8_t *src, size_t len, uint8_t *dst, size_t dstLen);
+
+#endif
@@ -0,0 +1,58 @@
+#ifndef CHIP8SCALER_H
+#define CHIP8SCALER_H
+
+#include <cstddef>
+#include <cstdint>
+
+// expands the 1 bit 64x32 display into an RGBA8888 buffer zoomed by an integer factor ("macro pixels"), which any
+// frontend can upload or encode as is
+// a display row is turned into 64 colors at once by expanding its bits to masks and selecting the on or off color by
+// them, the colors are repeated horizontally into one zoomed line, which is then written to the buffer once per
+// zoomed row by streaming stores, s.t. the buffer doesn't evict everything else from the cache
+// with phosphor decay a pixel doesn't go dark at once but fades by the given fraction per frame, which hides the
+// flicker of sprites drawn by XOR
+class chip8scaler
+{
+public:
+    enum isa { AUTO, SCALAR, SSE2, AVX2 };
+
+    // decay is the intensity kept per frame by a pixel turned off in 1/256, 0 to switch it off at once
+    // NOTE streaming stores pay off if the buffer is consumed by another core or device, but are slower than regular
+    // stores if it is read back by the same core while still cached
+    chip8scaler(int scale, uint32_t on = 0xFFFFFFFF, uint32_t off = 0xFF000000, int decay = 0, isa use = AUTO,
+                bool streaming = true);
+    ~chip8scaler();
+    chip8scaler(const chip8scaler &o) = delete;
+    chip8scaler& operator=(const chip8scaler &o) = delete;
+
+    // only the given rows and column blocks are rendered again, see chip8processor::dirty_rows(), besides rows still
+    // fading, returns the number of rows rendered
+    int render(const uint64_t *framebuffer, uint32_t dirtyRows = 0xFFFFFFFF, uint8_t dirtyCols = 0xFF);
+
+    // NOTE colors are words of 0xAABBGGRR, i.e. bytes R, G, B, A in memory on little endian hosts
+    const uint32_t* pixels() const { return buffer; }
+    int width() const { return 64 * scale; }
+    int height() const { return 32 * scale; }
+    size_t size() const { return size_t(width()) * height() * sizeof(uint32_t); }
+    isa instruction_set() const { return use; }
+    bool is_streaming() const { return streaming; }
+    static const char* name(isa i);
+
+private:
+    void colorRow(int row, uint64_t bits, uint32_t *colors);
+    void store(uint32_t *dst, const uint32_t *src, size_t n);
+
+    int scale;
+    uint32_t on;
+    uint32_t off;
+    int decay;
+    isa use;
+    bool streaming;
+    uint32_t *buffer;
+    uint32_t *line;             // one zoomed line
+    uint8_t intensity[64 * 32]; // per pixel for phosphor decay
+    uint32_t fadingRows;        // rows with pixels neither fully on nor off
+    uint32_t palette[256];      // color of each intensity
+};
+
+#endif
@@ -0,0 +1,99 @@
+#ifndef CHIP8SERVER_H
+#define CHIP8SERVER_H
+
+#include "chip8processor.h"
+#include "chip8protocol.h"
+#include "chip8ring.h"
+#include <atomic>
+#include <memory>
+#include <stdio.h>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// hosts many chip8processor sessions for clients of a Unix domain socket, see chip8protocol.h
+// the main thread accepts connections and hands each to one of the workers in turn, a thread pinned to a core of its
+// own with an epoll loop over its connections; a connection and all of its sessions only ever run on that worker, so
+// nothing is shared between workers and nothing is locked
+// NOTE sessions live in a slab preallocated per worker, a session is created by resetting a free slot to a blank
+// processor, which reuses its memory, s.t. creating and destroying sessions never allocates
+class chip8server
+{
+public:
+    chip8server(int nWorkers, size_t nSessions);
+    ~chip8server();
+    chip8server(const chip8server &o) = delete;
+    chip8server& operator=(const chip8server &o) = delete;
+
+    // replaces a stale socket of the same path
+    bool listen(const std::string &path);
+    // accepts connections till stop() is called, then waits for the workers to end
+    void run();
+    // may be called from a signal handler
+    void stop();
+
+    void print(FILE *out) const;
+
+private:
+    struct session
+    {
+        session() : chip8{true}, sent{}, generation{0}, owner{-1}, commandsPerFrame{0}, quirks{0}, seed{0},
+                    loaded{false}, halted{false}, commands{0} {}
+        chip8processor chip8;
+        uint64_t sent[32];          // display as of the last FRAME, deltas are relative to it
+        uint32_t generation;        // part of the id, s.t. ids of destroyed sessions don't reach their successors
+        int owner;                  // socket of the connection the session belongs to, -1 if the slot is free
+        uint16_t commandsPerFrame;
+        uint8_t quirks;             // of CREATE, restored whenever a ROM is loaded
+        uint32_t seed;
+        bool loaded;
+        bool halted;
+        uint64_t commands;
+    };
+
+    struct connection
+    {
+        int fd;
+        std::vector<uint8_t> in;    // received, not yet complete requests
+        std::vector<uint8_t> out;   // responses not yet written
+        size_t outDone;
+        bool writing;               // waits for the socket to take more
+        std::vector<uint32_t> sessions;
+    };
+
+    struct worker
+    {
+        int core;
+        int epoll;
+        int wakeup;                 // eventfd the main thread signals new connections and stopping by
+        chip8ring<int, 1024> accepted;
+        std::thread thread;
+        std::unordered_map<int, std::unique_ptr<connection>> connections;
+        std::vector<session> slab;
+        std::vector<uint32_t> freeSlots;
+        // statistics
+        uint64_t nConnections;
+        uint64_t requests;
+        uint64_t frames;
+        size_t peakSessions;
+    };
+
+    void serve(worker &w);
+    bool receive(worker &w, connection &c);
+    bool send(worker &w, connection &c);
+    void handle(worker &w, connection &c, const chip8protocol::header &req, const uint8_t *payload, size_t n);
+    void close(worker &w, connection &c);
+    void reset(session &s);
+    session* find(worker &w, connection &c, uint32_t id);
+
+    const chip8processor blank;     // state every session starts from
+    std::vector<std::unique_ptr<worker>> workers;
+    int listener;
+    int epoll;
+    std::string path;
+    std::atomic<bool> stopping;
+    int wakeup;                     // eventfd to end run()
+};
+
+#endif
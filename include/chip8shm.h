@@ -0,0 +1,80 @@
+#ifndef CHIP8SHM_H
+#define CHIP8SHM_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+class chip8processor;
+class chip8supervisor;
+
+// POSIX shared memory segment (/dev/shm/NAME) a running emulator publishes its display, registers and counters in,
+// s.t. external viewers and dashboards can watch headless instances without slowing them down
+// layout (host byte order): header, written once when created | snapshot, published once per frame under a seqlock
+// the publisher makes the sequence odd, writes the snapshot and makes it even again; a reader copies the snapshot
+// between two reads of an even, unchanged sequence, else it retries, so publishing never waits for readers and costs
+// no system call, and readers never see a snapshot half written
+class chip8shm
+{
+public:
+    struct snapshot
+    {
+        uint64_t framebuffer[32];
+        uint8_t V[16];
+        uint16_t stack[16];
+        uint16_t PC;
+        uint16_t I;
+        uint16_t DT;
+        uint16_t ST;
+        uint8_t SP;
+        uint8_t reason;           // chip8supervisor::reason, RUNNING till emulation stopped
+        uint16_t keys;
+        uint32_t reserved;
+        uint64_t commands;
+        uint64_t frames;
+        uint64_t displayChanges;
+        uint64_t stateHash;
+    };
+    struct header
+    {
+        char magic[4];            // "C8SH"
+        uint32_t version;
+        uint32_t size;            // of the segment in bytes
+        int32_t pid;              // of the publisher
+        uint64_t romHash;
+        uint8_t quirks;
+        uint8_t reserved[3];
+        int32_t commandsPerFrame;
+        char rom[48];             // file name of the ROM, NUL terminated
+        alignas(64) std::atomic<uint64_t> sequence; // odd while the snapshot is written
+        snapshot data;
+    };
+
+    static const uint32_t VERSION = 1;
+
+    chip8shm();
+    ~chip8shm();
+    chip8shm(const chip8shm &o) = delete;
+    chip8shm& operator=(const chip8shm &o) = delete;
+
+    // publisher: creates or replaces the segment, which is removed again by close()
+    bool create(const std::string &name, const std::string &rom, const chip8processor &chip8, int commandsPerFrame);
+    void publish(const chip8processor &chip8, const chip8supervisor &supervisor);
+    // reader: maps the segment read-only
+    bool attach(const std::string &name);
+    void close();
+
+    const header* info() const { return hdr; }
+    // reader: changes whenever a snapshot is published, i.e. a viewer needn't copy anything as long as it is the same
+    uint64_t sequence() const { return hdr->sequence.load(std::memory_order_acquire); }
+    // reader: copies a consistent snapshot, returns the number of attempts it took, 0 if the publisher died writing it
+    int read(snapshot &s) const;
+
+private:
+    header *hdr;
+    std::string name;
+    bool owner;               // created the segment
+};
+
+#endif
@@ -0,0 +1,82 @@
+#ifndef CHIP8SUPERVISOR_H
+#define CHIP8SUPERVISOR_H
+
+#include "chip8processor.h"
+#include <chrono>
+#include <cstdint>
+#include <stdio.h>
+
+// watches a running chip8processor: paces frames and timers, ends emulation on halt conditions and collects statistics
+// usage per command: fetch_command(), before_exec(), exec_command(), after_exec()
+class chip8supervisor
+{
+public:
+    enum reason
+    {
+        RUNNING,
+        ERROR,          // command couldn't be fetched or executed
+        SELF_JUMP,      // JP to its own address, which is how CHIP-8 programmes end
+        STEADY_STATE,   // state repeats, see chip8processor::detect_cycles()
+        IDLE_DISPLAY,   // display didn't change for the given number of frames
+        BREAKPOINT,     // PC reached the given address
+        BUDGET,         // given number of commands executed
+        INTERRUPTED,    // stopped from outside, e.g. by Ctrl-C
+        END_OF_MOVIE,   // all frames of a replayed movie are emulated
+        DESYNC,         // replay diverged from the recorded movie
+        NUM_REASONS
+    };
+
+    // NOTE zero or negative values disable a condition
+    struct conditions
+    {
+        bool selfJump = true;
+        bool steadyState = true;
+        uint64_t idleFrames = 0;
+        int breakpoint = -1;
+        uint64_t maxCommands = 0;
+        int commandsPerFrame = 10; // timers are decremented once per frame, i.e. at 60 Hz
+    };
+
+    chip8supervisor(chip8processor &chip8, const conditions &cond);
+
+    // returns false if the fetched command must not be executed, since emulation ends
+    bool before_exec(int PC);
+    // returns false if emulation ends, result is the one of exec_command()
+    bool after_exec(int result);
+    void interrupt() { stop(INTERRUPTED); }
+    // ends emulation for reasons known outside only, e.g. replays; overrule replaces the reason it ended for already
+    void halt(reason r, bool overrule = false) { if(overrule) why = RUNNING; stop(r); }
+
+    reason exit_reason() const { return why; }
+    static const char* name(reason r);
+    // 0 if the programme or replay ended by itself, 1 on errors, 2 if the budget is exhausted, 3 if interrupted and 4
+    // if a replay diverged
+    int exit_code() const;
+    // one line of key=value pairs, s.t. batch jobs can parse it
+    void print(FILE *out) const;
+    // rows and columns of the display written during the last frame, see chip8processor::dirty_rows()
+    // NOTE the dirty masks of the processor are cleared at the end of every frame, so frontends take these
+    uint32_t dirty_rows() const { return frameDirtyRows; }
+    uint8_t dirty_columns() const { return frameDirtyCols; }
+
+    uint64_t commands;
+    uint64_t frames;
+    uint64_t displayChanges;    // number of frames the display changed in
+
+private:
+    void stop(reason r);
+
+    chip8processor &chip8;
+    conditions cond;
+    reason why;
+    int commandsInFrame;
+    uint64_t idleFrames;
+    uint32_t frameDirtyRows;
+    uint8_t frameDirtyCols;
+    uint64_t lastDisplay[32];
+    uint16_t lastPC;
+    std::chrono::steady_clock::time_point start;
+    double seconds;
+};
+
+#endif
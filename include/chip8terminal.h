@@ -0,0 +1,52 @@
+#ifndef CHIP8TERMINAL_H
+#define CHIP8TERMINAL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <stdio.h>
+#include <string>
+
+// draws the 64x32 display into a terminal by ANSI escape sequences, e.g. over SSH
+// each character cell shows two pixel rows by the half block glyphs ' ', '▀', '▄' and '█', so the display takes 64x16 cells
+// NOTE only cells differing from the last presented frame are drawn, the cursor is moved over unchanged cells by the
+// shorter of a cursor movement and drawing them again, and all of a frame goes to the terminal by one write()
+class chip8terminal
+{
+public:
+    static const int ROWS = 16;
+    static const int COLS = 64;
+
+    chip8terminal(int fd = 1);
+    ~chip8terminal();
+    chip8terminal(const chip8terminal &o) = delete;
+    chip8terminal& operator=(const chip8terminal &o) = delete;
+
+    // clears the terminal and hides the cursor
+    bool open();
+    // moves the cursor below the display and shows it again
+    void close();
+
+    // returns the number of bytes written, 0 if nothing changed
+    // only the given display rows are compared, see chip8processor::dirty_rows(), a frame without any is skipped
+    size_t present(const uint64_t *framebuffer, uint32_t dirtyRows = 0xFFFFFFFF);
+
+    void print(FILE *out) const;
+
+private:
+    void moveTo(const uint64_t *framebuffer, int row, int col);
+    void put(int glyph);
+    bool flush();
+
+    int fd;
+    bool opened;
+    uint64_t shown[32];     // frame the terminal shows
+    std::string out;        // escape sequences of the frame being presented
+    int cursorRow;          // 0-based cell the cursor is at
+    int cursorCol;
+    uint64_t frames;
+    uint64_t presented;     // frames anything was written for
+    uint64_t skipped;       // frames without dirty rows
+    uint64_t bytes;
+};
+
+#endif
@@ -0,0 +1,50 @@
+#ifndef CHIP8ZOBRIST_H
+#define CHIP8ZOBRIST_H
+
+#include <array>
+#include <cstdint>
+
+// keys of the incremental state hash of chip8processor
+// the hash is the XOR of key(position, value) over every byte of memory, every register, stack entry and display row,
+// s.t. a write changes it in O(1) by XORing out the key of the old value and XORing in the key of the new one
+// NOTE instead of a table of 256 keys per position, which would be 8 MB for the memory alone, the key of a value is
+// derived from a per position key by a mixing function
+struct chip8zobrist
+{
+    enum position : uint32_t
+    {
+        RAM = 0,
+        V = RAM + 4096,
+        STACK = V + 16,
+        PC = STACK + 16, I, SP, DT, ST, RNG,
+        DISPLAY,
+        NUM_POSITIONS = DISPLAY + 32
+    };
+
+    // finalizer of splitmix64
+    static constexpr uint64_t mix(uint64_t z)
+    {
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        return z ^ (z >> 31);
+    }
+
+    static constexpr std::array<uint64_t, NUM_POSITIONS> makeKeys()
+    {
+        std::array<uint64_t, NUM_POSITIONS> t{};
+        for(uint32_t p = 0; p < NUM_POSITIONS; ++p)
+            t[p] = mix(0x9e3779b97f4a7c15ULL * (p + 1));
+        return t;
+    }
+
+    static uint64_t key(uint32_t pos, uint64_t value);
+};
+
+inline constexpr std::array<uint64_t, chip8zobrist::NUM_POSITIONS> chip8zobristkeys = chip8zobrist::makeKeys();
+
+inline uint64_t chip8zobrist::key(uint32_t pos, uint64_t value)
+{
+    return mix(chip8zobristkeys[pos] ^ value);
+}
+
+#endif
@@ -0,0 +1,377 @@
+#include "chip8analyzer.h"
+#include "chip8decoder.h"
+#include <algorithm>
+#include <cstdlib>
+
+// max. number of entries of a jump table behind JP V0, addr
+static const uint32_t nMaxJumpTable = 128;
+// max. number of times a command is revisited to propagate another value of I
+static const uint8_t nMaxVisits = 4;
+
+chip8analyzer::chip8analyzer(const uint8_t *image, size_t len, uint32_t base)
+    : codeBytes(0), dataBytes(0), image(image), len(len), base(base)
+{
+}
+
+uint32_t chip8analyzer::length(uint32_t addr) const
+{
+    // XO-CHIP's LD I, long is followed by a 16 bit address, all other commands are 2 bytes
+    return word(addr) == 0xF000 ? 4 : 2;
+}
+
+uint16_t chip8analyzer::word(uint32_t addr) const
+{
+    // NOTE a command at the very end of an odd sized image is completed by a zero byte, like it would be in memory
+    if(!contains(addr)) return 0;
+    return (image[addr - base] << 8) | (contains(addr + 1) ? image[addr + 1 - base] : 0);
+}
+
+void chip8analyzer::analyze()
+{
+    flagTable.assign(len, UNKNOWN);
+    knownI.assign(len, -1);
+    nVisits.assign(len, 0);
+    blocks.clear();
+    calls.clear();
+    worklist.clear();
+
+    // programmes start at the image base, which is the only entry point known without following code
+    push(base, base, -1, FUNCTION);
+    traverse();
+    buildBlocks();
+    std::sort(calls.begin(), calls.end(), [](const call &a, const call &b) {
+        return a.caller != b.caller ? a.caller < b.caller : a.site < b.site;
+    });
+
+    codeBytes = dataBytes = 0;
+    for(uint8_t f : flagTable)
+    {
+        if(f & (CODE | OPERAND)) ++codeBytes;
+        else if(f & DATA) ++dataBytes;
+    }
+}
+
+void chip8analyzer::push(uint32_t addr, uint32_t function, int32_t I, uint8_t reason)
+{
+    if(!contains(addr)) return;
+    flagTable[addr - base] |= reason | LEADER;
+    worklist.push_back(item{addr, function, I});
+}
+
+void chip8analyzer::markData(int32_t I, uint32_t n)
+{
+    // NOTE only sprites and operands at a known I are marked, tables indexed by ADD I, Vx stay unknown
+    if(I < 0) return;
+    for(uint32_t addr = I; addr < uint32_t(I) + n; ++addr)
+        if(contains(addr)) flagTable[addr - base] |= DATA;
+}
+
+// heuristic for JP V0, addr: addr itself is a target and so is every JP directly following it,
+// which is how jump tables indexed by V0 are written
+template<typename F>
+static void forJumpTable(const chip8analyzer &a, uint32_t addr, F f)
+{
+    f(addr);
+    for(uint32_t k = 1; k < nMaxJumpTable; ++k)
+    {
+        uint32_t entry = addr + 2*k;
+        if(!a.contains(entry + 1) || chip8decoder::decode(a.word(entry)).k != chip8decoder::JP_addr) break;
+        f(entry);
+    }
+}
+
+static bool isSkip(chip8decoder::kind k)
+{
+    switch(k)
+    {
+    case chip8decoder::SE_Vx_byte: case chip8decoder::SNE_Vx_byte: case chip8decoder::SE_Vx_Vy:
+    case chip8decoder::SNE_Vx_Vy: case chip8decoder::SKP_Vx: case chip8decoder::SKNP_Vx:
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool chip8analyzer::visit(uint32_t addr, int32_t I)
+{
+    uint32_t i = addr - base;
+    if(flagTable[i] & CODE)
+    {
+        if(I < 0 || I == knownI[i] || nVisits[i] >= nMaxVisits)
+            return false;
+    }
+    knownI[i] = I;
+    ++nVisits[i];
+    return true;
+}
+
+void chip8analyzer::traverse()
+{
+    // follow each entry linearly until control flow leaves, branches are pushed to the worklist
+    // NOTE commands are revisited if they are reached with another known value of I, s.t. sprites selected
+    // by branches (e.g. LD I, a / SE / LD I, b / DRW) are found, this is bounded by nMaxVisits
+    while(!worklist.empty())
+    {
+        item it = worklist.back();
+        worklist.pop_back();
+        uint32_t addr = it.addr;
+        int32_t I = it.I;
+        bool falls = true, fresh = false;
+        while(falls && contains(addr) && visit(addr, I))
+        {
+            uint16_t w = word(addr);
+            chip8decoder::instruction ins = chip8decoder::decode(w);
+            chip8decoder::extension ext = chip8decoder::classifyExtension(w);
+            if(ins.k == chip8decoder::UNKNOWN && ext == chip8decoder::NO_EXTENSION)
+                break; // ran into data
+            bool first = !(flagTable[addr - base] & CODE);
+            fresh = first;
+            flagTable[addr - base] |= CODE;
+            uint32_t size = length(addr);
+            for(uint32_t k = 1; k < size; ++k)
+                if(contains(addr + k)) flagTable[addr + k - base] |= OPERAND;
+
+            // SCHIP and XO-CHIP commands don't branch, only EXIT ends the programme
+            if(ext != chip8decoder::NO_EXTENSION)
+            {
+                switch(ext)
+                {
+                case chip8decoder::EXIT: falls = false; break;
+                case chip8decoder::LD_I_long: I = word(addr + 2); break;
+                case chip8decoder::DRW_Vx_Vy_0: markData(I, 32); break;
+                case chip8decoder::SAVE_Vx_Vy:
+                case chip8decoder::LOAD_Vx_Vy: markData(I, std::abs(ins.y - ins.x) + 1); break;
+                case chip8decoder::LD_HF_Vx: I = -1; break;
+                default: break;
+                }
+                addr += size;
+                continue;
+            }
+
+            switch(ins.k)
+            {
+            case chip8decoder::RET:
+                falls = false;
+                break;
+            case chip8decoder::JP_addr:
+                push(ins.nnn, it.function, I, TARGET);
+                falls = false;
+                break;
+            case chip8decoder::JP_V0_addr:
+                forJumpTable(*this, ins.nnn, [&](uint32_t t) { push(t, it.function, I, TARGET); });
+                falls = false;
+                break;
+            case chip8decoder::CALL_addr:
+                if(first) calls.push_back(call{it.function, addr, ins.nnn});
+                push(ins.nnn, ins.nnn, I, FUNCTION);
+                I = -1; // the subroutine may change I
+                break;
+            case chip8decoder::LD_I_addr:
+                I = ins.nnn;
+                break;
+            case chip8decoder::ADD_I_Vx:
+            case chip8decoder::LD_F_Vx:
+                I = -1;
+                break;
+            case chip8decoder::DRW_Vx_Vy_nibble:
+                markData(I, ins.n ? ins.n : 32); // DRW with n=0 draws a 16x16 sprite on SCHIP
+                break;
+            case chip8decoder::LD_B_Vx:
+                markData(I, 3);
+                break;
+            case chip8decoder::LD_I_Vx:
+            case chip8decoder::LD_Vx_I:
+                markData(I, ins.x + 1);
+                I = -1; // NOTE whether I is incremented depends on the interpreter
+                break;
+            default:
+                if(isSkip(ins.k))
+                {
+                    push(addr + 2 + length(addr + 2), it.function, I, LEADER);
+                    if(contains(addr + 2)) flagTable[addr + 2 - base] |= LEADER;
+                }
+                break;
+            }
+            addr += size;
+        }
+        // falling from new code into code decoded before joins two paths, s.t. a new block starts there
+        if(falls && fresh && contains(addr) && (flagTable[addr - base] & CODE))
+            flagTable[addr - base] |= LEADER;
+    }
+}
+
+void chip8analyzer::buildBlocks()
+{
+    // each block starts at a leader and runs until a branch or the next leader
+    for(uint32_t start = base; start < base + len; ++start)
+    {
+        if((flagTable[start - base] & (CODE | LEADER)) != (CODE | LEADER))
+            continue;
+        block b{start, start, {}};
+        for(uint32_t addr = start;; addr = b.end)
+        {
+            chip8decoder::instruction ins = chip8decoder::decode(word(addr));
+            uint32_t next = addr + length(addr);
+            auto succ = [&](uint32_t t) { if(flags(t) & CODE) b.succ.push_back(t); };
+            b.end = next;
+            if(ins.k == chip8decoder::RET || chip8decoder::classifyExtension(word(addr)) == chip8decoder::EXIT)
+                break;
+            if(ins.k == chip8decoder::JP_addr)
+            {
+                succ(ins.nnn);
+                break;
+            }
+            if(ins.k == chip8decoder::JP_V0_addr)
+            {
+                forJumpTable(*this, ins.nnn, succ);
+                break;
+            }
+            if(isSkip(ins.k))
+            {
+                succ(next);
+                succ(next + length(next));
+                break;
+            }
+            if(!(flags(next) & CODE))
+                break; // fell into data, the command behind is not executable
+            if(flags(next) & LEADER)
+            {
+                succ(next);
+                break;
+            }
+        }
+        blocks.push_back(std::move(b));
+    }
+}
+
+void chip8analyzer::print(FILE *out) const
+{
+    fprintf(out, "######## CALL GRAPH ########\n");
+    for(size_t i = 0; i < calls.size();)
+    {
+        uint32_t caller = calls[i].caller;
+        fprintf(out, "0x%03x ->", caller);
+        for(; i < calls.size() && calls[i].caller == caller; ++i)
+            fprintf(out, " 0x%03x", calls[i].callee);
+        fprintf(out, "\n");
+    }
+
+    fprintf(out, "######## RECURSIVE DISASSEMBLY ########\n");
+    // NOTE the listing follows the commands aligned to the first one of each run, commands overlapping those
+    // at odd offsets are still part of the basic blocks but not listed
+    size_t iBlock = 0;
+    for(uint32_t addr = base; addr < base + len;)
+    {
+        uint8_t f = flags(addr);
+        if(f & CODE)
+        {
+            if(f & FUNCTION) fprintf(out, "# function 0x%03x\n", addr);
+            for(; iBlock < blocks.size() && blocks[iBlock].start < addr; ++iBlock);
+            if(iBlock < blocks.size() && blocks[iBlock].start == addr)
+            {
+                fprintf(out, "# block 0x%03x-0x%03x ->", blocks[iBlock].start, blocks[iBlock].end);
+                for(uint32_t s : blocks[iBlock].succ) fprintf(out, " 0x%03x", s);
+                fprintf(out, "\n");
+            }
+            size_t n = std::min<size_t>(length(addr), base + len - addr);
+            chip8disassemble(image + (addr - base), n, addr, out);
+            addr += length(addr);
+            continue;
+        }
+        // bytes which are not executed, grouped by whether they are referenced
+        uint8_t kind = f & DATA;
+        fprintf(out, "0x%03x: %s", addr, kind ? "data      " : "unreached ");
+        for(int n = 0; n < 8 && addr < base + len && !(flags(addr) & CODE) && (flags(addr) & DATA) == kind; ++n, ++addr)
+            fprintf(out, " %02x", image[addr - base]);
+        fprintf(out, "\n");
+    }
+
+    fprintf(out, "######## SUMMARY ########\n");
+    size_t nFunctions = std::count_if(flagTable.begin(), flagTable.end(), [](uint8_t f) {
+        return (f & (CODE | FUNCTION)) == (CODE | FUNCTION);
+    });
+    fprintf(out, "%zu bytes: %zu code, %zu data, %zu unreached\n", len, codeBytes, dataBytes, len - codeBytes - dataBytes);
+    fprintf(out, "%zu basic blocks, %zu functions, %zu calls\n", blocks.size(), nFunctions, calls.size());
+}
+
+// commands which chip8assembler encodes with their unused fields set to 0, all others can only be reproduced as data
+static bool assemblable(const chip8decoder::instruction &ins)
+{
+    switch(ins.k)
+    {
+    case chip8decoder::UNKNOWN: case chip8decoder::SYS:
+        return false;
+    case chip8decoder::SE_Vx_Vy: case chip8decoder::SNE_Vx_Vy:
+        return ins.n == 0;
+    case chip8decoder::SHR_Vx: case chip8decoder::SHL_Vx:
+        return ins.y == 0;
+    default:
+        return true;
+    }
+}
+
+static bool hasAddress(chip8decoder::kind k)
+{
+    return k == chip8decoder::JP_addr || k == chip8decoder::CALL_addr ||
+           k == chip8decoder::LD_I_addr || k == chip8decoder::JP_V0_addr;
+}
+
+std::string chip8analyzer::label(uint32_t addr) const
+{
+    // only addresses at the start of a source line can be labeled, which are the even ones of the image
+    char buf[16];
+    uint8_t f = flags(addr);
+    if(!contains(addr) || ((addr - base) & 1))
+        snprintf(buf, sizeof(buf), "0x%03x", addr);
+    else if((f & (CODE | FUNCTION)) == (CODE | FUNCTION))
+        snprintf(buf, sizeof(buf), "sub_%03x", addr);
+    else if(f & CODE)
+        snprintf(buf, sizeof(buf), "L_%03x", addr);
+    else
+        snprintf(buf, sizeof(buf), "data_%03x", addr);
+    return buf;
+}
+
+void chip8analyzer::printSource(FILE *out) const
+{
+    // print source which chip8assembler turns into the identical image
+    // NOTE each source line is one word, commands which are not aligned to the start of the image or can't be
+    // encoded by the assembler are emitted as DB, so are all words which are not executed
+    auto isCommand = [this](uint32_t addr) {
+        return (flags(addr) & CODE) && contains(addr + 1) && assemblable(chip8decoder::decode(word(addr)));
+    };
+
+    // label every address referenced by a command which is emitted as such
+    std::vector<bool> labeled(len, false);
+    for(uint32_t addr = base; addr < base + len; addr += 2)
+    {
+        chip8decoder::instruction ins = chip8decoder::decode(word(addr));
+        if(isCommand(addr) && hasAddress(ins.k) && contains(ins.nnn) && !((ins.nnn - base) & 1))
+            labeled[ins.nnn - base] = true;
+    }
+
+    fprintf(out, "# %zu bytes: %zu code, %zu data, %zu unreached\n", len, codeBytes, dataBytes, len - codeBytes - dataBytes);
+    char mnemonic[32];
+    bool wasCode = true;
+    for(uint32_t addr = base; addr < base + len; addr += 2)
+    {
+        bool command = isCommand(addr);
+        if(command && (flags(addr) & FUNCTION))
+            fprintf(out, "\n");
+        else if(command != wasCode)
+            fprintf(out, "\n");
+        wasCode = command;
+        if(labeled[addr - base])
+            fprintf(out, "%s:\n", label(addr).c_str());
+        if(command)
+        {
+            uint16_t w = word(addr);
+            chip8decoder::formatSource(w, label(chip8decoder::decode(w).nnn).c_str(), mnemonic, sizeof(mnemonic));
+            fprintf(out, "\t%s\n", mnemonic);
+        }
+        else if(contains(addr + 1))
+            fprintf(out, "\tDB 0x%02x, 0x%02x\n", image[addr - base], image[addr + 1 - base]);
+        else
+            fprintf(out, "\tDB 0x%02x\n", image[addr - base]);
+    }
+}
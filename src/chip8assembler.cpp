@@ -1,52 +1,131 @@
 #include "chip8assembler.h"
+#include "chip8opcodes.h"
+#include <algorithm>
+#include <cstdarg>
 #include <deque>
 #include <fstream>
 #include <string.h>
 
-chip8assembler::chip8assembler(const std::string& file, bool verbose = false) : verbose(verbose)
+// mnemonic mapping to enum, which will be used later at the assembling step
+// NOTE the table is immutable and shared by all assembler instances, s.t. concurrent assemblers only read from it
+const std::map<std::string, int> chip8assembler::map_mnemonic = {
+    {"CLS", CLS},   {"cls", CLS},
+    {"RET", RET},   {"ret", RET},
+    {"SYS", SYS},   {"sys", SYS},
+    {"JP", JP},     {"jp", JP},
+    {"CALL", CALL}, {"call", CALL},
+    {"SE", SE},     {"se", SE},
+    {"SNE", SNE},   {"sne", SNE},
+    {"LD", LD},     {"ld", LD},
+    {"ADD", ADD},   {"add", ADD},
+    {"OR", OR},     {"or", OR},
+    {"AND", AND},   {"and", AND},
+    {"XOR", XOR},   {"xor", XOR},
+    {"SUB", SUB},   {"sub", SUB},
+    {"SHR", SHR},   {"shr", SHR},
+    {"SUBN", SUBN}, {"subn", SUBN},
+    {"SHL", SHL},   {"shl", SHL},
+    {"RND", RND},   {"rnd", RND},
+    {"DRW", DRW},   {"drw", DRW},
+    {"SKP", SKP},   {"skp", SKP},
+    {"SKNP", SKNP}, {"sknp", SKNP},
+    {"DB", DB},     {"db", DB}
+};
+
+chip8assembler::chip8assembler(bool verbose) : verbose(verbose), quiet(false) {}
+
+chip8assembler::chip8assembler(const std::string& file, bool verbose = false) : verbose(verbose), quiet(false)
 {
-    // load mnemonic mapping to enum, which will be used later at the assembling step
-    map_mnemonic["CLS"] = CLS;   map_mnemonic["cls"] = CLS;
-    map_mnemonic["RET"] = RET;   map_mnemonic["ret"] = RET;
-    map_mnemonic["SYS"] = SYS;   map_mnemonic["sys"] = SYS;
-    map_mnemonic["JP"] = JP;     map_mnemonic["jp"] = JP;
-    map_mnemonic["CALL"] = CALL; map_mnemonic["call"] = CALL;
-    map_mnemonic["SE"] = SE;     map_mnemonic["se"] = SE;
-    map_mnemonic["SNE"] = SNE;   map_mnemonic["sne"] = SNE;
-    map_mnemonic["LD"] = LD;     map_mnemonic["ls"] = LD;
-    map_mnemonic["ADD"] = ADD;   map_mnemonic["add"] = ADD;
-    map_mnemonic["OR"] = OR;     map_mnemonic["or"] = OR;
-    map_mnemonic["AND"] = AND;   map_mnemonic["and"] = AND;
-    map_mnemonic["XOR"] = XOR;   map_mnemonic["xor"] = XOR;
-    map_mnemonic["SUB"] = SUB;   map_mnemonic["sub"] = SUB;
-    map_mnemonic["SHR"] = SHR;   map_mnemonic["shr"] = SHR;
-    map_mnemonic["SUBN"] = SUBN; map_mnemonic["subn"] = SUBN;
-    map_mnemonic["SHL"] = SHL;   map_mnemonic["shl"] = SHL;
-    map_mnemonic["RND"] = RND;   map_mnemonic["rnd"] = RND;
-    map_mnemonic["DRW"] = DRW;   map_mnemonic["drw"] = DRW;
-    map_mnemonic["SKP"] = SKP;   map_mnemonic["skp"] = SKP;
-    map_mnemonic["SKNP"] = SKNP; map_mnemonic["sknp"] = SKNP;
+    printf("assemble file \"%s\"\n", file.c_str());
+    load(file);
+}
 
+bool chip8assembler::load(const std::string& file)
+{
     // open file stream
-    printf("assemble file \"%s\"\n", file.c_str());
     std::ifstream istream(file.c_str());
+    if(!istream)
+    {
+        error("ERROR: couldn't open file \"%s\"\n", file.c_str());
+        code.clear();
+        return false;
+    }
+    this->file = file;
     // reserve number of chars needed
     istream.seekg(0, std::ios::end);
     code.reserve(istream.tellg());
     istream.seekg(0, std::ios::beg);
     // load chars of file into string
+    // NOTE assign() keeps the capacity of code, s.t. assemblers which are reused for many files don't reallocate
     code.assign(std::istreambuf_iterator<char>(istream),
                 std::istreambuf_iterator<char>());
     istream.close();
+    return true;
+}
+
+void chip8assembler::loadSource(const std::string& source, const std::string& name)
+{
+    // assemble source held in memory, name is used for debug info only
+    this->file = name;
+    code.assign(source.begin(), source.end());
+}
+
+void chip8assembler::error(const char* fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    if(quiet)
+    {
+        // collect message s.t. the caller can report it later on
+        char buf[512];
+        vsnprintf(buf, sizeof(buf), fmt, args);
+        errors += buf;
+    }
+    else
+        vfprintf(stderr, fmt, args);
+    va_end(args);
 }
 
-void chip8assembler::writeMachinecode(const std::string &out)
+bool chip8assembler::writeMachinecode(const std::string &out)
 {
     // save machine code to disk
     FILE* pFile = fopen(out.c_str(), "wb");
-    fwrite(&(this->machinecode[0]), sizeof(uint16_t), this->machinecode.size(), pFile);
+    if(!pFile)
+    {
+        error("ERROR: couldn't open output file \"%s\"\n", out.c_str());
+        return false;
+    }
+    // NOTE machine code is expected to be big endian already, s.t. an odd tail is cut off by writing bytes
+    size_t nWritten = fwrite(this->machinecode.data(), sizeof(uint8_t), bytes(), pFile);
     fclose(pFile);
-    printf("output written to \"%s\"\n", out.c_str());
+    if(nWritten != bytes())
+    {
+        error("ERROR: couldn't write machine code to \"%s\"\n", out.c_str());
+        return false;
+    }
+    if(!quiet) printf("output written to \"%s\"\n", out.c_str());
+    return true;
+}
+
+bool chip8assembler::writeDebuginfo(const std::string &out)
+{
+    // map every byte of the machine code to the source line it was assembled from
+    chip8debuginfo::builder info;
+    info.setFile(file);
+    for(size_t i=0; i<machinecode.size(); ++i)
+    {
+        info.addLine(0x200 + 2*i, sourceLines[i]);
+        info.addLine(0x200 + 2*i + 1, sourceLines[i]);
+    }
+    for(auto it=markers.begin(); it!=markers.end(); ++it)
+        info.addSymbol(it->first, it->second);
+    if(!info.write(out))
+    {
+        error("ERROR: couldn't write debug info to \"%s\"\n", out.c_str());
+        return false;
+    }
+    if(!quiet) printf("debug info written to \"%s\"\n", out.c_str());
+    return true;
 }
 
 void chip8assembler::swapEndian()
@@ -55,15 +134,28 @@ void chip8assembler::swapEndian()
       this->machinecode[i] = (this->machinecode[i] >> 8) | (this->machinecode[i] << 8);
 }
 
+size_t chip8assembler::lines() const
+{
+    // number of source lines of loaded code, last line doesn't need to be terminated by newline
+    size_t n = std::count(code.begin(), code.end(), sNewline);
+    if(!code.empty() && code.back() != sNewline) n++;
+    return n;
+}
+
+size_t chip8assembler::bytes() const
+{
+    // size of machine code in memory, the last word is only half used if the programme ends on a single DB byte
+    return machinecode.size() * sizeof(uint16_t) - (oddTail ? 1 : 0);
+}
+
 bool chip8assembler::compile()
 {
     /*  parse code */
-    std::vector<std::deque<std::string>> tokens;
-    this->parse(tokens);
+    this->parse();
     if(verbose) // if verbose flag is set, print parsed output
     {
         printf("#### PARSED ####\n");
-        for(size_t i=0; i<tokens.size(); ++i)
+        for(size_t i=0; i<nLines; ++i)
         {
             printf("%li: ", i);
             for(auto t : tokens[i]) printf("%s ", t.c_str());
@@ -73,9 +165,9 @@ bool chip8assembler::compile()
 
     if(verbose) printf("#### ASSEMBLING ... ####\n");
     /* assembly code */
-    if(!this->assemble(tokens))
+    if(!this->assemble())
     {
-        printf("Error encountered at assembly");
+        error("Error encountered at assembly\n");
         return false;
     }
 
@@ -87,18 +179,46 @@ bool chip8assembler::compile()
             printf("marker: %s -> address: 0x%03x\n", (it->first).c_str(), it->second);
         printf("\n#### MACHINE CODE ####\n");
         for(size_t i=0; i<machinecode.size(); ++i)
-            printf("0x%03lx: %04x\n", i+0x200, machinecode[i]);
+            printf("0x%03zx: %04x\n", 2*i+0x200, machinecode[i]);
         printf("\n");
     }
 
     return true;
 }
 
-void chip8assembler::parse(std::vector<std::deque<std::string>>& tokens)
+void chip8assembler::optimize(chip8optimizer &optimizer)
+{
+    // optimize machine code in place, markers and source lines are moved along with the code
+    optimizer.optimize(machinecode, markers, dataWords);
+    std::vector<int> optimizedLines(machinecode.size());
+    std::vector<bool> optimizedData(machinecode.size());
+    for(size_t i=0; i<optimizer.remap.size() && i<sourceLines.size(); ++i)
+        if(optimizer.remap[i] >= 0 && optimizedLines[optimizer.remap[i]] == 0)
+            optimizedLines[optimizer.remap[i]] = sourceLines[i];
+    for(size_t i=0; i<optimizer.remap.size() && i<dataWords.size(); ++i)
+        if(optimizer.remap[i] >= 0)
+            optimizedData[optimizer.remap[i]] = optimizedData[optimizer.remap[i]] || dataWords[i];
+    sourceLines.swap(optimizedLines);
+    dataWords.swap(optimizedData);
+    if(verbose) // if verbose flag is set, print optimized machine code
+    {
+        printf("#### OPTIMIZED MACHINE CODE ####\n");
+        for(size_t i=0; i<machinecode.size(); ++i)
+            printf("0x%03zx: %04x\n", 2*i+0x200, machinecode[i]);
+        printf("\n");
+    }
+}
+
+void chip8assembler::parse()
 {
     // iterate file char-wise and cut whitespace, newlines and comments - any different symbol is treated as token
-    std::deque<std::string> tokensLine;
-    for(std::string::size_type p = 0; p < code.size(); ++p)
+    nLines = 0;
+    tokensLine.clear();
+    sourceLines.clear();
+    int lineCommand = 0; // source line of the command which is currently tokenized
+    // NOTE each iteration of the outer loop consumes exactly one line of the source
+    int line = 1;
+    for(std::string::size_type p = 0; p < code.size(); ++p, ++line)
     {
         // extract all tokens of current line
         // token := all chars between {whitespace, comma, newline} and {whitespace, comma, comment, newline}
@@ -112,6 +232,7 @@ void chip8assembler::parse(std::vector<std::deque<std::string>>& tokens)
             if(len > 0) // tokens of size 0 can occur but aren't valid (e.g. V0, 1 (whitespace after comma))
             {
                 std::string token = code.substr(p0, len);
+                if(token.back() != sMarker) lineCommand = line;
                 tokensLine.emplace_back(token);
             }
             // if {newline, comment, EOF} follows last token then make new line token-vector
@@ -122,8 +243,9 @@ void chip8assembler::parse(std::vector<std::deque<std::string>>& tokens)
                 //// current symbol is EOF (if file ends on last written character)
                 if((code[p-1] != sMarker) || (p == code.size()))
                 {
-                    tokens.emplace_back(tokensLine);
-                    tokensLine.clear();
+                    storeLine();
+                    sourceLines.push_back(lineCommand ? lineCommand : line);
+                    lineCommand = 0;
                 }
             }
             // if token ended on {whitespace, comma, tab} simply skip it
@@ -138,16 +260,30 @@ void chip8assembler::parse(std::vector<std::deque<std::string>>& tokens)
 
     // if last line in file ends on {whitespace, tab, comma} we need to manually store last line of tokens
     if(!tokensLine.empty())
-        tokens.emplace_back(tokensLine);
+    {
+        storeLine();
+        sourceLines.push_back(lineCommand ? lineCommand : line);
+    }
 }
 
-bool chip8assembler::assemble(std::vector<std::deque<std::string>>& tokens)
+void chip8assembler::storeLine()
+{
+    // swap the line into the next slot, the tokens left over in the slot are cleared for the next line
+    // NOTE clearing keeps a block of the deque, so lines of a few tokens don't allocate again
+    if(nLines == tokens.size())
+        tokens.emplace_back();
+    tokens[nLines++].swap(tokensLine);
+    tokensLine.clear();
+}
+
+bool chip8assembler::assemble()
 {
     // reserve memory for machinecode
-    this->machinecode.clear(); this->markers.clear();
-    this->machinecode.reserve(tokens.size());
+    this->machinecode.clear(); this->markers.clear(); this->dataWords.clear();
+    this->machinecode.reserve(nLines);
+    this->oddTail = false;
     // 1 iteration: find and add markers
-    for(size_t i=0; i<tokens.size(); ++i)
+    for(size_t i=0; i<nLines; ++i)
     {
         // check if line starts with JP-marker -> markers are only allowed to be defined at the beginning of a line
         if(tokens[i].front().back() == sMarker)
@@ -169,7 +305,7 @@ bool chip8assembler::assemble(std::vector<std::deque<std::string>>& tokens)
     }
 
     // 2nd iteration: assemble code
-    for(size_t i=0; i<tokens.size(); ++i)
+    for(size_t i=0; i<nLines; ++i)
     {
         // compose complete command string
         std::string strCommand;
@@ -180,7 +316,14 @@ bool chip8assembler::assemble(std::vector<std::deque<std::string>>& tokens)
         if(!assembleCommand(tokens[i], strCommand))
         {
             // error case
-            fprintf(stderr, "ERROR: couldn't assemble command \"%s\"\n", strCommand.c_str());
+            error("ERROR: couldn't assemble command \"%s\"\n", strCommand.c_str());
+            return false;
+        }
+        dataWords.resize(machinecode.size(), false);
+        // a single byte can only complete the last word, anything behind it would be misaligned
+        if(oddTail && i+1 < nLines)
+        {
+            error("ERROR: DB with a single byte is only allowed at the end of the programme (passed: %s)\n", strCommand.c_str());
             return false;
         }
     }
@@ -202,8 +345,8 @@ bool chip8assembler::markerExists(const std::string &cmd,
     // check if marker has an entry in markers map
     if (markers.find(marker) == markers.end())
     {
-        fprintf(stderr, "ERROR: marker \"%s\" is not defined (passed: %s).\n",
-                marker.c_str(), cmd.c_str());
+        error("ERROR: marker \"%s\" is not defined (passed: %s).\n",
+              marker.c_str(), cmd.c_str());
         return false;
     }
     return true;
@@ -215,10 +358,9 @@ bool chip8assembler::checkNumArgs(const std::string &mnemonic,
 {
     if (n_given != n_required)
     {
-        fprintf(stderr,
-                "ERROR: invalid number of arguments for \"%s\" (passed: %s). "
-                "Required: %i, Give: %i\n",
-                mnemonic.c_str(), cmd.c_str(), n_required, n_given);
+        error("ERROR: invalid number of arguments for \"%s\" (passed: %s). "
+              "Required: %i, Give: %i\n",
+              mnemonic.c_str(), cmd.c_str(), n_required, n_given);
         return false;
     }
     return true;
@@ -228,10 +370,9 @@ bool chip8assembler::checkRegRange(const std::string &cmd, const int reg)
 {
     if (reg < 0 || reg >= 16)
     {
-        fprintf(stderr,
-                "ERROR: Register \"%i\" out of range (passed: %s). Register range "
-                "from V0-VF.\n",
-                reg, cmd.c_str());
+        error("ERROR: Register \"%i\" out of range (passed: %s). Register range "
+              "from V0-VF.\n",
+              reg, cmd.c_str());
         return false;
     }
     return true;
@@ -241,10 +382,9 @@ bool chip8assembler::checkRegRange(const std::string &cmd, const long reg)
 {
     if (reg < 0 || reg >= 16)
     {
-        fprintf(stderr,
-                "ERROR: Register \"%li\" out of range (passed: %s). Register range "
-                "from V0-VF.\n",
-                reg, cmd.c_str());
+        error("ERROR: Register \"%li\" out of range (passed: %s). Register range "
+              "from V0-VF.\n",
+              reg, cmd.c_str());
         return false;
     }
     return true;
@@ -255,10 +395,9 @@ bool chip8assembler::checkAddrRange(const std::string &cmd, const uint16_t addr)
     // check if most significant nibble is set
     if (0xF000 & addr) {
         // error case, address out of range
-        fprintf(stderr,
-                "ERROR: Address out of range (passed: %s). Consider that original "
-                "CHIP-8 only consits of 4K memory.\n",
-                cmd.c_str());
+        error("ERROR: Address out of range (passed: %s). Consider that original "
+              "CHIP-8 only consits of 4K memory.\n",
+              cmd.c_str());
         return false;
     }
     return true;
@@ -270,10 +409,9 @@ bool chip8assembler::checkConstRange(const std::string &cmd, const long lconst)
     // representable by 8 bits
     if (lconst >> 8) // check if only least significant byte is set
     {
-        fprintf(stderr,
-                "ERROR: constant \"%li\" is not representable by 1 byte (passed: "
-                "%s). Remember, CHIP-8 is an 8 bit machine.\n",
-                lconst, cmd.c_str());
+        error("ERROR: constant \"%li\" is not representable by 1 byte (passed: "
+              "%s). Remember, CHIP-8 is an 8 bit machine.\n",
+              lconst, cmd.c_str());
         return false;
     }
     return true;
@@ -285,10 +423,9 @@ bool chip8assembler::checkConstRange(const std::string &cmd, const int iconst)
     // representable by 8 bits
     if (iconst >> 8) // check if only least significant byte is set
     {
-        fprintf(stderr,
-                "ERROR: constant \"%i\" is not representable by 1 byte (passed: "
-                "%s). Remember, CHIP-8 is an 8 bit machine.\n",
-                iconst, cmd.c_str());
+        error("ERROR: constant \"%i\" is not representable by 1 byte (passed: "
+              "%s). Remember, CHIP-8 is an 8 bit machine.\n",
+              iconst, cmd.c_str());
         return false;
     }
     return true;
@@ -299,10 +436,8 @@ bool chip8assembler::checkNibbleRange(const std::string &cmd,
 {
     if (lnibble >> 4) // check if only least significant nibble is set
     {
-        fprintf(
-            stderr,
-            "ERROR: nibble \"%li\" is not representable by 4 bit (passed: %s).\n",
-            lnibble, cmd.c_str());
+        error("ERROR: nibble \"%li\" is not representable by 4 bit (passed: %s).\n",
+              lnibble, cmd.c_str());
         return false;
     }
     return true;
@@ -312,10 +447,8 @@ bool chip8assembler::checkNibbleRange(const std::string &cmd, const int inibble)
 {
     if (inibble >> 4) // check if only least significant nibble is set
     {
-        fprintf(
-            stderr,
-            "ERROR: nibble \"%i\" is not representable by 4 bit (passed: %s).\n",
-            inibble, cmd.c_str());
+        error("ERROR: nibble \"%i\" is not representable by 4 bit (passed: %s).\n",
+              inibble, cmd.c_str());
         return false;
     }
     return true;
@@ -350,7 +483,7 @@ bool chip8assembler::getRegister(const std::string& cmd, const std::string& reg,
     else
     {
         // error case
-        fprintf(stderr, "ERROR: invalid register given \"%s\". Registers numbers need to be defined either coded decimal or hexadecimal and need to be marked by a leading 'v' or 'V', like 'V12' or 'VC'.\n", reg.c_str());
+        error("ERROR: invalid register given \"%s\". Registers numbers need to be defined either coded decimal or hexadecimal and need to be marked by a leading 'v' or 'V', like 'V12' or 'VC'.\n", reg.c_str());
         return false;
     }
 }
@@ -396,7 +529,7 @@ bool chip8assembler::getConst(const std::string& cmd, const std::string& sconst,
     else
     {
         // error case: const is either coded hexadecimal nor decimal
-        fprintf(stderr, "ERROR: constants are only allowed to be coded decimal or hexadecimal. hexadecimal coded constants need to be prefixed by \"0x\" (passed: %s).\n", cmd.c_str());
+        error("ERROR: constants are only allowed to be coded decimal or hexadecimal. hexadecimal coded constants need to be prefixed by \"0x\" (passed: %s).\n", cmd.c_str());
     }
     return result;
 }
@@ -440,13 +573,38 @@ bool chip8assembler::getNibble(const std::string& cmd, const std::string& snibbl
     else
     {
         // error case: nibble is either coded hexadecimal nor decimal
-        fprintf(stderr, "ERROR: nibbles are only allowed to be coded decimal or hexadecimal. hexadecimal coded nibbles need to be prefixed by \"0x\" (passed: %s).\n", cmd.c_str());
+        error("ERROR: nibbles are only allowed to be coded decimal or hexadecimal. hexadecimal coded nibbles need to be prefixed by \"0x\" (passed: %s).\n", cmd.c_str());
         return false;
     }
     // if reach here, wrong coding of nibble
     return false;
 }
 
+bool chip8assembler::getAddress(const std::string& cmd, const std::string& saddr, uint16_t& ret)
+{
+    // addresses are given by markers or hexadecimal coded with prefix 0x
+    // NOTE the latter allows to address memory which can't be labeled, like odd addresses or the interpreter area
+    auto itMarker = markers.find(saddr);
+    if(itMarker != markers.end())
+    {
+        ret = itMarker->second;
+        return true;
+    }
+    if(!saddr.substr(0, 2).compare("0x"))
+    {
+        std::string shex = saddr.substr(2, saddr.size()-1);
+        if(!shex.empty() && shex.size() <= 4 && shex.c_str()[strspn(shex.c_str(), "AaBbCcDdEeFf0123456789")] == 0)
+        {
+            uint16_t addr = std::strtol(shex.c_str(), NULL, 16);
+            if(!checkAddrRange(cmd, addr)) return false;
+            ret = addr;
+            return true;
+        }
+    }
+    // report undefined marker
+    return markerExists(cmd, saddr);
+}
+
 bool chip8assembler::checkI(const std::string &cmd, const std::string &arg)
 {
     return !bool(arg.compare("I"));
@@ -460,14 +618,15 @@ bool chip8assembler::assembleCommand(const std::deque<std::string>& command, con
     int nargs = command.size() - 1; // -1 since mnemonic is no argument
 
     // switch for mnemonic
-    switch(map_mnemonic[mnemonic])
+    auto itMnemonic = map_mnemonic.find(mnemonic);
+    switch(itMnemonic != map_mnemonic.end() ? itMnemonic->second : -1)
     {
     case CLS:
     {
         // check for number of args
         if(!checkNumArgs(mnemonic, cmd, 0, nargs)) return false;
         // CLS -> 0x00E0
-        machinecode.push_back(0x00E0);
+        machinecode.push_back(chip8opcodes::CLS());
         break;
     }
     case RET:
@@ -475,12 +634,12 @@ bool chip8assembler::assembleCommand(const std::deque<std::string>& command, con
         // check for number of args
         if(!checkNumArgs(mnemonic, cmd, 0, nargs)) return false;
         // RET -> 0x00EE
-        machinecode.push_back(0x00EE);
+        machinecode.push_back(chip8opcodes::RET());
         break;
     }
     case SYS:
     {
-        fprintf(stderr, "ERROR: mnemonic SYS is not support with this version of CHIP-8 (passed: %s).\n", cmd.c_str());
+        error("ERROR: mnemonic SYS is not support with this version of CHIP-8 (passed: %s).\n", cmd.c_str());
         return false;
     }
     case JP:
@@ -494,13 +653,14 @@ bool chip8assembler::assembleCommand(const std::deque<std::string>& command, con
             // check that arg is no register
             if(isRegister(command[1]))
             {
-                fprintf(stderr, "ERROR: JP with only one argument requires address, but register was passed (passed: %s).\n", cmd.c_str());
+                error("ERROR: JP with only one argument requires address, but register was passed (passed: %s).\n", cmd.c_str());
                 return false;
             }
             // check if MS nibbel is unset -> else code is too big to fit in 4k memory of CHIP-8
-            if(!markerExists(cmd, command[1])) return false;
-            // NOTE INVARIANT: marker is in map and most significant nibble of command[1] is 0
-            machinecode.push_back(0x1000 | markers[command[1]]);
+            uint16_t addr;
+            if(!getAddress(cmd, command[1], addr)) return false;
+            // NOTE INVARIANT: most significant nibble of addr is 0
+            machinecode.push_back(chip8opcodes::JP_addr(addr));
         }
         else if(nargs == 2) // check if two args are passed
         {
@@ -514,25 +674,26 @@ bool chip8assembler::assembleCommand(const std::deque<std::string>& command, con
                 if(!getRegister(cmd, command[1], regno)) return false;
                 if(regno != 0)
                 {
-                    fprintf(stderr, "ERROR: when JP is passed with 2 arguments, the first one needs to be exactly register V0 (passed: %s).\n", cmd.c_str());
+                    error("ERROR: when JP is passed with 2 arguments, the first one needs to be exactly register V0 (passed: %s).\n", cmd.c_str());
                     return false;
                 }
             }
             else
             {
-                fprintf(stderr, "ERROR: when JP is passed with 2 arguments, the first one needs to be a register (passed: %s).\n", cmd.c_str());
+                error("ERROR: when JP is passed with 2 arguments, the first one needs to be a register (passed: %s).\n", cmd.c_str());
                 return false;
             }
             // check if marker is in map
-            if(!markerExists(cmd, command[2])) return false;
+            uint16_t addr;
+            if(!getAddress(cmd, command[2], addr)) return false;
             // NOTE INVARIANT: first arg is register V0
-            // NOTE INVARIANT: second arg is valid marker and its most significant nibble is 0
-            machinecode.push_back(0xB000 | markers[command[2]]);
+            // NOTE INVARIANT: second arg is valid address and its most significant nibble is 0
+            machinecode.push_back(chip8opcodes::JP_V0_addr(addr));
         }
         else
         {
             // error case, too many args for JP
-            fprintf(stderr, "ERROR: invalid number of arguments for JP (passsed: %s).\n", cmd.c_str());
+            error("ERROR: invalid number of arguments for JP (passsed: %s).\n", cmd.c_str());
             return false;
         }
         break;
@@ -543,9 +704,10 @@ bool chip8assembler::assembleCommand(const std::deque<std::string>& command, con
         // check for number of args
         if(!checkNumArgs(mnemonic, cmd, 1, nargs)) return false;
         // check if marker is in map
-        if(!markerExists(cmd, command[1])) return false;
-        // NOTE INVARIANT: marker is valid and its most significant nibble is 0
-        machinecode.push_back(0x2000 | markers[command[1]]);
+        uint16_t addr;
+        if(!getAddress(cmd, command[1], addr)) return false;
+        // NOTE INVARIANT: address is valid and its most significant nibble is 0
+        machinecode.push_back(chip8opcodes::CALL_addr(addr));
         break;
     }
     case SE:
@@ -562,7 +724,7 @@ bool chip8assembler::assembleCommand(const std::deque<std::string>& command, con
             if(!getRegister(cmd, command[1], Vx)) return false;
             if(!getRegister(cmd, command[2], Vy)) return false;
             // NOTE INVARIANT: registers will be in valid range  [0,16]
-            machinecode.push_back(0x5000 | (Vx << 8) | (Vy << 4));
+            machinecode.push_back(chip8opcodes::SE_Vx_Vy(Vx, Vy));
         }
         else if(isRegister(command[1]) && !isRegister(command[2])) // check if first arg is register but second is not
         {
@@ -575,12 +737,12 @@ bool chip8assembler::assembleCommand(const std::deque<std::string>& command, con
             uint8_t byte;
             if(!getConst(cmd, command[2], byte)) return false;
             // NOTE INVARIANT: integer returned by getConst will be in [0,255] -> byte can be represented with 8 bits
-            machinecode.push_back(0x3000 | (Vx << 8) | byte);
+            machinecode.push_back(chip8opcodes::SE_Vx_byte(Vx, byte));
         }
         else
         {
             // error case, invalid arguments
-            fprintf(stderr, "ERROR: invalid arguments passed to SE (passed: %s)\n", cmd.c_str());
+            error("ERROR: invalid arguments passed to SE (passed: %s)\n", cmd.c_str());
             return false;
         }
         break;
@@ -599,7 +761,7 @@ bool chip8assembler::assembleCommand(const std::deque<std::string>& command, con
             if(!getRegister(cmd, command[1], Vx)) return false;
             if(!getRegister(cmd, command[2], Vy)) return false;
             // NOTE INVARIANT: registers will be in valid range  [0,16]
-            machinecode.push_back(0x9000 | (Vx << 8) | (Vy << 4));
+            machinecode.push_back(chip8opcodes::SNE_Vx_Vy(Vx, Vy));
         }
         else if(isRegister(command[1]) && !isRegister(command[2])) // check if first arg is register and second is not
         {
@@ -612,12 +774,12 @@ bool chip8assembler::assembleCommand(const std::deque<std::string>& command, con
             uint8_t byte;
             if(!getConst(cmd, command[2], byte)) return false;
             // NOTE INVARIANT: integer returned by getConst will be in [0,255] -> byte can be represented with 8 bits
-            machinecode.push_back(0x4000 | (Vx << 8) | byte);
+            machinecode.push_back(chip8opcodes::SNE_Vx_byte(Vx, byte));
         }
         else
         {
             // error case, invalid arguments
-            fprintf(stderr, "ERROR: invalid arguments passed to SNE (passed: %s)\n", cmd.c_str());
+            error("ERROR: invalid arguments passed to SNE (passed: %s)\n", cmd.c_str());
             return false;
         }
         break;
@@ -630,9 +792,10 @@ bool chip8assembler::assembleCommand(const std::deque<std::string>& command, con
         if(checkI(cmd, command[1]))
         {
             // LD I, addr -> 0xAnnn
-            if(!markerExists(cmd, command[2])) return false;
-            // NOTE INVARIANT: marker is valid and its most significant nibble is 0
-            machinecode.push_back(0xA000 | markers[command[2]]);
+            uint16_t addr;
+            if(!getAddress(cmd, command[2], addr)) return false;
+            // NOTE INVARIANT: address is valid and its most significant nibble is 0
+            machinecode.push_back(chip8opcodes::LD_I_addr(addr));
             break;
         }
         // check for Vx as first arg
@@ -648,28 +811,28 @@ bool chip8assembler::assembleCommand(const std::deque<std::string>& command, con
                 uint8_t Vy;
                 if(!getRegister(cmd, command[2], Vy)) return false;
                 // NOTE INVARIANT: registers will be in valid range [0,16]
-                machinecode.push_back(0x8000 | (Vx << 8) | (Vy << 4));
+                machinecode.push_back(chip8opcodes::LD_Vx_Vy(Vx, Vy));
             }
             else if(!command[2].compare("DT") || !command[2].compare("dt"))
             {
                 // LD Vx, DT -> 0xFx07
-                machinecode.push_back(0xF007 | (Vx << 8));
+                machinecode.push_back(chip8opcodes::LD_Vx_DT(Vx));
             }
             else if(!command[2].compare("K") || !command[2].compare("k"))
             {
                 // LD Vx, K -> 0xFx0A
-                machinecode.push_back(0xF00A | (Vx << 8));
+                machinecode.push_back(chip8opcodes::LD_Vx_K(Vx));
             }
             else if(!command[2].compare("[I]") || !command[2].compare("[i]"))
             {
                 // LD Vx, [I] -> 0xFx65
-                machinecode.push_back(0xF065 | (Vx << 8));
+                machinecode.push_back(chip8opcodes::LD_Vx_I(Vx));
             }
             else if(getConst(cmd, command[2], byte))
             {
                 // LD Vx, byte -> 0x6xkk
                 // NOTE INVARIANT: integer returned by getConst will be in [0,255] -> byte can be represented with 8 bits
-                machinecode.push_back(0x6000 | (Vx << 8) | byte);
+                machinecode.push_back(chip8opcodes::LD_Vx_byte(Vx, byte));
             }
         }
         // check for Vx as second arg
@@ -682,33 +845,33 @@ bool chip8assembler::assembleCommand(const std::deque<std::string>& command, con
             if(!command[1].compare("DT") || !command[1].compare("dt"))
             {
                 // LD DT, Vx -> 0xFx15
-                machinecode.push_back(0xF015 | (Vx << 8));
+                machinecode.push_back(chip8opcodes::LD_DT_Vx(Vx));
             }
             else if(!command[1].compare("ST") || !command[1].compare("st"))
             {
                 // LD ST, Vx -> 0xFx18
-                machinecode.push_back(0xF018 | (Vx << 8));
+                machinecode.push_back(chip8opcodes::LD_ST_Vx(Vx));
             }
             else if(!command[1].compare("F") || !command[1].compare("f"))
             {
                 // LD F, Vx -> 0xFx29
-                machinecode.push_back(0xF029 | (Vx << 8));
+                machinecode.push_back(chip8opcodes::LD_F_Vx(Vx));
             }
             else if(!command[1].compare("B") || !command[1].compare("b"))
             {
                 // LD B, Vx -> 0xFx33
-                machinecode.push_back(0xF033 | (Vx << 8));
+                machinecode.push_back(chip8opcodes::LD_B_Vx(Vx));
             }
             else if(!command[1].compare("[I]") || !command[1].compare("[i]"))
             {
                 // LD [I], Vx -> 0xFx55
-                machinecode.push_back(0xF055 | (Vx << 8));
+                machinecode.push_back(chip8opcodes::LD_I_Vx(Vx));
             }
         }
         else
         {
             // else LD used with invalid arguments
-            fprintf(stderr, "ERROR: invalid arguments passed to LD (passed: %s)\n", cmd.c_str());
+            error("ERROR: invalid arguments passed to LD (passed: %s)\n", cmd.c_str());
             return false;
         }
         break;
@@ -728,7 +891,7 @@ bool chip8assembler::assembleCommand(const std::deque<std::string>& command, con
             if(!getRegister(cmd, command[1], Vx)) return false;
             if(!getRegister(cmd, command[2], Vy)) return false;
             // NOTE INVARIANT: registers will be in valid range [0,16]
-            machinecode.push_back(0x8004 | (Vx << 8) | (Vy << 4));
+            machinecode.push_back(chip8opcodes::ADD_Vx_Vy(Vx, Vy));
         }
         else if(isRegister(command[1]) && !isRegister(command[2])) // check if first arg is register but second not
         {
@@ -741,7 +904,7 @@ bool chip8assembler::assembleCommand(const std::deque<std::string>& command, con
             uint8_t byte;
             if(!getConst(cmd, command[2], byte)) return false;
             // NOTE INVARIANT: integer returned by getConst will be in [0,255] -> byte can be represented with 8 bits
-            machinecode.push_back(0x7000 | (Vx << 8) | byte);
+            machinecode.push_back(chip8opcodes::ADD_Vx_byte(Vx, byte));
         }
         else if(!isRegister(command[1]) && isRegister(command[2])) // check if first arg is not register but second is
         {
@@ -750,7 +913,7 @@ bool chip8assembler::assembleCommand(const std::deque<std::string>& command, con
             if(!checkI(cmd, command[1]))
             {
                 // error case
-                fprintf(stderr, "ERROR: if only second argument of ADD is a register Vx then the first argument must exactly be I (passed: %s).\n", cmd.c_str());
+                error("ERROR: if only second argument of ADD is a register Vx then the first argument must exactly be I (passed: %s).\n", cmd.c_str());
                 return false;
             }
             // NOTE INVARIANT: first arg is I
@@ -758,12 +921,12 @@ bool chip8assembler::assembleCommand(const std::deque<std::string>& command, con
             uint8_t Vx;
             if(!getRegister(cmd, command[2], Vx)) return false;
             // NOTE INVARIANT: registers will be in valid range [0,16]
-            machinecode.push_back(0xF01E | (Vx << 8));
+            machinecode.push_back(chip8opcodes::ADD_I_Vx(Vx));
         }
         else
         {
             // error case, invalid arguments
-            fprintf(stderr, "ERROR: invalid arguments passed to ADD (passed: %s)\n", cmd.c_str());
+            error("ERROR: invalid arguments passed to ADD (passed: %s)\n", cmd.c_str());
             return false;
         }
         break;
@@ -780,11 +943,11 @@ bool chip8assembler::assembleCommand(const std::deque<std::string>& command, con
             if(!getRegister(cmd, command[1], Vx)) return false;
             if(!getRegister(cmd, command[2], Vy)) return false;
             // NOTE INVARIANT: registers will be in valid range [0,16]
-            machinecode.push_back(0x8001 | (Vx << 8) | (Vy << 4));
+            machinecode.push_back(chip8opcodes::OR_Vx_Vy(Vx, Vy));
         }
         else
         {
-            fprintf(stderr, "ERROR: OR can only operate on registers, like OR Vx, Vy (passed: %s).\n", cmd.c_str());
+            error("ERROR: OR can only operate on registers, like OR Vx, Vy (passed: %s).\n", cmd.c_str());
             return false;
         }
         break;
@@ -801,11 +964,11 @@ bool chip8assembler::assembleCommand(const std::deque<std::string>& command, con
             if(!getRegister(cmd, command[1], Vx)) return false;
             if(!getRegister(cmd, command[2], Vy)) return false;
             // NOTE INVARIANT: registers will be in valid range [0,16]
-            machinecode.push_back(0x8002 | (Vx << 8) | (Vy << 4));
+            machinecode.push_back(chip8opcodes::AND_Vx_Vy(Vx, Vy));
         }
         else
         {
-            fprintf(stderr, "ERROR: AND can only operate on registers, like AND Vx, Vy (passed: %s).\n", cmd.c_str());
+            error("ERROR: AND can only operate on registers, like AND Vx, Vy (passed: %s).\n", cmd.c_str());
             return false;
         }
         break;
@@ -822,11 +985,11 @@ bool chip8assembler::assembleCommand(const std::deque<std::string>& command, con
             if(!getRegister(cmd, command[1], Vx)) return false;
             if(!getRegister(cmd, command[2], Vy)) return false;
             // NOTE INVARIANT: registers will be in valid range [0,16]
-            machinecode.push_back(0x8003 | (Vx << 8) | (Vy << 4));
+            machinecode.push_back(chip8opcodes::XOR_Vx_Vy(Vx, Vy));
         }
         else
         {
-            fprintf(stderr, "ERROR: XOR can only operate on registers, like XOR Vx, Vy (passed: %s).\n", cmd.c_str());
+            error("ERROR: XOR can only operate on registers, like XOR Vx, Vy (passed: %s).\n", cmd.c_str());
             return false;
         }
         break;
@@ -843,11 +1006,11 @@ bool chip8assembler::assembleCommand(const std::deque<std::string>& command, con
             if(!getRegister(cmd, command[1], Vx)) return false;
             if(!getRegister(cmd, command[2], Vy)) return false;
             // NOTE INVARIANT: registers will be in valid range [0,16]
-            machinecode.push_back(0x8005 | (Vx << 8) | (Vy << 4));
+            machinecode.push_back(chip8opcodes::SUB_Vx_Vy(Vx, Vy));
         }
         else
         {
-            fprintf(stderr, "ERROR: SUB can only operate on registers, like SUB Vx, Vy (passed: %s).\n", cmd.c_str());
+            error("ERROR: SUB can only operate on registers, like SUB Vx, Vy (passed: %s).\n", cmd.c_str());
             return false;
         }
         break;
@@ -861,7 +1024,7 @@ bool chip8assembler::assembleCommand(const std::deque<std::string>& command, con
         uint8_t Vx;
         if(!getRegister(cmd, command[1], Vx)) return false;
         // NOTE INVARIANT: registers will be in valid range [0,16]
-        machinecode.push_back(0x8006 | (Vx << 8)); // NOTE assembler will set register y=0 since it is not used at this operation
+        machinecode.push_back(chip8opcodes::SHR_Vx(Vx)); // NOTE assembler will set register y=0 since it is not used at this operation
         break;
     }
     case SUBN:
@@ -876,11 +1039,11 @@ bool chip8assembler::assembleCommand(const std::deque<std::string>& command, con
             if(!getRegister(cmd, command[1], Vx)) return false;
             if(!getRegister(cmd, command[2], Vy)) return false;
             // NOTE INVARIANT: registers will be in valid range [0,16]
-            machinecode.push_back(0x8007 | (Vx << 8) | (Vy << 4));
+            machinecode.push_back(chip8opcodes::SUBN_Vx_Vy(Vx, Vy));
         }
         else
         {
-            fprintf(stderr, "ERROR: SUBN can only operate on registers, like SUBN Vx, Vy (passed: %s).\n", cmd.c_str());
+            error("ERROR: SUBN can only operate on registers, like SUBN Vx, Vy (passed: %s).\n", cmd.c_str());
             return false;
         }
         break;
@@ -894,7 +1057,7 @@ bool chip8assembler::assembleCommand(const std::deque<std::string>& command, con
         uint8_t Vx;
         if(!getRegister(cmd, command[1], Vx)) return false;
         // NOTE INVARIANT: registers will be in valid range [0,16]
-        machinecode.push_back(0x800E | (Vx << 8)); // NOTE assembler will set register y=0 since it is not used at this operation
+        machinecode.push_back(chip8opcodes::SHL_Vx(Vx)); // NOTE assembler will set register y=0 since it is not used at this operation
         break;
     }
     case RND:
@@ -913,11 +1076,11 @@ bool chip8assembler::assembleCommand(const std::deque<std::string>& command, con
             uint8_t byte;
             if(!getConst(cmd, command[2], byte)) return false;
             // NOTE INVARIANT: integer returned by getConst will be in [0,255] -> byte can be represented with 8 bits
-            machinecode.push_back(0xC000 | (Vx << 8) | byte);
+            machinecode.push_back(chip8opcodes::RND_Vx_byte(Vx, byte));
         }
         else
         {
-            fprintf(stderr, "ERROR: invalid call of RND (passed: %s). RND must be called like \"RND Vx, byte\".\n", cmd.c_str());
+            error("ERROR: invalid call of RND (passed: %s). RND must be called like \"RND Vx, byte\".\n", cmd.c_str());
             return false;
         }
         break;
@@ -939,11 +1102,11 @@ bool chip8assembler::assembleCommand(const std::deque<std::string>& command, con
             uint8_t nibble;
             if(!getNibble(cmd, command[3], nibble)) return false;
             // NOTE INVARIANT: nibble is 4 bit representable -> most significant nible of uint8 will be unset
-            machinecode.push_back(0xD000 | (Vx << 8) | (Vy << 4) | nibble);
+            machinecode.push_back(chip8opcodes::DRW_Vx_Vy_nibble(Vx, Vy, nibble));
         }
         else
         {
-            fprintf(stderr, "ERROR: invalid call of DRW (passed: %s). DRW must be called like \"DRW Vx, Vy, byte\".\n", cmd.c_str());
+            error("ERROR: invalid call of DRW (passed: %s). DRW must be called like \"DRW Vx, Vy, byte\".\n", cmd.c_str());
             return false;
         }
         break;
@@ -957,7 +1120,7 @@ bool chip8assembler::assembleCommand(const std::deque<std::string>& command, con
         uint8_t Vx;
         if(!getRegister(cmd, command[1], Vx)) return false;
         // NOTE INVARIANT: registers will be in valid range [0,16]
-        machinecode.push_back(0xE09E | (Vx << 8));
+        machinecode.push_back(chip8opcodes::SKP_Vx(Vx));
         break;
     }
     case SKNP:
@@ -969,11 +1132,29 @@ bool chip8assembler::assembleCommand(const std::deque<std::string>& command, con
         uint8_t Vx;
         if(!getRegister(cmd, command[1], Vx)) return false;
         // NOTE INVARIANT: registers will be in valid range [0,16]
-        machinecode.push_back(0xE0A1 | (Vx << 8));
+        machinecode.push_back(chip8opcodes::SKNP_Vx(Vx));
+        break;
+    }
+    case DB:
+    {
+        // DB byte[, byte] -> raw data, which occupies one word like every command
+        // NOTE a single byte is padded by 0, it is meant for the last byte of odd sized programmes
+        if(nargs != 1 && nargs != 2)
+        {
+            error("ERROR: DB requires 1 or 2 bytes (passed: %s).\n", cmd.c_str());
+            return false;
+        }
+        uint8_t hi, lo = 0;
+        if(!getConst(cmd, command[1], hi)) return false;
+        if(nargs == 2 && !getConst(cmd, command[2], lo)) return false;
+        machinecode.push_back((hi << 8) | lo);
+        dataWords.resize(machinecode.size(), false);
+        dataWords.back() = true;
+        oddTail = nargs == 1;
         break;
     }
     default:
-        fprintf(stderr, "ERROR: undefined mnemonic \"%s\" (passed: %s)\n", mnemonic.c_str(), cmd.c_str());
+        error("ERROR: undefined mnemonic \"%s\" (passed: %s)\n", mnemonic.c_str(), cmd.c_str());
         return false;
     }
 
@@ -1,8 +1,11 @@
 #include "chip8assembler.h"
+#include "chip8bulkassembler.h"
 #include <cstdlib>
 #include <stdio.h>
 #include <cstring>
 #include <algorithm>
+#include <filesystem>
+#include <vector>
 
 // forward declarations
 bool parseArgs(int argc, char** argv);
@@ -10,8 +13,14 @@ void printUsage();
 
 // globals
 bool bVerbose = false;
+bool bBulk = false;
+bool bOptimize = false;
+bool bReport = false;
+bool bDebuginfo = false;
+int nThreads = 0;
 std::string input_file = "../code/TEST.ch8";
 std::string output_file;
+std::vector<std::string> bulk_inputs;
 
 int main(int argc, char** argv)
 {
@@ -19,6 +28,15 @@ int main(int argc, char** argv)
     if (!parseArgs(argc, argv))
         return EXIT_FAILURE;
 
+    /* assemble many files at once */
+    if(bBulk)
+    {
+        chip8bulkassembler bulk(bulk_inputs, output_file, nThreads, bOptimize, bReport, bDebuginfo);
+        bool ok = bulk.run();
+        bulk.printSummary();
+        return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
     // initialize assembler
     chip8assembler assembler(input_file, bVerbose);
 
@@ -29,10 +47,30 @@ int main(int argc, char** argv)
         return EXIT_FAILURE;
     }
 
+    /* optimize machine code */
+    if(bOptimize || bReport)
+    {
+        std::vector<uint16_t> original = assembler.machinecode;
+        chip8optimizer optimizer;
+        assembler.optimize(optimizer);
+        if(bReport)
+        {
+            // measure commands executed by the programme before and after optimization
+            optimizer.stats.executedBefore = chip8optimizer::countExecuted(original, nExecutionBudget);
+            optimizer.stats.executedAfter = chip8optimizer::countExecuted(assembler.machinecode, nExecutionBudget);
+            optimizer.stats.print();
+        }
+    }
+
     /* write machine code to disk */
     // swap endian before saving to disk on Unix
     assembler.swapEndian();
-    assembler.writeMachinecode(output_file);
+    if(!assembler.writeMachinecode(output_file))
+        return EXIT_FAILURE;
+
+    /* write debug info next to machine code */
+    if(bDebuginfo && !assembler.writeDebuginfo(output_file + ".dbg"))
+        return EXIT_FAILURE;
 
     return EXIT_SUCCESS;
 }
@@ -58,6 +96,62 @@ bool parseArgs(int argc, char** argv)
             if(i < argc)
             {
                 input_file = argv[i];
+                bulk_inputs.push_back(argv[i]);
+            }
+            else
+                return false;
+        }
+        // check for input directory, all *.ch8 files in it will be assembled in bulk mode
+        if(!std::strcmp(argv[i], "-d") || !std::strcmp(argv[i], "--dir"))
+        {
+            i++;
+            if(i < argc)
+            {
+                std::error_code ec;
+                std::vector<std::string> files;
+                for(const auto &entry : std::filesystem::directory_iterator(argv[i], ec))
+                    if(entry.is_regular_file() && entry.path().extension() == ".ch8")
+                        files.push_back(entry.path().string());
+                if(ec)
+                {
+                    fprintf(stderr, "ERROR: couldn't read directory \"%s\"\n", argv[i]);
+                    return false;
+                }
+                // keep order of files deterministic
+                std::sort(files.begin(), files.end());
+                bulk_inputs.insert(bulk_inputs.end(), files.begin(), files.end());
+                bBulk = true;
+            }
+            else
+                return false;
+        }
+        // check for optimizer
+        if(!std::strcmp(argv[i], "-O") || !std::strcmp(argv[i], "--optimize"))
+        {
+            bOptimize = true;
+        }
+        // check for optimizer report
+        if(!std::strcmp(argv[i], "-R") || !std::strcmp(argv[i], "--report"))
+        {
+            bReport = true;
+        }
+        // check for debug info
+        if(!std::strcmp(argv[i], "-g") || !std::strcmp(argv[i], "--debug"))
+        {
+            bDebuginfo = true;
+        }
+        // check for bulk mode
+        if(!std::strcmp(argv[i], "-b") || !std::strcmp(argv[i], "--bulk"))
+        {
+            bBulk = true;
+        }
+        // check for number of threads used in bulk mode
+        if(!std::strcmp(argv[i], "-j") || !std::strcmp(argv[i], "--jobs"))
+        {
+            i++;
+            if(i < argc)
+            {
+                nThreads = atoi(argv[i]);
             }
             else
                 return false;
@@ -81,19 +175,21 @@ bool parseArgs(int argc, char** argv)
         }
     }
 
-    // if no output filename was given cut ending of input file and use input capitalized filename for output
-    if(!bOutputSet)
+    // in bulk mode the output name is treated as output directory
+    if(bBulk)
     {
-        // cut path from filename
-        output_file = input_file.substr(input_file.find_last_of("/")+1);
-        // cut file extension of input filename if exists
-        size_t pos_ext;
-        if((pos_ext = output_file.find_last_of(".")) != std::string::npos)
-            output_file = output_file.substr(0, pos_ext);
-        // set capitalized cut input filename as output filename
-        std::transform(output_file.begin(), output_file.end(), output_file.begin(), ::toupper);
+        if(bulk_inputs.empty())
+        {
+            fprintf(stderr, "ERROR: no input files given for bulk mode\n");
+            return false;
+        }
+        return true;
     }
 
+    // if no output filename was given cut ending of input file and use input capitalized filename for output
+    if(!bOutputSet)
+        output_file = outputFilename(input_file);
+
     return true;
 }
 
@@ -106,4 +202,11 @@ void printUsage()
     printf( "-i --input PATH/TO/ROM                   set input filename\n");
     printf( "-o --output PATH/TO/ROM                  set output filename\n");
     printf( "-v --verbose                             activate for many outputs\n");
+    printf( "-O --optimize                            run peephole optimizer on machine code\n");
+    printf( "-R --report                              optimize and report commands saved, statically and at runtime\n");
+    printf( "-g --debug                               write debug info (source lines, symbols) to OUTPUT.dbg\n");
+    printf( "-b --bulk                                assemble all inputs (-i may be given multiple times) in one process,\n");
+    printf( "                                         -o then sets the output directory\n");
+    printf( "-d --dir PATH/TO/DIR                     assemble all *.ch8 files of directory in bulk mode\n");
+    printf( "-j --jobs N                              number of threads used in bulk mode (default: one per core)\n");
 }
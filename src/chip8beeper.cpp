@@ -0,0 +1,167 @@
+#include "chip8beeper.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+// samples the player hands to the stream at once, ~6 ms at 44.1 kHz
+static const size_t nPeriod = 256;
+
+chip8beeper::chip8beeper(uint32_t sampleRate, uint32_t frequency, int16_t amplitude)
+    : sampleRate{sampleRate}, phase{0}, phaseStep{uint32_t((uint64_t(frequency) << 32) / sampleRate)},
+      amplitude{amplitude}, frames{0}, beepFrames{0}, samples{0}, wav{nullptr}, stream{-1}, closing{false},
+      playing{false}, underruns{0}
+{
+    buffer.reserve(sampleRate / FRAME_RATE + 1);
+}
+
+chip8beeper::~chip8beeper()
+{
+    close();
+}
+
+bool chip8beeper::open_wav(const std::string &path)
+{
+    wav = fopen(path.c_str(), "wb");
+    if(!wav)
+    {
+        fprintf(stderr, "ERROR: couldn't write WAV file \"%s\"\n", path.c_str());
+        return false;
+    }
+    wavPath = path;
+    // RIFF header of 16 bit mono PCM, sizes are filled in by close()
+    // NOTE fields are written in host byte order, which is the little endian WAV requires on the hosts supported
+    struct
+    {
+        char riff[4]; uint32_t riffSize; char wave[4];
+        char fmt[4]; uint32_t fmtSize; uint16_t format; uint16_t channels; uint32_t rate; uint32_t byteRate;
+        uint16_t blockAlign; uint16_t bits;
+        char data[4]; uint32_t dataSize;
+    } hdr = {{'R','I','F','F'}, 36, {'W','A','V','E'}, {'f','m','t',' '}, 16, 1, 1, sampleRate, sampleRate * 2, 2, 16,
+             {'d','a','t','a'}, 0};
+    static_assert(sizeof(hdr) == 44, "WAV header must not be padded");
+    if(fwrite(&hdr, sizeof(hdr), 1, wav) != 1)
+    {
+        fprintf(stderr, "ERROR: couldn't write WAV file \"%s\"\n", path.c_str());
+        fclose(wav);
+        wav = nullptr;
+        return false;
+    }
+    return true;
+}
+
+bool chip8beeper::start_stream(const std::string &path)
+{
+    // NOTE opening a FIFO blocks till its reader opened it as well
+    stream = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(stream < 0)
+    {
+        fprintf(stderr, "ERROR: couldn't open audio stream \"%s\"\n", path.c_str());
+        return false;
+    }
+    playing = true;
+    thread = std::thread(&chip8beeper::player, this);
+    return true;
+}
+
+void chip8beeper::close()
+{
+    if(thread.joinable())
+    {
+        closing = true;
+        thread.join();
+    }
+    if(stream >= 0)
+        ::close(stream);
+    stream = -1;
+    if(wav)
+    {
+        uint32_t dataSize = samples * 2, riffSize = 36 + dataSize;
+        bool ok = fseek(wav, 4, SEEK_SET) == 0 && fwrite(&riffSize, 4, 1, wav) == 1;
+        ok = ok && fseek(wav, 40, SEEK_SET) == 0 && fwrite(&dataSize, 4, 1, wav) == 1;
+        ok = fclose(wav) == 0 && ok;
+        if(!ok)
+            fprintf(stderr, "ERROR: couldn't write WAV file \"%s\"\n", wavPath.c_str());
+    }
+    wav = nullptr;
+}
+
+void chip8beeper::frame(bool on)
+{
+    // a frame is 1/60 s, which isn't a whole number of samples at every rate, so frames are cut at the nearest sample
+    size_t n = (frames + 1) * sampleRate / FRAME_RATE - frames * sampleRate / FRAME_RATE;
+    buffer.resize(n);
+    if(on)
+    {
+        for(size_t i = 0; i < n; ++i, phase += phaseStep)
+            buffer[i] = phase & 0x80000000u ? -amplitude : amplitude;
+        ++beepFrames;
+    }
+    else
+    {
+        // NOTE the wave starts over with every beep, s.t. the same beeps sound the same
+        std::fill(buffer.begin(), buffer.end(), 0);
+        phase = 0;
+    }
+    ++frames;
+    samples += n;
+
+    if(wav && fwrite(buffer.data(), sizeof(int16_t), n, wav) != n)
+    {
+        fprintf(stderr, "ERROR: couldn't write WAV file \"%s\"\n", wavPath.c_str());
+        fclose(wav);
+        wav = nullptr;
+    }
+
+    // wait for the player to make room, it frees a period every ~6 ms
+    for(size_t written = 0; playing; )
+    {
+        written += ring.write(buffer.data() + written, n - written);
+        if(written == n)
+            break;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+void chip8beeper::player()
+{
+    // start once two frames are buffered, s.t. the first frames don't underrun while emulation starts up
+    size_t nPrefill = 2 * sampleRate / FRAME_RATE;
+    while(ring.size() < nPrefill && !closing)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+    // hand a period to the stream whenever the audio clock reached it
+    int16_t period[nPeriod];
+    auto duration = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<double>(double(nPeriod) / sampleRate));
+    auto next = std::chrono::steady_clock::now();
+    for(;;)
+    {
+        bool last = closing;
+        size_t n = ring.read(period, nPeriod);
+        if(last && n == 0)
+            break;
+        if(n < nPeriod)
+        {
+            std::memset(period + n, 0, sizeof(int16_t) * (nPeriod - n));
+            if(!last)
+                underruns += nPeriod - n;
+        }
+        if(write(stream, period, sizeof(period)) != ssize_t(sizeof(period)))
+        {
+            fprintf(stderr, "ERROR: audio stream closed\n");
+            break;
+        }
+        next += duration;
+        std::this_thread::sleep_until(next);
+    }
+    playing = false;
+}
+
+void chip8beeper::print(FILE *out) const
+{
+    fprintf(out, "audio: frames=%llu beep_frames=%llu samples=%llu rate=%u underruns=%llu\n", (unsigned long long)frames,
+            (unsigned long long)beepFrames, (unsigned long long)samples, sampleRate,
+            (unsigned long long)underruns.load());
+}
@@ -0,0 +1,194 @@
+#include "chip8processor.h"
+#include "chip8scaler.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+/* function prototypes */
+bool parseArgs(int argc, char** argv);
+void printUsage();
+bool recordFrames(std::vector<uint64_t> &frames);
+double benchScaler(const std::vector<uint64_t> &frames, int scale, chip8scaler::isa use, bool streaming, bool dirty,
+                   chip8scaler::isa &used);
+
+/* globals */
+std::string strFilename = "../roms/BRIX";
+int nFrames = 600;
+int nCommandsPerFrame = 10;
+std::vector<int> scales = {1, 2, 4, 8, 10, 16, 20};
+int nDecay = 0;
+std::vector<uint32_t> dirtyRows; // rows and columns written per frame
+std::vector<uint8_t> dirtyCols;
+const double minSeconds = 0.2; // each configuration is measured at least this long
+
+int main(int argc, char** argv)
+{
+    // read in args from command line
+    if(!parseArgs(argc, argv))
+        return EXIT_FAILURE;
+
+    // displays of a real game are rendered rather than synthetic patterns
+    std::vector<uint64_t> frames;
+    if(!recordFrames(frames))
+        return EXIT_FAILURE;
+    printf("rendering %zu frames of %s, decay %d\n", frames.size() / 32, strFilename.c_str(), nDecay);
+
+    size_t nDirty = 0;
+    for(uint32_t rows : dirtyRows)
+        nDirty += __builtin_popcount(rows);
+    printf("%.1f of 32 rows written per frame on average\n", double(nDirty) / dirtyRows.size());
+
+    // NOTE GB/s is the size of complete frames per second, also if only dirty rows are rendered
+    printf("%5s %9s %7s %7s %6s %12s %10s\n", "scale", "size", "isa", "stores", "rows", "frames/s", "GB/s");
+    for(int scale : scales)
+    {
+        for(chip8scaler::isa use : {chip8scaler::SCALAR, chip8scaler::SSE2, chip8scaler::AVX2})
+        {
+            for(bool streaming : {false, true})
+            {
+                for(bool dirty : {false, true})
+                {
+                    chip8scaler::isa used;
+                    double fps = benchScaler(frames, scale, use, streaming, dirty, used);
+                    // NOTE instruction sets the CPU lacks fall back to others, which are measured anyway
+                    if(used != use || (streaming && use == chip8scaler::SCALAR))
+                        continue;
+                    printf("%5d %4dx%-4d %7s %7s %6s %12.0f %10.2f\n", scale, 64 * scale, 32 * scale,
+                           chip8scaler::name(used), streaming ? "stream" : "cached", dirty ? "dirty" : "all", fps,
+                           fps * 64 * scale * 32 * scale * 4 / 1e9);
+                }
+            }
+        }
+    }
+    return EXIT_SUCCESS;
+}
+
+bool recordFrames(std::vector<uint64_t> &frames)
+{
+    // run the ROM with keys changing every second, s.t. the display changes as in play
+    chip8processor chip8(true);
+    if(chip8.load_ROM(strFilename) < 0)
+        return false;
+    chip8.seed(1);
+    chip8.detect_cycles(false);
+    frames.reserve(size_t(nFrames) * 32);
+    for(int f = 0; f < nFrames; ++f)
+    {
+        chip8.set_keys(1 << ((f / 60) % 16));
+        for(int c = 0; c < nCommandsPerFrame && chip8.is_running(); ++c)
+        {
+            if(chip8.fetch_command() < 0 || chip8.exec_command() < 0)
+                break;
+        }
+        chip8.tick_timers();
+        frames.insert(frames.end(), chip8.framebuffer(), chip8.framebuffer() + 32);
+        dirtyRows.push_back(chip8.dirty_rows());
+        dirtyCols.push_back(chip8.dirty_columns());
+        chip8.clear_dirty();
+    }
+    return true;
+}
+
+double benchScaler(const std::vector<uint64_t> &frames, int scale, chip8scaler::isa use, bool streaming, bool dirty,
+                   chip8scaler::isa &used)
+{
+    chip8scaler scaler(scale, 0xFFFFFFFF, 0xFF000000, nDecay, use, streaming);
+    used = scaler.instruction_set();
+    size_t n = frames.size() / 32, rendered = 0;
+    auto start = std::chrono::steady_clock::now();
+    double seconds = 0;
+    while(seconds < minSeconds)
+    {
+        for(size_t f = 0; f < n; ++f)
+        {
+            if(dirty)
+                scaler.render(frames.data() + 32 * f, dirtyRows[f], dirtyCols[f]);
+            else
+                scaler.render(frames.data() + 32 * f);
+        }
+        rendered += n;
+        seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+    return rendered / seconds;
+}
+
+bool parseArgs(int argc, char** argv)
+{
+    // parse commandline arguments
+    for (int i = 1; i < argc; ++i)
+    {
+        // print usage on demand
+        if(!std::strcmp(argv[i], "-h") || !std::strcmp(argv[i], "--help"))
+        {
+            printUsage();
+            return false;
+        }
+        // check for rom
+        if(!std::strcmp(argv[i], "-i") || !std::strcmp(argv[i], "--input"))
+        {
+            i++;
+            if(i < argc)
+            {
+                strFilename = argv[i];
+            }
+            else
+                return false;
+        }
+        // check for number of frames
+        if(!std::strcmp(argv[i], "-n") || !std::strcmp(argv[i], "--frames"))
+        {
+            i++;
+            if(i < argc)
+            {
+                nFrames = std::max(1, atoi(argv[i]));
+            }
+            else
+                return false;
+        }
+        // check for scale factors
+        if(!std::strcmp(argv[i], "-s") || !std::strcmp(argv[i], "--scales"))
+        {
+            i++;
+            if(i < argc)
+            {
+                scales.clear();
+                for(char *p = argv[i]; *p; )
+                {
+                    int scale = strtol(p, &p, 10);
+                    if(scale > 0) scales.push_back(scale);
+                    if(*p) ++p;
+                }
+            }
+            else
+                return false;
+        }
+        // check for phosphor decay
+        if(!std::strcmp(argv[i], "-d") || !std::strcmp(argv[i], "--decay"))
+        {
+            i++;
+            if(i < argc)
+            {
+                nDecay = atoi(argv[i]);
+            }
+            else
+                return false;
+        }
+    }
+
+    return true;
+}
+
+void printUsage()
+{
+    printf("Usage: chip8-bench [OPTION]...\n");
+    printf("Measures frames per second of rendering the display of a ROM into zoomed RGBA buffers.\n");
+    printf("\nOptions:\n");
+    printf("-h --help                                print usage\n");
+    printf("-i --input PATH/TO/ROM                   ROM to record frames of (default: ../roms/BRIX)\n");
+    printf("-n --frames N                            number of frames to record (default: 600)\n");
+    printf("-s --scales LIST                         comma separated scale factors (default: 1,2,4,8,10,16,20)\n");
+    printf("-d --decay N                             phosphor decay, intensity kept per frame in 1/256 (default: 0)\n");
+}
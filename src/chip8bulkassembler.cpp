@@ -0,0 +1,129 @@
+#include "chip8bulkassembler.h"
+#include "chip8assembler.h"
+#include "chip8parallel.h"
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <stdio.h>
+
+chip8bulkassembler::chip8bulkassembler(const std::vector<std::string> &inputs, const std::string &outdir, int nthreads,
+                                       bool optimize, bool measure, bool debuginfo)
+    : nthreads{nthreads}, optimize{optimize || measure}, measure{measure}, debuginfo{debuginfo},
+      seconds{0.0}
+{
+    // one job per input file, output files are named like in single file mode but placed in outdir
+    // NOTE output names only depend on the file name, inputs of the same name in different directories would race on
+    // one output, so only the first of them is assembled and the others fail
+    jobs.resize(inputs.size());
+    std::map<std::string, size_t> outputs;
+    for(size_t i=0; i<inputs.size(); ++i)
+    {
+        jobs[i].input = inputs[i];
+        jobs[i].output = outdir.empty() ? outputFilename(inputs[i]) : outdir + "/" + outputFilename(inputs[i]);
+        auto it = outputs.emplace(jobs[i].output, i).first;
+        if(it->second != i)
+        {
+            jobs[i].collision = true;
+            jobs[i].errors = "ERROR: output \"" + jobs[i].output + "\" is written for \"" + inputs[it->second] +
+                             "\" already\n";
+        }
+    }
+    this->nthreads = chip8parallel::threads(nthreads, jobs.size());
+}
+
+bool chip8bulkassembler::run()
+{
+    auto t0 = std::chrono::steady_clock::now();
+
+    chip8parallel::run(nthreads, jobs.size(), [this](chip8parallel::cursor &c) { worker(c); });
+
+    seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+    return std::all_of(jobs.begin(), jobs.end(), [](const job &j) { return j.ok; });
+}
+
+void chip8bulkassembler::worker(chip8parallel::cursor &c)
+{
+    // each worker owns one assembler which is reused for all of its files
+    // NOTE this way the source, token and machine code buffers of the assembler are only grown once per thread
+    chip8assembler assembler(false);
+    assembler.quiet = true;
+
+    for(size_t i; c.next(i); )
+    {
+        job &j = jobs[i];
+        if(j.collision)
+            continue;
+        assembler.errors.clear();
+        if(assembler.load(j.input) && assembler.compile())
+        {
+            if(optimize)
+                optimizeJob(assembler, j);
+            assembler.swapEndian();
+            j.ok = assembler.writeMachinecode(j.output);
+            if(j.ok && debuginfo)
+                j.ok = assembler.writeDebuginfo(j.output + ".dbg");
+            j.bytes = assembler.bytes();
+        }
+        j.lines = assembler.lines();
+        j.errors = assembler.errors;
+    }
+}
+
+void chip8bulkassembler::optimizeJob(chip8assembler &assembler, job &j)
+{
+    std::vector<uint16_t> original;
+    if(measure) original = assembler.machinecode;
+    chip8optimizer optimizer;
+    assembler.optimize(optimizer);
+    j.report = optimizer.stats;
+    if(measure)
+    {
+        j.report.executedBefore = chip8optimizer::countExecuted(original, nExecutionBudget);
+        j.report.executedAfter = chip8optimizer::countExecuted(assembler.machinecode, nExecutionBudget);
+    }
+}
+
+void chip8bulkassembler::printSummary()
+{
+    size_t nLines = 0, nBytes = 0, nFailed = 0;
+    chip8optimizer::report report;
+    for(const job &j : jobs)
+    {
+        nLines += j.lines;
+        nBytes += j.bytes;
+        report += j.report;
+        if(!j.ok) nFailed++;
+    }
+
+    printf("assembled %zu files (%zu lines, %zu bytes) in %.3f s with %i threads\n",
+           jobs.size() - nFailed, nLines, nBytes, seconds, nthreads);
+    if(seconds > 0.0)
+        printf("throughput: %.0f lines/s, %.0f bytes/s\n", nLines / seconds, nBytes / seconds);
+    if(optimize)
+        report.print();
+
+    if(nFailed == 0)
+        return;
+
+    // single error summary, errors of each file are reported in the order the files were passed
+    fprintf(stderr, "ERROR: %zu of %zu files failed to assemble:\n", nFailed, jobs.size());
+    for(const job &j : jobs)
+    {
+        if(j.ok) continue;
+        fprintf(stderr, "#### %s ####\n%s", j.input.c_str(), j.errors.c_str());
+    }
+}
+
+std::string outputFilename(const std::string &input)
+{
+    // cut path from filename
+    std::string output = input.substr(input.find_last_of("/")+1);
+    // cut file extension of input filename if exists
+    size_t pos_ext;
+    if((pos_ext = output.find_last_of(".")) != std::string::npos)
+        output = output.substr(0, pos_ext);
+    // use capitalized cut input filename as output filename
+    std::transform(output.begin(), output.end(), output.begin(), ::toupper);
+    return output;
+}
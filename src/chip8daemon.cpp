@@ -0,0 +1,101 @@
+#include "chip8server.h"
+#include <csignal>
+#include <cstring>
+#include <thread>
+
+/* function prototypes */
+bool parseArgs(int argc, char** argv);
+void printUsage();
+void onSignal(int);
+
+/* globals */
+std::string strSocket = "/tmp/chip8.sock";
+int nWorkers = std::thread::hardware_concurrency();
+size_t nSessions = 8192;
+chip8server *pServer = nullptr;
+
+int main(int argc, char** argv)
+{
+    // read in args from command line
+    if(!parseArgs(argc, argv))
+        return EXIT_FAILURE;
+
+    chip8server server(nWorkers, nSessions);
+    if(!server.listen(strSocket))
+        return EXIT_FAILURE;
+
+    // serve till Ctrl-C or kill, then print statistics
+    pServer = &server;
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+    printf("serving on \"%s\"\n", strSocket.c_str());
+    fflush(stdout);
+    server.run();
+    server.print(stdout);
+    return EXIT_SUCCESS;
+}
+
+void onSignal(int)
+{
+    pServer->stop();
+}
+
+bool parseArgs(int argc, char** argv)
+{
+    // parse commandline arguments
+    for (int i = 1; i < argc; ++i)
+    {
+        // print usage on demand
+        if(!std::strcmp(argv[i], "-h") || !std::strcmp(argv[i], "--help"))
+        {
+            printUsage();
+            return false;
+        }
+        // check for socket to listen on
+        if(!std::strcmp(argv[i], "-S") || !std::strcmp(argv[i], "--socket"))
+        {
+            i++;
+            if(i < argc)
+            {
+                strSocket = argv[i];
+            }
+            else
+                return false;
+        }
+        // check for number of workers
+        if(!std::strcmp(argv[i], "-w") || !std::strcmp(argv[i], "--workers"))
+        {
+            i++;
+            if(i < argc)
+            {
+                nWorkers = atoi(argv[i]);
+            }
+            else
+                return false;
+        }
+        // check for number of sessions
+        if(!std::strcmp(argv[i], "-n") || !std::strcmp(argv[i], "--sessions"))
+        {
+            i++;
+            if(i < argc)
+            {
+                nSessions = strtoul(argv[i], nullptr, 10);
+            }
+            else
+                return false;
+        }
+    }
+
+    return true;
+}
+
+void printUsage()
+{
+    printf("Usage: chip8-server [OPTION]...\n");
+    printf("Hosts CHIP-8 sessions for clients of a Unix domain socket, see include/chip8protocol.h.\n");
+    printf("\nOptions:\n");
+    printf("-h --help                                print usage\n");
+    printf("-S --socket PATH                         socket to listen on (default: /tmp/chip8.sock)\n");
+    printf("-w --workers N                           worker threads, each pinned to a core (default: number of cores)\n");
+    printf("-n --sessions N                          sessions preallocated, split evenly among workers (default: 8192)\n");
+}
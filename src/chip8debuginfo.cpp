@@ -0,0 +1,202 @@
+#include "chip8debuginfo.h"
+#include <cstring>
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+void chip8debuginfo::builder::setFile(const std::string &name)
+{
+    // subsequent lines belong to this file
+    files.push_back(name);
+}
+
+void chip8debuginfo::builder::addLine(uint16_t addr, int line)
+{
+    lines[addr] = std::make_pair(line, uint16_t(files.empty() ? 0 : files.size()-1));
+}
+
+void chip8debuginfo::builder::addSymbol(const std::string &name, uint16_t addr)
+{
+    symbols.insert(std::make_pair(addr, name));
+}
+
+bool chip8debuginfo::builder::write(const std::string &path) const
+{
+    // assemble string table, offset 0 is the empty string
+    std::string strings(1, '\0');
+    auto addString = [&strings](const std::string &s) {
+        uint32_t offset = strings.size();
+        strings += s;
+        strings += '\0';
+        return offset;
+    };
+
+    header hdr;
+    std::memcpy(hdr.magic, "C8DG", 4);
+    hdr.version = VERSION;
+    hdr.base = lines.empty() ? 0x200 : lines.begin()->first;
+    hdr.reserved = 0;
+    hdr.nLocations = lines.empty() ? 0 : lines.rbegin()->first - hdr.base + 1;
+    hdr.nSymbols = symbols.size();
+    hdr.nFiles = files.size();
+
+    // symbols are sorted by address, s.t. each location can refer to the closest symbol in front of it
+    std::vector<symbol> symbolTable;
+    for(auto it=symbols.begin(); it!=symbols.end(); ++it)
+        symbolTable.push_back(symbol{addString(it->second), it->first, 0});
+    std::vector<file> fileTable;
+    for(const std::string &f : files)
+        fileTable.push_back(file{addString(f)});
+
+    std::vector<location> locationTable(hdr.nLocations, location{0, 0, NO_SYMBOL});
+    size_t s = 0;
+    for(uint32_t i=0; i<hdr.nLocations; ++i)
+    {
+        uint16_t addr = hdr.base + i;
+        while(s < symbolTable.size() && symbolTable[s].addr <= addr) s++;
+        locationTable[i].symbol = s > 0 ? uint16_t(s-1) : NO_SYMBOL;
+        auto it = lines.find(addr);
+        if(it != lines.end())
+        {
+            locationTable[i].line = it->second.first;
+            locationTable[i].file = it->second.second;
+        }
+    }
+
+    hdr.offLocations = sizeof(header);
+    hdr.offSymbols = hdr.offLocations + sizeof(location) * locationTable.size();
+    hdr.offFiles = hdr.offSymbols + sizeof(symbol) * symbolTable.size();
+    hdr.offStrings = hdr.offFiles + sizeof(file) * fileTable.size();
+    hdr.lenStrings = strings.size();
+
+    FILE *pFile = fopen(path.c_str(), "wb");
+    if(!pFile)
+        return false;
+    bool ok = fwrite(&hdr, sizeof(header), 1, pFile) == 1;
+    ok = ok && fwrite(locationTable.data(), sizeof(location), locationTable.size(), pFile) == locationTable.size();
+    ok = ok && fwrite(symbolTable.data(), sizeof(symbol), symbolTable.size(), pFile) == symbolTable.size();
+    ok = ok && fwrite(fileTable.data(), sizeof(file), fileTable.size(), pFile) == fileTable.size();
+    ok = ok && fwrite(strings.data(), 1, strings.size(), pFile) == strings.size();
+    fclose(pFile);
+    return ok;
+}
+
+chip8debuginfo::chip8debuginfo()
+    : data{nullptr}, size{0}, hdr{nullptr}, locations{nullptr}, symbols{nullptr}, files{nullptr}, strings{nullptr}
+{
+}
+
+chip8debuginfo::~chip8debuginfo()
+{
+    close();
+}
+
+bool chip8debuginfo::open(const std::string &path)
+{
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if(fd < 0)
+    {
+        fprintf(stderr, "ERROR: couldn't open debug info \"%s\"\n", path.c_str());
+        return false;
+    }
+    struct stat st;
+    if(fstat(fd, &st) != 0 || size_t(st.st_size) < sizeof(header))
+    {
+        fprintf(stderr, "ERROR: \"%s\" is no valid debug info\n", path.c_str());
+        ::close(fd);
+        return false;
+    }
+    void *p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd); // NOTE the mapping stays valid after closing the file
+    if(p == MAP_FAILED)
+    {
+        fprintf(stderr, "ERROR: couldn't map debug info \"%s\"\n", path.c_str());
+        return false;
+    }
+    data = static_cast<const uint8_t*>(p);
+    size = st.st_size;
+
+    // validate header, s.t. all later lookups can go without checks
+    hdr = reinterpret_cast<const header*>(data);
+    bool valid = !std::memcmp(hdr->magic, "C8DG", 4) && hdr->version == VERSION &&
+                 hdr->offLocations + uint64_t(sizeof(location)) * hdr->nLocations <= size &&
+                 hdr->offSymbols + uint64_t(sizeof(symbol)) * hdr->nSymbols <= size &&
+                 hdr->offFiles + uint64_t(sizeof(file)) * hdr->nFiles <= size &&
+                 hdr->offStrings + uint64_t(hdr->lenStrings) <= size && hdr->lenStrings > 0 &&
+                 data[hdr->offStrings + hdr->lenStrings - 1] == '\0';
+    if(!valid)
+    {
+        fprintf(stderr, "ERROR: \"%s\" is no valid debug info\n", path.c_str());
+        close();
+        return false;
+    }
+    locations = reinterpret_cast<const location*>(data + hdr->offLocations);
+    symbols = reinterpret_cast<const symbol*>(data + hdr->offSymbols);
+    files = reinterpret_cast<const file*>(data + hdr->offFiles);
+    strings = reinterpret_cast<const char*>(data + hdr->offStrings);
+    return true;
+}
+
+void chip8debuginfo::close()
+{
+    if(data)
+        munmap(const_cast<uint8_t*>(data), size);
+    data = nullptr; size = 0; hdr = nullptr;
+    locations = nullptr; symbols = nullptr; files = nullptr; strings = nullptr;
+}
+
+const chip8debuginfo::location* chip8debuginfo::lookup(uint16_t addr) const
+{
+    if(!data || addr < hdr->base || uint32_t(addr - hdr->base) >= hdr->nLocations)
+        return nullptr;
+    return &locations[addr - hdr->base];
+}
+
+const char* chip8debuginfo::string(uint32_t offset) const
+{
+    return offset < hdr->lenStrings ? strings + offset : "";
+}
+
+const char* chip8debuginfo::fileName(const location &loc) const
+{
+    return loc.file < hdr->nFiles ? string(files[loc.file].name) : "";
+}
+
+const char* chip8debuginfo::symbolName(const location &loc) const
+{
+    return loc.symbol < hdr->nSymbols ? string(symbols[loc.symbol].name) : "";
+}
+
+uint16_t chip8debuginfo::symbolAddress(const location &loc) const
+{
+    return loc.symbol < hdr->nSymbols ? symbols[loc.symbol].addr : hdr->base;
+}
+
+const char* chip8debuginfo::symbolAt(uint16_t addr) const
+{
+    // name of symbol defined exactly at address, nullptr if there is none
+    const location *loc = lookup(addr);
+    if(!loc || loc->symbol >= hdr->nSymbols || symbols[loc->symbol].addr != addr)
+        return nullptr;
+    return symbolName(*loc);
+}
+
+std::string chip8debuginfo::describe(uint16_t addr) const
+{
+    // format location of address like "file:line (symbol+offset)"
+    const location *loc = lookup(addr);
+    if(!loc || loc->line == 0)
+        return "";
+    char buf[256];
+    const char *name = fileName(*loc);
+    const char *base = std::strrchr(name, '/');
+    if(loc->symbol != NO_SYMBOL)
+        snprintf(buf, sizeof(buf), "%s:%u (%s+%u)", base ? base+1 : name, loc->line,
+                 symbolName(*loc), unsigned(addr - symbolAddress(*loc)));
+    else
+        snprintf(buf, sizeof(buf), "%s:%u", base ? base+1 : name, loc->line);
+    return buf;
+}
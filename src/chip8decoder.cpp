@@ -0,0 +1,82 @@
+#include "chip8decoder.h"
+#include "chip8output.h"
+
+static const char hexdigits[] = "0123456789abcdef";
+
+// expand mnemonic format of command into buf, returns number of chars written (without terminating zero)
+// NOTE in source syntax bytes are prefixed by 0x, nibbles are decimal and addresses are replaced by label,
+// s.t. the result is accepted by chip8assembler
+static int expand(uint16_t w, char *buf, size_t len, bool source, const char *label)
+{
+    chip8decoder::instruction ins = chip8decoder::decode(w);
+    size_t i = 0;
+    auto put = [&](char c) { if(i+1 < len) buf[i++] = c; };
+    auto hex = [&](unsigned v, int digits) {
+        for(int d=digits-1; d>=0; --d)
+            put(hexdigits[(v >> (4*d)) & 0xF]);
+    };
+    for(const char *f = chip8decoder::formats[ins.k]; *f; ++f)
+    {
+        if(*f != '%')
+        {
+            put(*f);
+            continue;
+        }
+        switch(*++f)
+        {
+        case 'x': hex(ins.x, 1); break;
+        case 'y': hex(ins.y, 1); break;
+        case 'n':
+            if(source && ins.n >= 10) put('1');
+            hex(source ? ins.n % 10 : ins.n, 1);
+            break;
+        case 'k':
+            if(source) { put('0'); put('x'); }
+            hex(ins.kk, 2);
+            break;
+        case 'a':
+            if(!source) hex(ins.nnn, 3);
+            else for(const char *l = label; *l; ++l) put(*l);
+            break;
+        case 'w': hex(w, 4); break;
+        default: put(*f);
+        }
+    }
+    if(len > 0) buf[i] = '\0';
+    return i;
+}
+
+int chip8decoder::format(uint16_t w, char *buf, size_t len)
+{
+    return expand(w, buf, len, false, nullptr);
+}
+
+int chip8decoder::formatSource(uint16_t w, const char *label, char *buf, size_t len)
+{
+    return expand(w, buf, len, true, label);
+}
+
+void chip8disassemble(const uint8_t *rom, size_t len, uint16_t addr, FILE *out)
+{
+    char mnemonic[32];
+    for(size_t i=0; i<len; i+=2)
+    {
+        uint16_t w = (rom[i] << 8) | (i+1 < len ? rom[i+1] : 0);
+        chip8decoder::format(w, mnemonic, sizeof(mnemonic));
+        fprintf(out, "0x%03zx: %s\n", addr + i, mnemonic);
+    }
+}
+
+void chip8disassemble(const uint8_t *rom, size_t len, uint16_t addr, chip8output &out)
+{
+    // same as above, but commands are formatted right into the output buffer
+    for(size_t i=0; i<len; i+=2)
+    {
+        uint16_t w = (rom[i] << 8) | (i+1 < len ? rom[i+1] : 0);
+        out.put("0x", 2);
+        out.hex(addr + i, 3);
+        out.put(": ", 2);
+        out.advance(chip8decoder::format(w, out.reserve(32), 32));
+        out.put('\n');
+    }
+}
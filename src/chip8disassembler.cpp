@@ -1,13 +1,31 @@
-#include "chip8processor.h"
+#include "chip8analyzer.h"
+#include "chip8decoder.h"
+#include "chip8debuginfo.h"
+#include "chip8output.h"
+#include "chip8roundtrip.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
 #include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
 
 /* function prototypes */
 bool parseArgs(int argc, char** argv);
 void printUsage();
+bool readROM(const std::string &filename, std::vector<uint8_t> &rom, size_t maxlen);
+void printROM(const std::vector<uint8_t> &rom, int cols, chip8output &out);
 
 /* globals */
 std::string strFilename = "../roms/MAZE";
 int nMemMapCols = 16;
+std::string strDebuginfo;
+bool bRecursive = false;
+bool bSource = false;
+bool bKeepSource = false;
+int nThreads = 0;
+std::vector<std::string> roundtrip_inputs;
 
 int main(int argc, char** argv)
 {
@@ -15,36 +33,119 @@ int main(int argc, char** argv)
     if(!parseArgs(argc, argv))
         return EXIT_FAILURE;
 
-    // initialize chip8 emulator
-    chip8processor CHIP_8;
+    // disassemble and reassemble many ROMs at once
+    if(!roundtrip_inputs.empty())
+    {
+        chip8roundtrip roundtrip(roundtrip_inputs, nThreads, bKeepSource);
+        bool ok = roundtrip.run();
+        roundtrip.printSummary();
+        return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
 
-    // load ROM to emulate
-    size_t lenROM = CHIP_8.load_ROM(strFilename);
-    if(lenROM < 0)
+    // load ROM to disassemble, there is no need for a CHIP-8 machine to do so
+    // NOTE the recursive disassembler accepts XO-CHIP images which fill the complete 64K address space
+    std::vector<uint8_t> rom;
+    if(!readROM(strFilename, rom, bRecursive || bSource ? 0x10000 - 0x200 : 0x1000 - 0x200))
     {
         printf("failed to load ROM %s\n", strFilename.c_str());
         return EXIT_FAILURE;
     }
 
-    // print memory map
-    CHIP_8.print_complete_memory_map(nMemMapCols);
+    // print source accepted by chip8-assembly, nothing else s.t. it can be redirected into a file
+    if(bSource)
+    {
+        chip8analyzer analyzer(rom.data(), rom.size());
+        analyzer.analyze();
+        analyzer.printSource(stdout);
+        return EXIT_SUCCESS;
+    }
 
     // print ROM binary
-    CHIP_8.print_ROM(lenROM, nMemMapCols);
+    // NOTE dump and listing are formatted into one buffer, which is written out at once
+    chip8output out;
+    printROM(rom, nMemMapCols, out);
+
+    // load debug info to annotate code with symbols and source lines
+    chip8debuginfo debuginfo;
+    if(!strDebuginfo.empty() && !debuginfo.open(strDebuginfo))
+    {
+        out.flush();
+        return EXIT_FAILURE;
+    }
+
+    // follow control flow from the entry point to separate code from data
+    if(bRecursive)
+    {
+        auto t0 = std::chrono::steady_clock::now();
+        chip8analyzer analyzer(rom.data(), rom.size());
+        analyzer.analyze();
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+        out.flush();
+        analyzer.print(stdout);
+        printf("analyzed in %.3f ms\n", ms);
+        return EXIT_SUCCESS;
+    }
 
     // disassemble rom code
-    printf("######## DISASSEMBLED CODE ########\n");
-    for(size_t i=0; i<lenROM; i+=2)
+    out.put("######## DISASSEMBLED CODE ########\n");
+    if(!debuginfo.is_open())
     {
-        // fetch command
-        CHIP_8.fetch_command();
+        chip8disassemble(rom.data(), rom.size(), 0x200, out);
+        return EXIT_SUCCESS;
+    }
+    for(size_t i=0; i<rom.size(); i+=2)
+    {
+        // print symbol and source line of command
+        uint16_t addr = 0x200 + i;
+        const char *symbol = debuginfo.symbolAt(addr);
+        if(symbol)
+        {
+            out.put(symbol);
+            out.put(":\n", 2);
+        }
+        std::string location = debuginfo.describe(addr);
+        location.resize(std::max<size_t>(location.size(), 24), ' ');
+        out.put(location.data(), location.size());
+        out.put(' ');
         // disassemble command
-        CHIP_8.disassemble_command();
+        chip8disassemble(rom.data() + i, std::min<size_t>(2, rom.size() - i), addr, out);
     }
 
     return EXIT_SUCCESS;
 }
 
+bool readROM(const std::string &filename, std::vector<uint8_t> &rom, size_t maxlen)
+{
+    // read complete file, ROMs need to fit into memory behind address 0x200
+    FILE *pfRom = fopen(filename.c_str(), "rb");
+    if(!pfRom)
+    {
+        printf("couldn't open file \"%s\"\n", filename.c_str());
+        return false;
+    }
+    fseek(pfRom, 0L, SEEK_END);
+    size_t nBytesFile = ftell(pfRom);
+    fseek(pfRom, 0L, SEEK_SET);
+    rom.resize(std::min<size_t>(nBytesFile, maxlen));
+    size_t nRead = fread(rom.data(), sizeof(uint8_t), rom.size(), pfRom);
+    fclose(pfRom);
+    return nRead == rom.size();
+}
+
+void printROM(const std::vector<uint8_t> &rom, int cols, chip8output &out)
+{
+    out.put("######## ROM CODE ########\n");
+    // full rows are dumped straight from the ROM, the last one is padded by zeros
+    size_t full = rom.size() - rom.size() % cols;
+    out.hexdump(rom.data(), full, 0x200, cols);
+    if(full < rom.size())
+    {
+        std::vector<uint8_t> last(cols, 0);
+        std::copy(rom.begin() + full, rom.end(), last.begin());
+        out.hexdump(last.data(), cols, 0x200 + full, cols);
+    }
+}
+
 bool parseArgs(int argc, char** argv)
 {
     // if no arg is passed use default config
@@ -71,6 +172,68 @@ bool parseArgs(int argc, char** argv)
             else
                 return false;
         }
+        // check for debug info
+        if(!std::strcmp(argv[i], "-g") || !std::strcmp(argv[i], "--debug"))
+        {
+            i++;
+            if(i < argc)
+            {
+                strDebuginfo = argv[i];
+            }
+            else
+                return false;
+        }
+        // check for recursive disassembly
+        if(!std::strcmp(argv[i], "-r") || !std::strcmp(argv[i], "--recursive"))
+        {
+            bRecursive = true;
+        }
+        // check for reassemblable source output
+        if(!std::strcmp(argv[i], "-s") || !std::strcmp(argv[i], "--source"))
+        {
+            bSource = true;
+        }
+        // check for round trip directory, all files in it are disassembled, reassembled and compared
+        if(!std::strcmp(argv[i], "-t") || !std::strcmp(argv[i], "--roundtrip"))
+        {
+            i++;
+            if(i < argc)
+            {
+                std::error_code ec;
+                std::vector<std::string> files;
+                // NOTE sources kept by -k and debug info are no ROMs, s.t. a directory can be round tripped again
+                for(const auto &entry : std::filesystem::directory_iterator(argv[i], ec))
+                    if(entry.is_regular_file() && entry.path().extension() != ".s" &&
+                       entry.path().extension() != ".dbg")
+                        files.push_back(entry.path().string());
+                if(ec)
+                {
+                    fprintf(stderr, "ERROR: couldn't read directory \"%s\"\n", argv[i]);
+                    return false;
+                }
+                // keep order of files deterministic
+                std::sort(files.begin(), files.end());
+                roundtrip_inputs.insert(roundtrip_inputs.end(), files.begin(), files.end());
+            }
+            else
+                return false;
+        }
+        // check for keeping the sources of the round trip
+        if(!std::strcmp(argv[i], "-k") || !std::strcmp(argv[i], "--keep"))
+        {
+            bKeepSource = true;
+        }
+        // check for number of threads used in round trip mode
+        if(!std::strcmp(argv[i], "-j") || !std::strcmp(argv[i], "--jobs"))
+        {
+            i++;
+            if(i < argc)
+            {
+                nThreads = atoi(argv[i]);
+            }
+            else
+                return false;
+        }
         // check for memory map format
         if(!std::strcmp(argv[i], "-c") || !std::strcmp(argv[i], "--cols"))
         {
@@ -94,5 +257,11 @@ void printUsage()
     printf( "\nOptions:\n");
     printf( "-h --help                                print usage\n");
     printf( "-i --input PATH/TO/ROM                   set rom to disassemble\n");
-    printf( "-c --cols                               set columns of memory map\n");
+    printf( "-c --cols                               set columns of ROM dump\n");
+    printf( "-g --debug PATH/TO/ROM.dbg               annotate code with symbols and source lines\n");
+    printf( "-r --recursive                           follow control flow to separate code from data, print basic blocks and call graph\n");
+    printf( "-s --source                              print source which chip8-assembly turns into the identical ROM\n");
+    printf( "-t --roundtrip DIR                       disassemble, reassemble and compare all ROMs in DIR\n");
+    printf( "-k --keep                                keep the sources of the round trip next to the ROMs (ROM.s), later round trips skip them\n");
+    printf( "-j --jobs N                              number of threads used in round trip mode (default: one per core)\n");
 }
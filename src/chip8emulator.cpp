@@ -1,15 +1,88 @@
 #include "chip8processor.h"
+#include "chip8beeper.h"
+#include "chip8livesource.h"
+#include "chip8debuginfo.h"
+#include "chip8export.h"
+#include "chip8gif.h"
+#include "chip8input.h"
+#include "chip8movie.h"
+#include "chip8netplay.h"
+#include "chip8quirks.h"
+#include "chip8romarchive.h"
+#include "chip8savestate.h"
+#include "chip8shm.h"
+#include "chip8supervisor.h"
+#include "chip8terminal.h"
+#include <algorithm>
+#include <chrono>
+#include <csignal>
 #include <cstring>
+#include <ctime>
+#include <memory>
+#include <thread>
+#include <vector>
 
 /* function prototypes */
 bool parseArgs(int argc, char** argv);
 void printUsage();
+void printProfile(const std::vector<uint64_t> &hits, const chip8debuginfo &debuginfo);
+void onInterrupt(int);
+uint16_t inputKeys(uint32_t frame, uint16_t keys);
+bool endFrame(uint32_t frame, chip8processor &chip8, chip8supervisor &supervisor, chip8movie &movie);
 
 /* globals */
 std::string strFilename = "../roms/FISHIE";
+std::string strArchive;
 int nMemMapCols = 16;
 bool bStepMode = false;
 bool bVerbose = false;
+std::string strSource;
+bool bHotReload = false;
+const int nReloadInterval = 1000; // number of commands executed between two checks for source changes
+std::string strDebuginfo;
+bool bProfile = false;
+std::string strLoadState;
+std::string strSaveState;
+bool bCompressState = false;
+chip8supervisor::conditions haltConditions;
+uint8_t nQuirks = chip8quirks::CLIP;
+bool bSeed = false;
+uint32_t nSeed = 0;
+std::string strRecord;
+std::string strReplay;
+uint32_t nChecksumInterval = 1;
+std::string strKeyScript;
+std::vector<chip8movie::event> keyScript;
+size_t nNextKeyEvent = 0;
+bool bRandomKeys = false;
+uint32_t nKeyRng = 1;
+bool bKeyboard = false;
+chip8input keyboard;
+std::string strWav;
+std::string strAudioStream;
+chip8beeper beeper;
+bool bSoundInFrame = false;     // sound timer was running when the frame started
+bool bDisplay = false;
+chip8terminal terminal;
+int nFps = -1;                  // frames per second emulation is paced to, 0 for as fast as possible
+std::chrono::steady_clock::time_point nextFrame;
+std::string strExport;
+chip8export::format exportFormat = chip8export::RAW;
+int nExportScale = 1;
+uint32_t nExportEvery = 1;
+std::unique_ptr<chip8export> exporter;
+std::string strGif;
+int nGifScale = 4;
+bool bGifDedup = false;
+std::unique_ptr<chip8gif> gif;
+std::string strPublish;
+chip8shm shm;
+std::string strNetplay;
+std::string strImpairment;
+uint32_t nNetplayWindow = 8;
+chip8netplay netplay;
+uint16_t nLocalKeys = 0;        // keys of this player in netplay, the peer's are added to them
+volatile sig_atomic_t bInterrupted = 0;
 
 int main(int argc, char** argv)
 {
@@ -20,14 +93,60 @@ int main(int argc, char** argv)
     // initialize chip8 emulator
     chip8processor CHIP_8;
 
-    // load ROM to emulate
-    size_t lenROM = CHIP_8.load_ROM(strFilename);
+    // load ROM to emulate, either from disk or assembled in memory from source
+    std::unique_ptr<chip8livesource> source;
+    int lenROM;
+    if(!strSource.empty())
+    {
+        source.reset(new chip8livesource(strSource, bVerbose));
+        if(!source->load(CHIP_8))
+        {
+            printf("failed to assemble source %s\n", strSource.c_str());
+            return EXIT_FAILURE;
+        }
+        lenROM = CHIP_8.program_size();
+    }
+    else if(!strArchive.empty())
+    {
+        // take ROM straight from the mapped archive, it is named by its file name
+        chip8romarchive archive;
+        if(!archive.open(strArchive))
+            return EXIT_FAILURE;
+        size_t slash = strFilename.rfind('/');
+        const chip8romarchive::entry *e = archive.find(strFilename.substr(slash == std::string::npos ? 0 : slash + 1));
+        lenROM = e ? CHIP_8.load_program(archive.rom(*e), e->size) : -1;
+        if(lenROM >= 0)
+            printf("load ROM \"%s\" from archive \"%s\"\n", archive.name(*e), strArchive.c_str());
+    }
+    else
+        lenROM = CHIP_8.load_ROM(strFilename);
     if(lenROM < 0)
     {
         printf("failed to load ROM %s\n", strFilename.c_str());
         return EXIT_FAILURE;
     }
 
+    // seed random generator, s.t. runs can be reproduced from their input
+    // NOTE a replay takes over everything the recorded run depended on besides the ROM
+    chip8movie movie;
+    uint32_t seed = bSeed ? nSeed : (uint32_t)time(nullptr);
+    CHIP_8.set_quirks(nQuirks);
+    if(!strReplay.empty())
+    {
+        if(!movie.open(strReplay))
+            return EXIT_FAILURE;
+        if(movie.info().romHash != CHIP_8.rom_hash())
+        {
+            fprintf(stderr, "ERROR: movie belongs to another ROM (hash %016llx, running %016llx)\n",
+                    (unsigned long long)movie.info().romHash, (unsigned long long)CHIP_8.rom_hash());
+            return EXIT_FAILURE;
+        }
+        seed = movie.info().seed;
+        CHIP_8.set_quirks(movie.info().quirks);
+        haltConditions.commandsPerFrame = movie.info().commandsPerFrame;
+    }
+    CHIP_8.seed(seed);
+
     if(bVerbose)
     {
         // print memory map
@@ -37,25 +156,148 @@ int main(int argc, char** argv)
         CHIP_8.print_ROM(lenROM, nMemMapCols);
     }
 
+    // load debug info to map addresses to source lines
+    chip8debuginfo debuginfo;
+    if(!strDebuginfo.empty() && !debuginfo.open(strDebuginfo))
+        return EXIT_FAILURE;
+
+    // continue from a saved state of the same ROM
+    if(!strLoadState.empty())
+    {
+        chip8savestate state;
+        if(!state.open(strLoadState) || !state.restore(CHIP_8))
+            return EXIT_FAILURE;
+        printf("load state \"%s\"\n", strLoadState.c_str());
+    }
+
+    // start recording or replaying input, frames are counted from here on
+    if(!strReplay.empty())
+    {
+        if(CHIP_8.state_hash() != movie.info().startHash)
+        {
+            fprintf(stderr, "ERROR: movie was recorded from another state, e.g. one loaded by -L\n");
+            return EXIT_FAILURE;
+        }
+        CHIP_8.set_keys(movie.keys(0));
+        printf("replay movie \"%s\" (%u frames)\n", strReplay.c_str(), movie.info().nFrames);
+    }
+    else if(!strRecord.empty())
+    {
+        movie.record(CHIP_8, seed, haltConditions.commandsPerFrame, nChecksumInterval);
+        uint16_t keys = inputKeys(0, 0);
+        CHIP_8.set_keys(keys);
+        movie.input(keys);
+    }
+
+    // read keys from the terminal on a thread of its own
+    if(bKeyboard && !keyboard.start())
+        return EXIT_FAILURE;
+
+    // render sound to a WAV file and/or play it in real time
+    if(!strWav.empty() && !beeper.open_wav(strWav))
+        return EXIT_FAILURE;
+    if(!strAudioStream.empty())
+    {
+        signal(SIGPIPE, SIG_IGN); // a player quitting must not end emulation
+        if(!beeper.start_stream(strAudioStream))
+            return EXIT_FAILURE;
+    }
+    bSoundInFrame = CHIP_8.sound_timer() > 0;
+
+    // draw display into the terminal, paced to real time unless asked otherwise or paced by audio
+    if(nFps < 0)
+        nFps = (bDisplay || !strNetplay.empty()) && strAudioStream.empty() ? 60 : 0;
+    if(bDisplay && !terminal.open())
+        return EXIT_FAILURE;
+    nextFrame = std::chrono::steady_clock::now();
+
+    // stream frames to a file or pipe, written by a thread of its own
+    if(!strExport.empty())
+    {
+        signal(SIGPIPE, SIG_IGN); // an encoder quitting must not end emulation
+        exporter.reset(new chip8export(exportFormat, nExportEvery, nExportScale));
+        if(!exporter->open(strExport))
+            return EXIT_FAILURE;
+    }
+
+    // record display into an animated GIF
+    if(!strGif.empty())
+    {
+        gif.reset(new chip8gif(nGifScale, bGifDedup));
+        if(!gif->open(strGif))
+            return EXIT_FAILURE;
+    }
+
+    // count executions of each address if profiling
+    std::vector<uint64_t> hits;
+    if(bProfile)
+        hits.assign(4096, 0);
+    // stop emulation gracefully on Ctrl-C to print statistics and the profile and save the state
+    signal(SIGINT, onInterrupt);
+
+    // end emulation on halt conditions
+    // NOTE while the source is reloaded, new code may leave any loop, so loops don't end emulation then
+    if(bHotReload)
+        haltConditions.selfJump = haltConditions.steadyState = false;
+    // NOTE while keys are read or fed in, a programme polling them runs in a steady state till the next one is pressed
+    if(bKeyboard || !strNetplay.empty() || !strReplay.empty() || !keyScript.empty() || bRandomKeys)
+        haltConditions.steadyState = false;
+    chip8supervisor supervisor(CHIP_8, haltConditions);
+
+    // publish display, registers and counters for viewers once per frame
+    if(!strPublish.empty())
+    {
+        if(!shm.create(strPublish, strSource.empty() ? strFilename : strSource, CHIP_8, haltConditions.commandsPerFrame))
+            return EXIT_FAILURE;
+        shm.publish(CHIP_8, supervisor);
+    }
+
+    // play with a peer over UDP, frames are paced from when both are there
+    if(!strNetplay.empty())
+    {
+        if(!netplay.set_window(nNetplayWindow) || (!strImpairment.empty() && !netplay.set_impairment(strImpairment)) ||
+           !netplay.open(strNetplay))
+            return EXIT_FAILURE;
+        nLocalKeys = inputKeys(0, 0);
+        if(!netplay.start(CHIP_8, nLocalKeys, haltConditions.commandsPerFrame, nFps))
+            return EXIT_FAILURE;
+        nextFrame = std::chrono::steady_clock::now();
+    }
+
     // disassemble rom code
     printf("######## RUN EMULATION ########\n");
-    while(CHIP_8.is_running())
+    for(long nCommands = 0; ; ++nCommands)
     {
+        if(bInterrupted)
+        {
+            supervisor.interrupt();
+            break;
+        }
+
+        // patch in new code if source changed
+        if(bHotReload && nCommands % nReloadInterval == 0)
+            source->reload(CHIP_8);
+
         // fetch command
         int PC = CHIP_8.fetch_command();
+        if(!supervisor.before_exec(PC))
+            break;
+
+        if(bProfile)
+            hits[PC]++;
 
         if(bVerbose)
         {
+            if(debuginfo.is_open())
+                printf("\033[1;44m %s \033[0m\n", debuginfo.describe(PC).c_str());
             printf("\033[1;44m next command \033[0m ");
             CHIP_8.disassemble_command();
         }
 
         // execute command
-        if(CHIP_8.exec_command() < 0)
-        {
+        int result = CHIP_8.exec_command();
+        if(result < 0)
             fprintf(stderr, "ERROR: some command couldn't be executed. Emulation will be stopped.\n");
-            break;
-        }
 
         if(bVerbose)
         {
@@ -63,9 +305,207 @@ int main(int argc, char** argv)
             CHIP_8.print_registers();
             if(bStepMode) getchar();
         }
+
+        // park till a key is pressed instead of executing LD Vx, K over and over, s.t. a waiting emulator takes no CPU
+        // NOTE the timed wait lets Ctrl-C through, keys are taken over at the end of the frame as usual; while audio is
+        // streamed, its clock paces the frames of the wait instead, s.t. the stream keeps getting silence
+        // NOTE in netplay the peer's keys count as well, and it must not wait for this one
+        if(bKeyboard && strAudioStream.empty() && strNetplay.empty() && CHIP_8.waiting_for_key() &&
+           !CHIP_8.timers_running())
+        {
+            while(!keyboard.pending() && !bInterrupted)
+                keyboard.wait(std::chrono::milliseconds(100));
+        }
+
+        uint64_t frame = supervisor.frames;
+        bool bContinue = supervisor.after_exec(result);
+        // NOTE a frame ending together with emulation is still recorded, s.t. a replay stops at the same command
+        if(supervisor.frames != frame)
+            bContinue = endFrame(frame, CHIP_8, supervisor, movie) && bContinue;
+        if(!bContinue)
+            break;
+    }
+    // a replay ending before the movie does diverged from it, e.g. since it was recorded with other halt conditions
+    if(!strReplay.empty() && supervisor.exit_code() == 0 && supervisor.exit_reason() != chip8supervisor::END_OF_MOVIE &&
+       supervisor.frames < movie.info().nFrames)
+    {
+        printf("desync: frame=%llu reason=%s recorded=%u frames\n", (unsigned long long)supervisor.frames,
+               chip8supervisor::name(supervisor.exit_reason()), movie.info().nFrames);
+        supervisor.halt(chip8supervisor::DESYNC, true);
+    }
+    // end in the same state as the peer, i.e. with all of its keys
+    if(!strNetplay.empty() && !bInterrupted && !netplay.finish(CHIP_8))
+        supervisor.halt(netplay.desynced() ? chip8supervisor::DESYNC : chip8supervisor::ERROR);
+    if(bDisplay)
+    {
+        // show what the last, unfinished frame drew as well
+        terminal.present(CHIP_8.framebuffer(), CHIP_8.dirty_rows());
+        terminal.close();
+    }
+    supervisor.print(stdout);
+    if(!strPublish.empty())
+        shm.publish(CHIP_8, supervisor);
+    if(!strNetplay.empty())
+    {
+        netplay.close();
+        netplay.print(stdout);
+    }
+    if(bKeyboard)
+    {
+        keyboard.stop();
+        keyboard.print(stdout);
+    }
+    if(!strWav.empty() || !strAudioStream.empty())
+    {
+        beeper.close();
+        beeper.print(stdout);
+    }
+    if(bDisplay)
+        terminal.print(stdout);
+    if(exporter)
+    {
+        exporter->close();
+        exporter->print(stdout);
     }
+    if(gif)
+    {
+        if(!gif->close())
+            return EXIT_FAILURE;
+        gif->print(stdout);
+    }
+
+    if(!strRecord.empty())
+    {
+        if(!movie.write(strRecord))
+            return EXIT_FAILURE;
+        printf("record movie \"%s\" (%u frames)\n", strRecord.c_str(), movie.info().nFrames);
+    }
+
+    if(bProfile)
+        printProfile(hits, debuginfo);
 
-    return EXIT_SUCCESS;
+    if(!strSaveState.empty())
+    {
+        if(!chip8savestate::save(CHIP_8, strSaveState, bCompressState))
+            return EXIT_FAILURE;
+        printf("save state \"%s\"\n", strSaveState.c_str());
+    }
+
+    return supervisor.exit_code();
+}
+
+void onInterrupt(int)
+{
+    bInterrupted = 1;
+}
+
+uint16_t inputKeys(uint32_t frame, uint16_t keys)
+{
+    // keys of a frame, either from the terminal, a key script or random
+    if(bKeyboard)
+        keys = keyboard.keys();
+    else if(!keyScript.empty())
+    {
+        while(nNextKeyEvent < keyScript.size() && keyScript[nNextKeyEvent].frame <= frame)
+            keys = keyScript[nNextKeyEvent++].keys;
+    }
+    else if(bRandomKeys)
+    {
+        // xorshift32, keys change every 8th frame on average and are held meanwhile, s.t. games polling them see them
+        nKeyRng ^= nKeyRng << 13;
+        nKeyRng ^= nKeyRng >> 17;
+        nKeyRng ^= nKeyRng << 5;
+        if(nKeyRng % 8 == 0)
+            keys = (nKeyRng >> 8) % 3 ? 1 << ((nKeyRng >> 16) & 0xF) : 0;
+    }
+    return keys;
+}
+
+bool endFrame(uint32_t frame, chip8processor &chip8, chip8supervisor &supervisor, chip8movie &movie)
+{
+    // take the peer's keys, emulating again frames they were mispredicted for, before anything of the frame is shown
+    if(!strNetplay.empty())
+    {
+        nLocalKeys = inputKeys(frame + 1, nLocalKeys);
+        if(!netplay.end_frame(frame, chip8, nLocalKeys))
+        {
+            supervisor.halt(netplay.desynced() ? chip8supervisor::DESYNC : chip8supervisor::ERROR);
+            return false;
+        }
+    }
+
+    // the frame beeps if the sound timer ran at any time during it, even if it was set or ran out in between
+    if(!strWav.empty() || !strAudioStream.empty())
+        beeper.frame(bSoundInFrame || chip8.sound_timer() > 0);
+    bSoundInFrame = chip8.sound_timer() > 0;
+    if(bDisplay)
+        terminal.present(chip8.framebuffer(), netplay.rolled_back() ? 0xFFFFFFFF : supervisor.dirty_rows());
+    if(exporter)
+        exporter->frame(chip8.framebuffer());
+    if(gif)
+        gif->frame(chip8.framebuffer());
+    if(!strPublish.empty())
+        shm.publish(chip8, supervisor);
+
+    // wait for the frame's time to come, a late frame isn't caught up on, s.t. emulation never races afterwards
+    if(nFps > 0)
+    {
+        nextFrame += std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1.0 / nFps));
+        auto now = std::chrono::steady_clock::now();
+        if(nextFrame > now)
+            std::this_thread::sleep_until(nextFrame);
+        else
+            nextFrame = now;
+    }
+
+    if(!strReplay.empty())
+    {
+        // compare with the recorded state, then continue with the recorded keys
+        uint64_t hash;
+        if(movie.checksum(frame, hash) && chip8.state_hash() != hash)
+        {
+            printf("desync: frame=%u state=%016llx recorded=%016llx\n", frame,
+                   (unsigned long long)chip8.state_hash(), (unsigned long long)hash);
+            supervisor.halt(chip8supervisor::DESYNC);
+            return false;
+        }
+        if(frame + 1 >= movie.info().nFrames)
+        {
+            supervisor.halt(chip8supervisor::END_OF_MOVIE);
+            return false;
+        }
+        chip8.set_keys(movie.keys(frame + 1));
+    }
+    else if(strNetplay.empty() && (!strRecord.empty() || bKeyboard))
+    {
+        // NOTE keys only change between frames, even if read from the terminal, s.t. recorded runs replay exactly
+        if(!strRecord.empty())
+            movie.end_frame(chip8.state_hash());
+        uint16_t keys = inputKeys(frame + 1, chip8.get_keys());
+        chip8.set_keys(keys);
+        if(!strRecord.empty())
+            movie.input(keys);
+    }
+    return true;
+}
+
+void printProfile(const std::vector<uint64_t> &hits, const chip8debuginfo &debuginfo)
+{
+    // print most executed addresses, attributed to their source lines if debug info is given
+    const size_t nTop = 20;
+    std::vector<uint16_t> addrs;
+    uint64_t total = 0;
+    for(size_t a=0; a<hits.size(); ++a)
+    {
+        total += hits[a];
+        if(hits[a] > 0) addrs.push_back(a);
+    }
+    std::sort(addrs.begin(), addrs.end(), [&hits](uint16_t a, uint16_t b) { return hits[a] > hits[b]; });
+    printf("######## PROFILE ########\n");
+    printf("%llu commands executed\n", (unsigned long long)total);
+    for(size_t i=0; i<addrs.size() && i<nTop; ++i)
+        printf("0x%03x: %10llu %6.2f%%  %s\n", addrs[i], (unsigned long long)hits[addrs[i]], 100.0 * hits[addrs[i]] / total,
+               debuginfo.describe(addrs[i]).c_str());
 }
 
 bool parseArgs(int argc, char** argv)
@@ -94,6 +534,17 @@ bool parseArgs(int argc, char** argv)
             else
                 return false;
         }
+        // check for archive holding the rom
+        if(!std::strcmp(argv[i], "-x") || !std::strcmp(argv[i], "--archive"))
+        {
+            i++;
+            if(i < argc)
+            {
+                strArchive = argv[i];
+            }
+            else
+                return false;
+        }
         // check for memory map format
         if(!std::strcmp(argv[i], "-c") || !std::strcmp(argv[i], "--cols"))
         {
@@ -105,6 +556,349 @@ bool parseArgs(int argc, char** argv)
             else
                 return false;
         }
+        // check for source to assemble in memory
+        if(!std::strcmp(argv[i], "-a") || !std::strcmp(argv[i], "--asm"))
+        {
+            i++;
+            if(i < argc)
+            {
+                strSource = argv[i];
+            }
+            else
+                return false;
+        }
+        // check for hot reload of source
+        if(!std::strcmp(argv[i], "-r") || !std::strcmp(argv[i], "--reload"))
+        {
+            bHotReload = true;
+        }
+        // check for debug info
+        if(!std::strcmp(argv[i], "-g") || !std::strcmp(argv[i], "--debug"))
+        {
+            i++;
+            if(i < argc)
+            {
+                strDebuginfo = argv[i];
+            }
+            else
+                return false;
+        }
+        // check for profiler
+        if(!std::strcmp(argv[i], "-p") || !std::strcmp(argv[i], "--profile"))
+        {
+            bProfile = true;
+        }
+        // check for state to continue from
+        if(!std::strcmp(argv[i], "-L") || !std::strcmp(argv[i], "--load-state"))
+        {
+            i++;
+            if(i < argc)
+            {
+                strLoadState = argv[i];
+            }
+            else
+                return false;
+        }
+        // check for file to save state to when emulation stops
+        if(!std::strcmp(argv[i], "-S") || !std::strcmp(argv[i], "--save-state"))
+        {
+            i++;
+            if(i < argc)
+            {
+                strSaveState = argv[i];
+            }
+            else
+                return false;
+        }
+        // check for compression of saved state
+        if(!std::strcmp(argv[i], "-z") || !std::strcmp(argv[i], "--compress"))
+        {
+            bCompressState = true;
+        }
+        // check for command budget
+        if(!std::strcmp(argv[i], "-b") || !std::strcmp(argv[i], "--budget"))
+        {
+            i++;
+            if(i < argc)
+            {
+                haltConditions.maxCommands = strtoull(argv[i], nullptr, 10);
+            }
+            else
+                return false;
+        }
+        // check for address to stop at
+        if(!std::strcmp(argv[i], "-B") || !std::strcmp(argv[i], "--break"))
+        {
+            i++;
+            if(i < argc)
+            {
+                haltConditions.breakpoint = strtol(argv[i], nullptr, 16);
+            }
+            else
+                return false;
+        }
+        // check for number of frames without display change to stop after
+        if(!std::strcmp(argv[i], "-f") || !std::strcmp(argv[i], "--idle-frames"))
+        {
+            i++;
+            if(i < argc)
+            {
+                haltConditions.idleFrames = strtoull(argv[i], nullptr, 10);
+            }
+            else
+                return false;
+        }
+        // check for commands per frame
+        if(!std::strcmp(argv[i], "-I") || !std::strcmp(argv[i], "--ipf"))
+        {
+            i++;
+            if(i < argc)
+            {
+                haltConditions.commandsPerFrame = atoi(argv[i]);
+            }
+            else
+                return false;
+        }
+        // check for running on in loops
+        if(!std::strcmp(argv[i], "-n") || !std::strcmp(argv[i], "--no-loop-halt"))
+        {
+            haltConditions.selfJump = haltConditions.steadyState = false;
+        }
+        // check for seed of the random generator
+        if(!std::strcmp(argv[i], "-R") || !std::strcmp(argv[i], "--seed"))
+        {
+            i++;
+            if(i < argc)
+            {
+                bSeed = true;
+                nSeed = strtoul(argv[i], nullptr, 10);
+            }
+            else
+                return false;
+        }
+        // check for quirks profile
+        if(!std::strcmp(argv[i], "-q") || !std::strcmp(argv[i], "--quirks"))
+        {
+            i++;
+            if(i < argc)
+            {
+                if(!chip8quirks::parse(argv[i], nQuirks))
+                {
+                    fprintf(stderr, "ERROR: unknown quirks \"%s\", expected chip8, schip, xochip or a hex mask\n", argv[i]);
+                    return false;
+                }
+            }
+            else
+                return false;
+        }
+        // check for movie to record input to
+        if(!std::strcmp(argv[i], "-m") || !std::strcmp(argv[i], "--record"))
+        {
+            i++;
+            if(i < argc)
+            {
+                strRecord = argv[i];
+            }
+            else
+                return false;
+        }
+        // check for movie to replay
+        if(!std::strcmp(argv[i], "-M") || !std::strcmp(argv[i], "--replay"))
+        {
+            i++;
+            if(i < argc)
+            {
+                strReplay = argv[i];
+            }
+            else
+                return false;
+        }
+        // check for frames between two recorded checksums
+        if(!std::strcmp(argv[i], "-C") || !std::strcmp(argv[i], "--checksums"))
+        {
+            i++;
+            if(i < argc)
+            {
+                nChecksumInterval = strtoul(argv[i], nullptr, 10);
+            }
+            else
+                return false;
+        }
+        // check for key script to record
+        if(!std::strcmp(argv[i], "-k") || !std::strcmp(argv[i], "--keys"))
+        {
+            i++;
+            if(i < argc)
+            {
+                strKeyScript = argv[i];
+            }
+            else
+                return false;
+        }
+        // check for random keys to record
+        if(!std::strcmp(argv[i], "-K") || !std::strcmp(argv[i], "--random-keys"))
+        {
+            i++;
+            if(i < argc)
+            {
+                bRandomKeys = true;
+                nKeyRng = strtoul(argv[i], nullptr, 10);
+                if(!nKeyRng) nKeyRng = 1;
+            }
+            else
+                return false;
+        }
+        // check for WAV file to render sound to
+        if(!std::strcmp(argv[i], "-w") || !std::strcmp(argv[i], "--wav"))
+        {
+            i++;
+            if(i < argc)
+            {
+                strWav = argv[i];
+            }
+            else
+                return false;
+        }
+        // check for stream to play sound to in real time
+        if(!std::strcmp(argv[i], "-A") || !std::strcmp(argv[i], "--audio"))
+        {
+            i++;
+            if(i < argc)
+            {
+                strAudioStream = argv[i];
+            }
+            else
+                return false;
+        }
+        // check for display drawn into the terminal
+        if(!std::strcmp(argv[i], "-D") || !std::strcmp(argv[i], "--display"))
+        {
+            bDisplay = true;
+        }
+        // check for frames per second
+        if(!std::strcmp(argv[i], "-F") || !std::strcmp(argv[i], "--fps"))
+        {
+            i++;
+            if(i < argc)
+            {
+                nFps = atoi(argv[i]);
+            }
+            else
+                return false;
+        }
+        // check for file or pipe to export frames to
+        if(!std::strcmp(argv[i], "-o") || !std::strcmp(argv[i], "--export"))
+        {
+            i++;
+            if(i < argc)
+            {
+                strExport = argv[i];
+            }
+            else
+                return false;
+        }
+        // check for format of exported frames
+        if(!std::strcmp(argv[i], "-O") || !std::strcmp(argv[i], "--export-format"))
+        {
+            i++;
+            if(i < argc)
+            {
+                if(!chip8export::parse_format(argv[i], exportFormat, nExportScale))
+                {
+                    fprintf(stderr, "ERROR: unknown export format \"%s\"\n", argv[i]);
+                    return false;
+                }
+            }
+            else
+                return false;
+        }
+        // check for frames between two exported ones
+        if(!std::strcmp(argv[i], "-N") || !std::strcmp(argv[i], "--export-every"))
+        {
+            i++;
+            if(i < argc)
+            {
+                nExportEvery = strtoul(argv[i], nullptr, 10);
+            }
+            else
+                return false;
+        }
+        // check for GIF to record display to
+        if(!std::strcmp(argv[i], "-G") || !std::strcmp(argv[i], "--gif"))
+        {
+            i++;
+            if(i < argc)
+            {
+                strGif = argv[i];
+            }
+            else
+                return false;
+        }
+        // check for zoom of GIF
+        if(!std::strcmp(argv[i], "-Z") || !std::strcmp(argv[i], "--gif-scale"))
+        {
+            i++;
+            if(i < argc)
+            {
+                nGifScale = atoi(argv[i]);
+            }
+            else
+                return false;
+        }
+        // check for dropping duplicate frames from GIF
+        if(!std::strcmp(argv[i], "-U") || !std::strcmp(argv[i], "--gif-dedup"))
+        {
+            bGifDedup = true;
+        }
+        // check for shared memory to publish to
+        if(!std::strcmp(argv[i], "-P") || !std::strcmp(argv[i], "--publish"))
+        {
+            i++;
+            if(i < argc)
+            {
+                strPublish = argv[i];
+            }
+            else
+                return false;
+        }
+        // check for peer to play with
+        if(!std::strcmp(argv[i], "-l") || !std::strcmp(argv[i], "--netplay"))
+        {
+            i++;
+            if(i < argc)
+            {
+                strNetplay = argv[i];
+            }
+            else
+                return false;
+        }
+        // check for frames run ahead of the peer's keys
+        if(!std::strcmp(argv[i], "-W") || !std::strcmp(argv[i], "--rollback-window"))
+        {
+            i++;
+            if(i < argc)
+            {
+                nNetplayWindow = strtoul(argv[i], nullptr, 10);
+            }
+            else
+                return false;
+        }
+        // check for latency, jitter and loss injected into netplay
+        if(!std::strcmp(argv[i], "-j") || !std::strcmp(argv[i], "--impair"))
+        {
+            i++;
+            if(i < argc)
+            {
+                strImpairment = argv[i];
+            }
+            else
+                return false;
+        }
+        // check for keys read from the terminal
+        if(!std::strcmp(argv[i], "-t") || !std::strcmp(argv[i], "--terminal"))
+        {
+            bKeyboard = true;
+        }
         // check for step-by-step execution
         if(!std::strcmp(argv[i], "-s") || !std::strcmp(argv[i], "--step"))
         {
@@ -117,6 +911,57 @@ bool parseArgs(int argc, char** argv)
         }
     }
 
+    if(bHotReload && strSource.empty())
+    {
+        fprintf(stderr, "ERROR: hot reload requires a source file (-a)\n");
+        return false;
+    }
+
+    if(!strRecord.empty() && !strReplay.empty())
+    {
+        fprintf(stderr, "ERROR: a movie can either be recorded (-m) or replayed (-M)\n");
+        return false;
+    }
+    if((!strKeyScript.empty() || bRandomKeys) && strRecord.empty() && strNetplay.empty())
+    {
+        fprintf(stderr, "ERROR: keys (-k, -K) are only fed in when recording a movie (-m) or in netplay (-l)\n");
+        return false;
+    }
+    if(!strNetplay.empty() && (!strRecord.empty() || !strReplay.empty() || bHotReload || bStepMode ||
+       haltConditions.commandsPerFrame <= 0))
+    {
+        fprintf(stderr, "ERROR: netplay (-l) requires frames (-I) and excludes movies (-m, -M), hot reload and stepping\n");
+        return false;
+    }
+    if(strNetplay.empty() && !strImpairment.empty())
+    {
+        fprintf(stderr, "ERROR: impairment (-j) requires netplay (-l)\n");
+        return false;
+    }
+    if((!strRecord.empty() || bKeyboard || !strWav.empty() || !strAudioStream.empty()) &&
+       haltConditions.commandsPerFrame <= 0)
+    {
+        fprintf(stderr, "ERROR: recording a movie, reading keys and sound require frames (-I)\n");
+        return false;
+    }
+    if(bDisplay && (haltConditions.commandsPerFrame <= 0 || bVerbose))
+    {
+        fprintf(stderr, "ERROR: the display requires frames (-I) and no trace output (-v)\n");
+        return false;
+    }
+    if((!strExport.empty() || !strGif.empty() || !strPublish.empty()) && haltConditions.commandsPerFrame <= 0)
+    {
+        fprintf(stderr, "ERROR: exporting frames and GIFs and publishing require frames (-I)\n");
+        return false;
+    }
+    if(bKeyboard && (!strKeyScript.empty() || bRandomKeys || !strReplay.empty() || bStepMode))
+    {
+        fprintf(stderr, "ERROR: keys are read from the terminal (-t) only if there is no other input (-k, -K, -M, -s)\n");
+        return false;
+    }
+    if(!strKeyScript.empty() && !chip8movie::read_script(strKeyScript, keyScript))
+        return false;
+
     return true;
 }
 
@@ -127,6 +972,53 @@ void printUsage()
     printf("\nOptions:\n");
     printf("-h --help                                print usage\n");
     printf("-i --input PATH/TO/ROM                   set rom to disassemble\n");
+    printf("-x --archive PATH/TO/ARCHIVE             load rom given by -i from an archive written by chip8-pack\n");
     printf("-c --cols                                set columns of memory map\n");
     printf("-s --step                                enable step-by-step mode\n");
+    printf("-a --asm PATH/TO/SOURCE                  assemble source in memory and run it instead of a rom\n");
+    printf("-r --reload                              patch source into running emulation whenever it changes\n");
+    printf("-g --debug PATH/TO/ROM.dbg               attribute traced and profiled addresses to source lines\n");
+    printf("-p --profile                             count executions per address, printed when emulation stops (Ctrl-C)\n");
+    printf("-L --load-state PATH/TO/STATE            continue from a state saved for the same ROM\n");
+    printf("-S --save-state PATH/TO/STATE            save state when emulation stops\n");
+    printf("-z --compress                            compress saved state\n");
+    printf("-b --budget N                            stop after N commands\n");
+    printf("-B --break ADDR                          stop when PC reaches ADDR (hex)\n");
+    printf("-f --idle-frames N                       stop after N frames without display change\n");
+    printf("-I --ipf N                               commands per frame, timers count down once per frame (default: 10)\n");
+    printf("-n --no-loop-halt                        keep running in JP to itself and other infinite loops\n");
+    printf("-R --seed N                              seed random generator with N (default: time)\n");
+    printf("-q --quirks PROFILE                      chip8, schip, xochip or a hex mask of chip8quirks flags, taken over\n");
+    printf("                                         from states (-L) and movies (-M) (default: 10, clipping only)\n");
+    printf("-m --record PATH/TO/MOVIE                record keys per frame and state checksums to a movie\n");
+    printf("-k --keys PATH/TO/SCRIPT                 keys to record, lines of FRAME KEYS, e.g. \"120 5\", \"180 -\"\n");
+    printf("-K --random-keys SEED                    record random keys\n");
+    printf("-t --terminal                            read keys from the terminal, keypad 123C/456D/789E/A0BF is mapped to\n");
+    printf("                                         1234/qwer/asdf/zxcv, can be recorded by -m\n");
+    printf("-C --checksums N                         record a checksum every N frames, 0 for none (default: 1)\n");
+    printf("-M --replay PATH/TO/MOVIE                replay a movie at full speed, verifying its checksums\n");
+    printf("-w --wav PATH/TO/WAV                     render sound to a WAV file (44.1 kHz, 16 bit mono) as fast as emulation runs\n");
+    printf("-A --audio PATH                          play sound in real time as raw PCM into PATH, e.g. a FIFO read by\n");
+    printf("                                         \"aplay -f S16_LE -r 44100\", emulation is paced by it\n");
+    printf("-D --display                             draw display into the terminal by ANSI escape sequences\n");
+    printf("-F --fps N                               pace emulation to N frames per second, 0 for as fast as possible\n");
+    printf("                                         (default: 60 if the display is drawn and no audio is played, else 0)\n");
+    printf("-o --export PATH                         stream frames to a file or FIFO, or to file descriptor N by \"fd:N\"\n");
+    printf("-O --export-format FMT                   raw (1 bit packed, e.g. \"ffmpeg -f rawvideo -pix_fmt monob -s 64x32\"),\n");
+    printf("                                         ppm[:SCALE] (\"ffmpeg -f image2pipe -c:v ppm\") or rle (XOR delta to\n");
+    printf("                                         the frame before, see chip8export.h) (default: raw)\n");
+    printf("-N --export-every N                      export every Nth frame only (default: 1)\n");
+    printf("-G --gif PATH/TO/GIF                     record display into an animated GIF at emulation speed\n");
+    printf("-Z --gif-scale N                         zoom of the GIF (default: 4)\n");
+    printf("-U --gif-dedup                           drop frames equal to the one before from the GIF, showing it longer\n");
+    printf("-P --publish NAME                        publish display, registers and counters once per frame to shared\n");
+    printf("                                         memory /dev/shm/NAME, watched by \"chip8-viewer -n NAME\"\n");
+    printf("-l --netplay LOCALPORT:HOST:PORT         play with a peer over UDP, both press keys of the same keypad; its keys\n");
+    printf("                                         are predicted and mispredicted frames emulated again once they arrive\n");
+    printf("                                         (rollback), both must run the same ROM and seed (-R), paced to 60 fps\n");
+    printf("-W --rollback-window N                   frames run ahead of the peer's keys before waiting for them (default: 8)\n");
+    printf("-j --impair LATENCY[:JITTER[:LOSS]]      delay packets sent by LATENCY +-JITTER ms and drop LOSS percent of them\n");
+    printf("\nEmulation ends with a line \"exit: reason=... \" and statistics. Exit status is 0 if the programme ended by\n");
+    printf("itself (self-jump, steady-state, idle-display, breakpoint, end-of-movie), 1 on errors, 2 if the budget is\n");
+    printf("exhausted, 3 if interrupted and 4 if a replay diverged from the movie, reported by \"desync: frame=...\".\n");
 }
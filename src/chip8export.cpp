@@ -0,0 +1,243 @@
+#include "chip8export.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+static uint8_t* putVarint(uint8_t *out, uint32_t v)
+{
+    for(; v >= 0x80; v >>= 7)
+        *out++ = uint8_t(v) | 0x80;
+    *out++ = uint8_t(v);
+    return out;
+}
+
+chip8export::chip8export(format fmt, uint32_t every, int scale, size_t bufferSize)
+    : fmt{fmt}, every{std::max(every, 1u)}, scale{fmt == PPM ? std::max(scale, 1) : 1}, previous{}, fd{-1}, fill{0},
+      used{0}, pending{0}, closing{false}, failed{false}, frames{0}, exported{0}, bytes{0}, batches{0}, stalls{0},
+      stallSeconds{0}
+{
+    // NOTE an RLE pair takes at most 4 bytes besides its XOR bytes, and pairs are at least 3 bytes of the frame apart
+    if(fmt == RAW)
+        frameMax = 256;
+    else if(fmt == PPM)
+        frameMax = 32 + size_t(64 * this->scale) * 32 * this->scale * 3;
+    else
+        frameMax = 3 * 256 + 3;
+    for(std::vector<uint8_t> &b : buffers)
+        b.resize(std::max(bufferSize, 2 * frameMax));
+}
+
+chip8export::~chip8export()
+{
+    close();
+}
+
+bool chip8export::parse_format(const char *str, format &fmt, int &scale)
+{
+    if(!std::strcmp(str, "raw"))
+        fmt = RAW;
+    else if(!std::strcmp(str, "rle"))
+        fmt = RLE;
+    else if(!std::strncmp(str, "ppm", 3) && (!str[3] || str[3] == ':'))
+    {
+        fmt = PPM;
+        scale = str[3] ? atoi(str + 4) : 1;
+        if(scale < 1)
+            return false;
+    }
+    else
+        return false;
+    return true;
+}
+
+const char* chip8export::name(format f)
+{
+    static const char *names[] = {"raw", "ppm", "rle"};
+    return names[f];
+}
+
+bool chip8export::open(const std::string &path)
+{
+    this->path = path;
+    if(!path.compare(0, 3, "fd:"))
+        fd = atoi(path.c_str() + 3);
+    else
+        fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(fd < 0 || fcntl(fd, F_GETFD) < 0)
+    {
+        fprintf(stderr, "ERROR: couldn't open export \"%s\"\n", path.c_str());
+        fd = -1;
+        return false;
+    }
+    if(fmt == RLE)
+    {
+        static const uint8_t header[] = {'C', '8', 'R', 'L', 1};
+        std::memcpy(buffers[fill].data(), header, sizeof(header));
+        used = sizeof(header);
+    }
+    lastHandOff = std::chrono::steady_clock::now();
+    thread = std::thread(&chip8export::writer, this);
+    return true;
+}
+
+void chip8export::close()
+{
+    if(!thread.joinable())
+        return;
+    handOff(true);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        closing = true;
+    }
+    cv.notify_all();
+    thread.join();
+    if(::close(fd) < 0 && !failed)
+        fprintf(stderr, "ERROR: couldn't write export \"%s\"\n", path.c_str());
+    fd = -1;
+}
+
+void chip8export::frame(const uint64_t *framebuffer)
+{
+    if(frames++ % every || failed)
+        return;
+
+    uint8_t *out = buffers[fill].data() + used;
+    if(fmt == RAW)
+    {
+        encodeRaw(framebuffer, out);
+        used += 256;
+    }
+    else if(fmt == PPM)
+        used += encodePPM(framebuffer, out);
+    else
+        used += encodeRLE(framebuffer, out);
+    ++exported;
+
+    // hand the buffer on before the next frame may not fit anymore, or if a reader waits for it too long already
+    // NOTE a buffer waiting for the latency is only handed on if the writer is idle, s.t. this never stalls
+    if(used + frameMax > buffers[fill].size())
+        handOff(true);
+    else if(exported % 64 == 0 && std::chrono::steady_clock::now() - lastHandOff >= maxLatency)
+        handOff(false);
+}
+
+void chip8export::handOff(bool wait)
+{
+    if(!used)
+        return;
+    std::unique_lock<std::mutex> lock(mutex);
+    if(pending)
+    {
+        if(!wait)
+            return;
+        auto start = std::chrono::steady_clock::now();
+        cv.wait(lock, [this] { return !pending; });
+        ++stalls;
+        stallSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+    pending = used;
+    fill ^= 1;
+    used = 0;
+    ++batches;
+    bytes += pending;
+    lastHandOff = std::chrono::steady_clock::now();
+    lock.unlock();
+    cv.notify_all();
+}
+
+void chip8export::writer()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    for(;;)
+    {
+        cv.wait(lock, [this] { return pending || closing; });
+        if(!pending)
+            break;
+        // NOTE the producer only touches the other buffer and waits for pending to drop, so this one is written unlocked
+        const uint8_t *data = buffers[fill ^ 1].data();
+        size_t n = pending;
+        lock.unlock();
+        for(size_t done = 0; done < n && !failed; )
+        {
+            ssize_t w = write(fd, data + done, n - done);
+            if(w < 0 && errno != EINTR)
+            {
+                fprintf(stderr, "ERROR: export \"%s\" closed\n", path.c_str());
+                failed = true;
+            }
+            if(w > 0) done += w;
+        }
+        lock.lock();
+        pending = 0;
+        cv.notify_all();
+    }
+}
+
+void chip8export::encodeRaw(const uint64_t *framebuffer, uint8_t *out)
+{
+    for(int row = 0; row < 32; ++row)
+        for(int b = 0; b < 8; ++b)
+            *out++ = uint8_t(framebuffer[row] >> (56 - 8 * b));
+}
+
+size_t chip8export::encodePPM(const uint64_t *framebuffer, uint8_t *out)
+{
+    int n = sprintf(reinterpret_cast<char*>(out), "P6\n%d %d\n255\n", 64 * scale, 32 * scale);
+    uint8_t *dst = out + n;
+    size_t lineSize = size_t(64 * scale) * 3;
+    for(int row = 0; row < 32; ++row)
+    {
+        // zoom the row into one line, which is repeated for the other lines of the row
+        uint8_t *line = dst;
+        for(int p = 0; p < 64; ++p, dst += 3 * scale)
+            std::memset(dst, (framebuffer[row] >> (63 - p)) & 1 ? 0xFF : 0, 3 * scale);
+        for(int y = 1; y < scale; ++y, dst += lineSize)
+            std::memcpy(dst, line, lineSize);
+    }
+    return dst - out;
+}
+
+size_t chip8export::encodeRLE(const uint64_t *framebuffer, uint8_t *out)
+{
+    uint8_t current[256], delta[256];
+    encodeRaw(framebuffer, current);
+    for(int i = 0; i < 256; ++i)
+        delta[i] = current[i] ^ previous[i];
+    std::memcpy(previous, current, sizeof(previous));
+
+    uint8_t *dst = out;
+    for(int i = 0; i < 256; )
+    {
+        int start = i;
+        while(i < 256 && !delta[i])
+            ++i;
+        int skip = i - start;
+        // a literal swallows gaps of up to 2 unchanged bytes, which are cheaper to repeat than to start another pair
+        int end = i;
+        while(end < 256)
+        {
+            int next = end;
+            while(next < 256 && !delta[next] && next - end < 2)
+                ++next;
+            if(next == 256 || !delta[next])
+                break;
+            end = next + 1;
+        }
+        dst = putVarint(dst, skip);
+        dst = putVarint(dst, end - i);
+        std::memcpy(dst, delta + i, end - i);
+        dst += end - i;
+        i = end;
+    }
+    return dst - out;
+}
+
+void chip8export::print(FILE *out) const
+{
+    fprintf(out, "export: format=%s frames=%llu exported=%llu bytes=%llu batches=%llu stalls=%llu stall_time=%.3fs\n",
+            name(fmt), (unsigned long long)frames, (unsigned long long)exported, (unsigned long long)bytes,
+            (unsigned long long)batches, (unsigned long long)stalls, stallSeconds);
+}
@@ -0,0 +1,203 @@
+#include "chip8gif.h"
+#include <algorithm>
+#include <cstring>
+
+// codes of the LZW stream, pixels are codes 0 and 1 of a minimum code size of 2, which GIF requires at least
+static const int MIN_CODE_SIZE = 2;
+static const uint32_t CLEAR = 1 << MIN_CODE_SIZE;
+static const uint32_t END = CLEAR + 1;
+
+chip8gif::chip8gif(int scale, bool dedup, uint32_t on, uint32_t off)
+    : scale{std::max(1, scale)}, dedup{dedup}, palette{uint8_t(off >> 16), uint8_t(off >> 8), uint8_t(off),
+      uint8_t(on >> 16), uint8_t(on >> 8), uint8_t(on)}, file{nullptr}, ok{false}, canvas{}, pending{},
+      hasPending{false}, start{0}, frames{0}, bits{0}, nBits{0}, codeSize{0}, blockSize{0}, written{0}, dropped{0},
+      bytes{0}
+{
+}
+
+chip8gif::~chip8gif()
+{
+    close();
+}
+
+bool chip8gif::open(const std::string &path)
+{
+    file = fopen(path.c_str(), "wb");
+    if(!file)
+    {
+        fprintf(stderr, "ERROR: couldn't write GIF file \"%s\"\n", path.c_str());
+        return false;
+    }
+    this->path = path;
+    ok = true;
+
+    // header and logical screen with the global palette of 2 colors, then the NETSCAPE extension to loop forever
+    uint16_t width = 64 * scale, height = 32 * scale;
+    uint8_t header[13] = {'G', 'I', 'F', '8', '9', 'a', uint8_t(width), uint8_t(width >> 8), uint8_t(height),
+                          uint8_t(height >> 8), 0x80, 0, 0};
+    static const uint8_t loop[19] = {0x21, 0xFF, 11, 'N', 'E', 'T', 'S', 'C', 'A', 'P', 'E', '2', '.', '0', 3, 1, 0, 0,
+                                     0};
+    ok = fwrite(header, sizeof(header), 1, file) == 1 && fwrite(palette, sizeof(palette), 1, file) == 1 &&
+         fwrite(loop, sizeof(loop), 1, file) == 1;
+    bytes = sizeof(header) + sizeof(palette) + sizeof(loop);
+    return true;
+}
+
+bool chip8gif::close()
+{
+    if(!file)
+        return true;
+    if(hasPending)
+        writeFrame(frames);
+    hasPending = false;
+    ok = fputc(0x3B, file) != EOF && ok;
+    ok = fclose(file) == 0 && ok;
+    ++bytes;
+    file = nullptr;
+    if(!ok)
+        fprintf(stderr, "ERROR: couldn't write GIF file \"%s\"\n", path.c_str());
+    return ok;
+}
+
+void chip8gif::frame(const uint64_t *framebuffer)
+{
+    if(!file)
+        return;
+    uint32_t f = frames++;
+    if(hasPending)
+    {
+        if(dedup && !std::memcmp(pending, framebuffer, sizeof(pending)))
+        {
+            ++dropped;
+            return;
+        }
+        // NOTE times are rounded to 1/100 s from the start of the run, s.t. rounding errors don't add up
+        if(f * 100 / FRAME_RATE - start * 100 / FRAME_RATE < 2)
+        {
+            std::memcpy(pending, framebuffer, sizeof(pending));
+            ++dropped;
+            return;
+        }
+        writeFrame(f);
+    }
+    std::memcpy(pending, framebuffer, sizeof(pending));
+    start = f;
+    hasPending = true;
+}
+
+void chip8gif::writeFrame(uint32_t end)
+{
+    uint32_t delay = std::max(2u, end * 100 / FRAME_RATE - start * 100 / FRAME_RATE);
+
+    // rectangle of pixels changed, the first frame covers the screen, s.t. no player shows anything else behind it
+    // NOTE a frame without changes still takes a pixel, since it is only written if duplicates are kept
+    int top = -1, bottom = 0, left = 0, right = 0;
+    uint64_t cols = 0;
+    for(int row = 0; row < 32; ++row)
+    {
+        uint64_t changed = written ? canvas[row] ^ pending[row] : ~0ull;
+        if(changed)
+        {
+            if(top < 0) top = row;
+            bottom = row;
+            cols |= changed;
+        }
+    }
+    if(top < 0)
+        top = 0;
+    else
+    {
+        left = __builtin_clzll(cols);
+        right = 63 - __builtin_ctzll(cols);
+    }
+    uint16_t x = left * scale, y = top * scale, w = (right - left + 1) * scale, h = (bottom - top + 1) * scale;
+
+    // graphic control extension to draw the frame over the one before for delay, then the image descriptor
+    uint8_t descriptor[19] = {0x21, 0xF9, 4, 1 << 2, uint8_t(delay), uint8_t(delay >> 8), 0, 0,
+                              0x2C, uint8_t(x), uint8_t(x >> 8), uint8_t(y), uint8_t(y >> 8), uint8_t(w), uint8_t(w >> 8),
+                              uint8_t(h), uint8_t(h >> 8), 0, MIN_CODE_SIZE};
+    ok = fwrite(descriptor, sizeof(descriptor), 1, file) == 1 && ok;
+    bytes += sizeof(descriptor);
+
+    // LZW: the longest string of pixels in the dictionary is written as its code and is added to it followed by the
+    // next pixel, once all codes are taken, the dictionary starts over
+    std::memset(next, 0, sizeof(next));
+    codeSize = MIN_CODE_SIZE + 1;
+    uint32_t maxCode = END;
+    bits = nBits = blockSize = 0;
+    writeCode(CLEAR);
+    int cur = -1;
+    for(int py = 0; py < h; ++py)
+    {
+        uint64_t row = pending[top + py / scale];
+        for(int px = 0; px < w; ++px)
+        {
+            int pixel = (row >> (63 - left - px / scale)) & 1;
+            if(cur < 0)
+                cur = pixel;
+            else if(next[cur][pixel])
+                cur = next[cur][pixel];
+            else
+            {
+                writeCode(cur);
+                next[cur][pixel] = ++maxCode;
+                if(maxCode >= (1u << codeSize))
+                    ++codeSize;
+                if(maxCode == 4095)
+                {
+                    writeCode(CLEAR);
+                    std::memset(next, 0, sizeof(next));
+                    codeSize = MIN_CODE_SIZE + 1;
+                    maxCode = END;
+                }
+                cur = pixel;
+            }
+        }
+    }
+    writeCode(cur);
+    // NOTE the decoder adds a code on reading the last one, which may widen the end code like any other
+    if(maxCode + 1 >= (1u << codeSize) && codeSize < 12)
+        ++codeSize;
+    writeCode(END);
+    if(nBits > 0)
+    {
+        block[blockSize++] = uint8_t(bits);
+        nBits = 0;
+    }
+    flushBlock();
+    ok = fputc(0, file) != EOF && ok;
+    ++bytes;
+
+    std::memcpy(canvas, pending, sizeof(canvas));
+    ++written;
+}
+
+void chip8gif::writeCode(uint32_t code)
+{
+    // codes are packed from the lowest bit on into sub-blocks of up to 255 bytes
+    bits |= code << nBits;
+    nBits += codeSize;
+    while(nBits >= 8)
+    {
+        block[blockSize++] = uint8_t(bits);
+        bits >>= 8;
+        nBits -= 8;
+        if(blockSize == 255)
+            flushBlock();
+    }
+}
+
+void chip8gif::flushBlock()
+{
+    if(!blockSize)
+        return;
+    ok = fputc(blockSize, file) != EOF && fwrite(block, blockSize, 1, file) == 1 && ok;
+    bytes += 1 + blockSize;
+    blockSize = 0;
+}
+
+void chip8gif::print(FILE *out) const
+{
+    fprintf(out, "gif: frames=%u written=%llu dropped=%llu bytes=%llu\n", frames, (unsigned long long)written,
+            (unsigned long long)dropped, (unsigned long long)bytes);
+}
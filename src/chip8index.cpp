@@ -0,0 +1,349 @@
+#include "chip8decoder.h"
+#include "chip8quirks.h"
+#include "chip8romindex.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+/* function prototypes */
+bool parseArgs(int argc, char** argv);
+void printUsage();
+void printList(const chip8romindex &index, const std::vector<const chip8romindex::rom*> &roms);
+void printRom(const chip8romindex &index, const chip8romindex::rom &r);
+const chip8romindex::rom* findRom(const chip8romindex &index, const std::string &name);
+
+/* globals */
+std::string strIndex = "roms.idx";
+std::vector<std::string> scan_dirs;
+int nThreads = 0;
+bool bList = false;
+std::string strOpcode;
+std::string strExtension;
+std::string strSubroutine;
+std::string strSameAs;
+std::string strRom;
+
+int main(int argc, char** argv)
+{
+    // read in args from command line
+    if(!parseArgs(argc, argv))
+        return EXIT_FAILURE;
+
+    // (re-)scan ROM library, files which didn't change since the last scan are taken over from the old index
+    if(!scan_dirs.empty())
+    {
+        std::vector<std::string> files;
+        for(const std::string &dir : scan_dirs)
+        {
+            std::error_code ec;
+            for(const auto &entry : std::filesystem::recursive_directory_iterator(dir, ec))
+                if(entry.is_regular_file())
+                    files.push_back(entry.path().string());
+            if(ec)
+            {
+                fprintf(stderr, "ERROR: couldn't read directory \"%s\"\n", dir.c_str());
+                return EXIT_FAILURE;
+            }
+        }
+
+        auto t0 = std::chrono::steady_clock::now();
+        chip8romindex previous;
+        previous.open(strIndex, false);
+        chip8romindex::builder builder(nThreads);
+        builder.scan(files, &previous);
+        previous.close();
+        if(!builder.write(strIndex))
+        {
+            fprintf(stderr, "ERROR: couldn't write index \"%s\"\n", strIndex.c_str());
+            return EXIT_FAILURE;
+        }
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+        fprintf(stderr, "%s", builder.errors.c_str());
+        printf("indexed %zu ROMs into %s in %.1f ms: %zu scanned, %zu unchanged, %zu failed\n",
+               builder.nScanned + builder.nReused, strIndex.c_str(), ms, builder.nScanned, builder.nReused,
+               builder.nFailed);
+    }
+
+    // all queries run on the mapped index
+    bool bQuery = bList || !strOpcode.empty() || !strExtension.empty() || !strSubroutine.empty() ||
+                  !strSameAs.empty() || !strRom.empty();
+    if(!bQuery)
+        return EXIT_SUCCESS;
+    chip8romindex index;
+    if(!index.open(strIndex))
+        return EXIT_FAILURE;
+
+    if(bList)
+    {
+        std::vector<const chip8romindex::rom*> all;
+        for(uint32_t i=0; i<index.size(); ++i)
+            all.push_back(&index.at(i));
+        printList(index, all);
+    }
+    if(!strOpcode.empty())
+    {
+        uint16_t mask, value;
+        if(!parseOpcodePattern(strOpcode, mask, value))
+        {
+            fprintf(stderr, "ERROR: invalid opcode pattern \"%s\", expected 4 chars like Fx75\n", strOpcode.c_str());
+            return EXIT_FAILURE;
+        }
+        printList(index, index.usingOpcode(mask, value));
+    }
+    if(!strExtension.empty())
+    {
+        // select all extensions of the platform
+        bool xochip = strExtension == "xochip";
+        if(!xochip && strExtension != "schip")
+        {
+            fprintf(stderr, "ERROR: unknown extension \"%s\", expected schip or xochip\n", strExtension.c_str());
+            return EXIT_FAILURE;
+        }
+        uint32_t mask = 0;
+        for(int e = 1; e < chip8decoder::NUM_EXTENSIONS; ++e)
+            if(chip8decoder::isXOCHIP(chip8decoder::extension(e)) == xochip)
+                mask |= 1u << e;
+        printList(index, index.usingExtensions(mask));
+    }
+    if(!strSubroutine.empty())
+    {
+        printList(index, index.withSubroutine(std::strtoull(strSubroutine.c_str(), nullptr, 16)));
+    }
+    if(!strSameAs.empty())
+    {
+        // look up pattern of the subroutine at ROM:ADDR and find all ROMs containing it as well
+        size_t colon = strSameAs.rfind(':');
+        if(colon == std::string::npos)
+        {
+            fprintf(stderr, "ERROR: expected ROM:ADDR, got \"%s\"\n", strSameAs.c_str());
+            return EXIT_FAILURE;
+        }
+        const chip8romindex::rom *r = findRom(index, strSameAs.substr(0, colon));
+        if(!r)
+            return EXIT_FAILURE;
+        uint16_t addr = std::strtoul(strSameAs.c_str() + colon + 1, nullptr, 16);
+        const chip8romindex::subroutine *s = index.subroutines(*r);
+        const chip8romindex::subroutine *end = s + r->nSubroutines;
+        s = std::find_if(s, end, [=](const chip8romindex::subroutine &x) { return x.addr == addr; });
+        if(s == end)
+        {
+            fprintf(stderr, "ERROR: there is no subroutine at 0x%03x in \"%s\"\n", addr, index.name(*r));
+            return EXIT_FAILURE;
+        }
+        printf("subroutine %016llx (%u commands)\n", (unsigned long long)s->pattern, s->length);
+        printList(index, index.withSubroutine(s->pattern));
+    }
+    if(!strRom.empty())
+    {
+        const chip8romindex::rom *r = findRom(index, strRom);
+        if(!r)
+            return EXIT_FAILURE;
+        printRom(index, *r);
+    }
+
+    return EXIT_SUCCESS;
+}
+
+const chip8romindex::rom* findRom(const chip8romindex &index, const std::string &name)
+{
+    // ROMs are named by the paths they were scanned from, a file name alone matches too if no other ROM has it
+    const chip8romindex::rom *r = index.find(name);
+    if(r)
+        return r;
+    size_t matches = 0;
+    for(uint32_t i=0; i<index.size(); ++i)
+    {
+        const char *path = index.name(index.at(i));
+        const char *slash = std::strrchr(path, '/');
+        if(name == (slash ? slash + 1 : path) && !matches++)
+            r = &index.at(i);
+    }
+    if(matches > 1)
+    {
+        fprintf(stderr, "ERROR: %zu ROMs in the index are named \"%s\", give the path of one\n", matches, name.c_str());
+        return nullptr;
+    }
+    if(!r)
+        fprintf(stderr, "ERROR: \"%s\" is not in the index\n", name.c_str());
+    return r;
+}
+
+void printList(const chip8romindex &index, const std::vector<const chip8romindex::rom*> &roms)
+{
+    for(const chip8romindex::rom *r : roms)
+        printf("%016llx %6u %-7s %s\n", (unsigned long long)r->hash, r->size, chip8quirks::name(r->quirks),
+               index.name(*r));
+    printf("%zu ROMs\n", roms.size());
+}
+
+void printRom(const chip8romindex &index, const chip8romindex::rom &r)
+{
+    printf("######## %s ########\n", index.name(r));
+    printf("hash:        %016llx\n", (unsigned long long)r.hash);
+    printf("size:        %u bytes, %u code, %u data\n", r.size, r.codeBytes, r.dataBytes);
+    printf("quirks:      %s (0x%02x)\n", chip8quirks::name(r.quirks), r.quirks);
+    printf("extensions: ");
+    for(int e = 1; e < chip8decoder::NUM_EXTENSIONS; ++e)
+        if(r.extensions >> e & 1)
+            printf(" [%s]", chip8decoder::extensionNames[e]);
+    printf(r.extensions ? "\n" : " none\n");
+    printf("opcodes:     %u distinct\n", r.nWords);
+
+    // histogram sorted by count
+    std::vector<int> kinds;
+    for(int k = 0; k < chip8decoder::NUM_KINDS; ++k)
+        if(r.histogram[k])
+            kinds.push_back(k);
+    std::stable_sort(kinds.begin(), kinds.end(), [&](int a, int b) { return r.histogram[a] > r.histogram[b]; });
+    for(int k : kinds)
+        printf("  %5u  %s\n", r.histogram[k], chip8decoder::formats[k]);
+
+    printf("subroutines: %u\n", r.nSubroutines);
+    const chip8romindex::subroutine *s = index.subroutines(r);
+    for(uint32_t i=0; i<r.nSubroutines; ++i)
+        printf("  0x%03x  %016llx  %3u commands\n", s[i].addr, (unsigned long long)s[i].pattern, s[i].length);
+}
+
+bool parseArgs(int argc, char** argv)
+{
+    // if no arg is passed there is nothing to do
+    if(argc == 1)
+    {
+        printUsage();
+        return false;
+    }
+
+    // parse commandline arguments
+    for (int i = 1; i < argc; ++i)
+    {
+        // print usage on demand
+        if(!std::strcmp(argv[i], "-h") || !std::strcmp(argv[i], "--help"))
+        {
+            printUsage();
+            return false;
+        }
+        // check for index file
+        else if(!std::strcmp(argv[i], "-X") || !std::strcmp(argv[i], "--index"))
+        {
+            i++;
+            if(i < argc)
+            {
+                strIndex = argv[i];
+            }
+            else
+                return false;
+        }
+        // check for directories to scan
+        else if(!std::strcmp(argv[i], "-d") || !std::strcmp(argv[i], "--dir"))
+        {
+            i++;
+            if(i < argc)
+            {
+                scan_dirs.push_back(argv[i]);
+            }
+            else
+                return false;
+        }
+        // check for number of threads used for scanning
+        else if(!std::strcmp(argv[i], "-j") || !std::strcmp(argv[i], "--jobs"))
+        {
+            i++;
+            if(i < argc)
+            {
+                nThreads = atoi(argv[i]);
+            }
+            else
+                return false;
+        }
+        // check for listing the complete index
+        else if(!std::strcmp(argv[i], "-l") || !std::strcmp(argv[i], "--list"))
+        {
+            bList = true;
+        }
+        // check for opcode pattern
+        else if(!std::strcmp(argv[i], "-p") || !std::strcmp(argv[i], "--opcode"))
+        {
+            i++;
+            if(i < argc)
+            {
+                strOpcode = argv[i];
+            }
+            else
+                return false;
+        }
+        // check for extension
+        else if(!std::strcmp(argv[i], "-e") || !std::strcmp(argv[i], "--extension"))
+        {
+            i++;
+            if(i < argc)
+            {
+                strExtension = argv[i];
+            }
+            else
+                return false;
+        }
+        // check for subroutine pattern
+        else if(!std::strcmp(argv[i], "-s") || !std::strcmp(argv[i], "--subroutine"))
+        {
+            i++;
+            if(i < argc)
+            {
+                strSubroutine = argv[i];
+            }
+            else
+                return false;
+        }
+        // check for subroutine of a ROM
+        else if(!std::strcmp(argv[i], "-c") || !std::strcmp(argv[i], "--same"))
+        {
+            i++;
+            if(i < argc)
+            {
+                strSameAs = argv[i];
+            }
+            else
+                return false;
+        }
+        // check for ROM to describe
+        else if(!std::strcmp(argv[i], "-r") || !std::strcmp(argv[i], "--rom"))
+        {
+            i++;
+            if(i < argc)
+            {
+                strRom = argv[i];
+            }
+            else
+                return false;
+        }
+        else
+        {
+            fprintf(stderr, "ERROR: unknown option \"%s\"\n", argv[i]);
+            printUsage();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void printUsage()
+{
+    printf( "Usage: chip8index [OPTION]...\n");
+    printf( "Builds a cross reference index over a ROM library and queries it.\n");
+    printf( "\nOptions:\n");
+    printf( "-h --help                                print usage\n");
+    printf( "-X --index PATH/TO/INDEX                 set index file (default: roms.idx)\n");
+    printf( "-d --dir DIR                             scan all ROMs in DIR and update the index, unchanged files are not scanned again\n");
+    printf( "-j --jobs N                              number of threads used for scanning (default: one per core)\n");
+    printf( "-l --list                                list all ROMs in the index\n");
+    printf( "-p --opcode PATTERN                      list ROMs using an opcode, hex digits must match, other chars are wildcards (e.g. Fx75)\n");
+    printf( "-e --extension schip|xochip              list ROMs using extensions of SCHIP or XO-CHIP\n");
+    printf( "-s --subroutine HASH                     list ROMs containing the subroutine pattern HASH\n");
+    printf( "-c --same ROM:ADDR                       list ROMs containing the subroutine at ADDR (hex) of ROM\n");
+    printf( "-r --rom ROM                             print hash, quirks, extensions, opcode histogram and subroutines of ROM\n");
+    printf( "\nROM is the path a ROM was scanned from or, if unique in the index, its file name.\n");
+}
@@ -0,0 +1,147 @@
+#include "chip8input.h"
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <poll.h>
+#include <unistd.h>
+
+// keypad key of each character, -1 if it isn't mapped
+static int keyOf(char c)
+{
+    switch(tolower(c))
+    {
+    case '1': return 0x1; case '2': return 0x2; case '3': return 0x3; case '4': return 0xC;
+    case 'q': return 0x4; case 'w': return 0x5; case 'e': return 0x6; case 'r': return 0xD;
+    case 'a': return 0x7; case 's': return 0x8; case 'd': return 0x9; case 'f': return 0xE;
+    case 'z': return 0xA; case 'x': return 0x0; case 'c': return 0xB; case 'v': return 0xF;
+    default: return -1;
+    }
+}
+
+chip8input::chip8input()
+    : wakeup{-1, -1}, rawMode{false}, savedMode{}, parked{false}, lastPress{}, presses{0}, dropped{0}, latencySum{0},
+      latencyMax{0}
+{
+}
+
+chip8input::~chip8input()
+{
+    stop();
+}
+
+bool chip8input::start()
+{
+    if(!isatty(STDIN_FILENO) || tcgetattr(STDIN_FILENO, &savedMode) != 0)
+    {
+        fprintf(stderr, "ERROR: keyboard input requires stdin to be a terminal\n");
+        return false;
+    }
+    // raw mode: every key is read as soon as it is pressed and not echoed
+    // NOTE signals stay enabled, s.t. Ctrl-C still stops emulation gracefully
+    struct termios raw = savedMode;
+    raw.c_lflag &= ~(ICANON | ECHO);
+    raw.c_cc[VMIN] = 1;
+    raw.c_cc[VTIME] = 0;
+    if(tcsetattr(STDIN_FILENO, TCSANOW, &raw) != 0 || pipe(wakeup) != 0)
+    {
+        fprintf(stderr, "ERROR: couldn't put terminal into raw mode\n");
+        tcsetattr(STDIN_FILENO, TCSANOW, &savedMode);
+        return false;
+    }
+    rawMode = true;
+    thread = std::thread(&chip8input::reader, this);
+    return true;
+}
+
+void chip8input::stop()
+{
+    if(thread.joinable())
+    {
+        char c = 0;
+        if(write(wakeup[1], &c, 1) != 1)
+            fprintf(stderr, "WARNING: couldn't wake up keyboard reader\n");
+        thread.join();
+    }
+    for(int &fd : wakeup)
+    {
+        if(fd >= 0) close(fd);
+        fd = -1;
+    }
+    if(rawMode)
+        tcsetattr(STDIN_FILENO, TCSANOW, &savedMode);
+    rawMode = false;
+}
+
+void chip8input::reader()
+{
+    // block in poll() till the terminal or the wakeup pipe is readable, s.t. the thread takes no CPU meanwhile
+    struct pollfd fds[2] = {{STDIN_FILENO, POLLIN, 0}, {wakeup[0], POLLIN, 0}};
+    char buffer[64];
+    for(;;)
+    {
+        if(poll(fds, 2, -1) < 0)
+        {
+            if(errno == EINTR) continue;
+            break;
+        }
+        if(fds[1].revents)
+            break;
+        if(!(fds[0].revents & POLLIN))
+            continue;
+        ssize_t n = read(STDIN_FILENO, buffer, sizeof(buffer));
+        if(n <= 0)
+            break;
+        event e{std::chrono::steady_clock::now(), 0};
+        bool pushed = false;
+        for(ssize_t i = 0; i < n; ++i)
+        {
+            int key = keyOf(buffer[i]);
+            if(key < 0)
+                continue;
+            e.key = key;
+            if(ring.push(e)) pushed = true;
+            else ++dropped;
+        }
+        // wake the consumer if it is parked
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if(pushed && parked.load(std::memory_order_relaxed))
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            cv.notify_one();
+        }
+    }
+}
+
+uint16_t chip8input::keys()
+{
+    auto now = std::chrono::steady_clock::now();
+    event e;
+    while(ring.pop(e))
+    {
+        lastPress[e.key] = e.time;
+        double latency = std::chrono::duration<double, std::micro>(now - e.time).count();
+        latencySum += latency;
+        latencyMax = std::max(latencyMax, latency);
+        ++presses;
+    }
+    uint16_t keys = 0;
+    for(int k = 0; k < 16; ++k)
+        if(now - lastPress[k] < holdTime)
+            keys |= 1 << k;
+    return keys;
+}
+
+void chip8input::wait(std::chrono::milliseconds timeout)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    parked.store(true, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    cv.wait_for(lock, timeout, [this] { return !ring.empty(); });
+    parked.store(false, std::memory_order_relaxed);
+}
+
+void chip8input::print(FILE *out) const
+{
+    fprintf(out, "input: presses=%llu dropped=%llu latency_avg=%.1fus latency_max=%.1fus\n", (unsigned long long)presses,
+            (unsigned long long)dropped.load(), presses ? latencySum / presses : 0.0, latencyMax);
+}
@@ -0,0 +1,92 @@
+#include "chip8livesource.h"
+#include <chrono>
+#include <stdio.h>
+#include <sys/stat.h>
+
+chip8livesource::chip8livesource(const std::string &file, bool verbose)
+    : assembler(verbose), file(file), lenProgram(0), mtime{0, 0}
+{
+}
+
+bool chip8livesource::load(chip8processor &chip8)
+{
+    // assemble source and copy machine code into memory without a round trip to disk
+    modified(); // remember time of last modification
+    if(!assembler.load(file) || !assembler.compile())
+    {
+        fprintf(stderr, "ERROR: couldn't assemble \"%s\"\n", file.c_str());
+        return false;
+    }
+    if(chip8.load_machinecode(assembler.machinecode) < 0)
+        return false;
+    markers = assembler.getMarkers();
+    lenProgram = assembler.machinecode.size() * 2;
+    printf("load source \"%s\"\n", file.c_str());
+    return true;
+}
+
+int chip8livesource::reload(chip8processor &chip8)
+{
+    // returns 1 if new code was patched in, 0 if the source didn't change and -1 if the new source is broken
+    if(!modified())
+        return 0;
+
+    auto t0 = std::chrono::steady_clock::now();
+    if(!assembler.load(file) || !assembler.compile())
+    {
+        // keep the old program running till the source is fixed
+        fprintf(stderr, "ERROR: couldn't assemble \"%s\", keep running old code\n", file.c_str());
+        return -1;
+    }
+    const std::map<std::string, uint16_t> &newMarkers = assembler.getMarkers();
+    uint16_t newLen = assembler.machinecode.size() * 2;
+    int patched = chip8.patch_machinecode(assembler.machinecode, [&](uint16_t addr) {
+        int newAddr = relocate(addr, newMarkers);
+        return newAddr < 0x200 + newLen ? newAddr : -1;
+    });
+    if(patched < 0)
+    {
+        // NOTE memory still holds the old program, so its layout stays the one to relocate from
+        fprintf(stderr, "ERROR: couldn't load \"%s\", keep running old code\n", file.c_str());
+        return -1;
+    }
+    markers = newMarkers;
+    lenProgram = newLen;
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+    printf("reload source \"%s\" in %.3f ms (%s)\n", file.c_str(), ms, patched ? "state kept" : "program restarted");
+    return 1;
+}
+
+bool chip8livesource::modified()
+{
+    struct stat st;
+    if(stat(file.c_str(), &st) != 0)
+        return false;
+    if(st.st_mtim.tv_sec == mtime.tv_sec && st.st_mtim.tv_nsec == mtime.tv_nsec)
+        return false;
+    mtime = st.st_mtim;
+    return true;
+}
+
+int chip8livesource::relocate(uint16_t addr, const std::map<std::string, uint16_t> &newMarkers)
+{
+    // addresses outside of the old program are not part of the code and keep their value
+    if(addr < 0x200 || addr >= 0x200 + lenProgram)
+        return addr;
+    // find closest marker in front of address in old program, the address keeps its offset to this marker
+    // NOTE addresses in front of the first marker are relative to the program start
+    std::string label;
+    uint16_t base = 0x200;
+    for(auto it=markers.begin(); it!=markers.end(); ++it)
+        if(it->second <= addr && it->second >= base)
+        {
+            label = it->first;
+            base = it->second;
+        }
+    if(label.empty())
+        return addr;
+    auto it = newMarkers.find(label);
+    if(it == newMarkers.end())
+        return -1;
+    return it->second + (addr - base);
+}
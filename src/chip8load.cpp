@@ -0,0 +1,384 @@
+#include "chip8processor.h"
+#include "chip8protocol.h"
+#include "chip8quirks.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using namespace chip8protocol;
+
+/* types */
+struct client
+{
+    int fd = -1;
+    size_t first = 0;                 // index of its first session among all
+    std::vector<uint32_t> sessions;
+    std::vector<double> latencies;    // of each tick, from sending its requests till all responses arrived
+    uint64_t late = 0;                // ticks answered after the next one was due
+    uint64_t frames = 0;
+    uint64_t rows = 0;                // display rows received by FRAME
+    uint64_t errors = 0;
+    uint64_t stateHash = 0;           // of the first session at the end
+    bool ok = true;
+};
+
+/* function prototypes */
+bool parseArgs(int argc, char** argv);
+void printUsage();
+void runClient(client &c, std::chrono::steady_clock::time_point start);
+void request(std::vector<uint8_t> &out, type t, uint32_t session, const void *payload, size_t n);
+bool exchange(int fd, const std::vector<uint8_t> &out, size_t nResponses, std::vector<uint8_t> &in);
+uint16_t keysOf(size_t session, uint32_t tick);
+uint64_t replay(uint32_t ticks);
+
+/* globals */
+std::string strSocket = "/tmp/chip8.sock";
+std::string strFilename = "../roms/BRIX";
+std::vector<uint8_t> rom;
+int nConnections = 8;
+size_t nSessions = 1000;
+double nSeconds = 10;
+int nRate = 60;
+int nCommandsPerFrame = 10;
+
+int main(int argc, char** argv)
+{
+    // read in args from command line
+    if(!parseArgs(argc, argv))
+        return EXIT_FAILURE;
+
+    std::ifstream file(strFilename, std::ios::binary);
+    rom.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    if(rom.empty() || rom.size() > MAX_ROM)
+    {
+        fprintf(stderr, "ERROR: couldn't read ROM \"%s\"\n", strFilename.c_str());
+        return EXIT_FAILURE;
+    }
+
+    // sessions are spread evenly over the connections, each driven by a thread of its own
+    std::vector<client> clients(std::max(1, nConnections));
+    for(size_t i = 0; i < clients.size(); ++i)
+    {
+        clients[i].first = nSessions * i / clients.size();
+        clients[i].sessions.resize(nSessions * (i + 1) / clients.size() - clients[i].first);
+    }
+    uint32_t nTicks = uint32_t(nSeconds * nRate);
+    printf("driving %zu sessions of %s over %zu connections at %d frames/s for %u frames\n", nSessions,
+           strFilename.c_str(), clients.size(), nRate, nTicks);
+
+    // NOTE every client starts ticking at the same time, after all of them had the time to set up their sessions
+    auto start = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+    std::vector<std::thread> threads;
+    for(client &c : clients)
+        threads.emplace_back(runClient, std::ref(c), start);
+    for(std::thread &t : threads)
+        t.join();
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::vector<double> latencies;
+    uint64_t late = 0, frames = 0, rows = 0, errors = 0;
+    bool ok = true;
+    for(client &c : clients)
+    {
+        latencies.insert(latencies.end(), c.latencies.begin(), c.latencies.end());
+        late += c.late; frames += c.frames; rows += c.rows; errors += c.errors;
+        ok = ok && c.ok;
+    }
+    if(!ok || latencies.empty())
+    {
+        fprintf(stderr, "ERROR: clients failed, is chip8-server listening on \"%s\"?\n", strSocket.c_str());
+        return EXIT_FAILURE;
+    }
+    std::sort(latencies.begin(), latencies.end());
+    auto percentile = [&latencies](double p) { return 1000 * latencies[size_t(p * (latencies.size() - 1))]; };
+    printf("frames=%llu rate=%.0f/s target=%llu/s rows=%llu errors=%llu\n", (unsigned long long)frames, frames / elapsed,
+           (unsigned long long)nSessions * nRate, (unsigned long long)rows, (unsigned long long)errors);
+    printf("tick latency: p50=%.3fms p99=%.3fms max=%.3fms late=%llu of %zu\n", percentile(0.5), percentile(0.99),
+           percentile(1.0), (unsigned long long)late, latencies.size());
+
+    // the server has to emulate exactly what a local processor does with the same input
+    uint64_t expected = replay(nTicks);
+    printf("state of session 0: %016llx, replayed locally: %016llx %s\n", (unsigned long long)clients[0].stateHash,
+           (unsigned long long)expected, clients[0].stateHash == expected ? "(match)" : "(MISMATCH)");
+    return errors || clients[0].stateHash != expected ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+uint16_t keysOf(size_t session, uint32_t tick)
+{
+    // a key of its own per session, changing every half second, with breaks without any key
+    uint32_t k = (session * 7 + tick / 30) % 20;
+    return k < 16 ? 1 << k : 0;
+}
+
+uint64_t replay(uint32_t ticks)
+{
+    chip8processor chip8(true);
+    chip8.detect_cycles(false);
+    chip8.set_quirks(chip8quirks::CHIP8);
+    chip8.seed(1);
+    chip8.load_program(rom.data(), rom.size());
+    for(uint32_t t = 0; t < ticks; ++t)
+    {
+        chip8.set_keys(keysOf(0, t));
+        for(int c = 0; c < nCommandsPerFrame; ++c)
+        {
+            if(chip8.fetch_command() < 0 || chip8.exec_command() < 0 || !chip8.is_running())
+                return chip8.state_hash();
+        }
+        chip8.tick_timers();
+    }
+    return chip8.state_hash();
+}
+
+void request(std::vector<uint8_t> &out, type t, uint32_t session, const void *payload, size_t n)
+{
+    header h{uint32_t(sizeof(header) + n), t, 0, 0, session};
+    const uint8_t *p = reinterpret_cast<const uint8_t*>(&h);
+    out.insert(out.end(), p, p + sizeof(h));
+    p = static_cast<const uint8_t*>(payload);
+    out.insert(out.end(), p, p + n);
+}
+
+bool exchange(int fd, const std::vector<uint8_t> &out, size_t nResponses, std::vector<uint8_t> &in)
+{
+    for(size_t done = 0; done < out.size(); )
+    {
+        ssize_t n = send(fd, out.data() + done, out.size() - done, MSG_NOSIGNAL);
+        if(n < 0 && errno != EINTR)
+            return false;
+        if(n > 0) done += n;
+    }
+    // read till the given number of responses is complete
+    in.clear();
+    size_t pos = 0, complete = 0;
+    uint8_t buffer[65536];
+    while(complete < nResponses)
+    {
+        ssize_t n = read(fd, buffer, sizeof(buffer));
+        if(n == 0 || (n < 0 && errno != EINTR))
+            return false;
+        if(n > 0)
+            in.insert(in.end(), buffer, buffer + n);
+        header h;
+        while(complete < nResponses && in.size() - pos >= sizeof(h))
+        {
+            std::memcpy(&h, in.data() + pos, sizeof(h));
+            if(in.size() - pos < h.size)
+                break;
+            pos += h.size;
+            ++complete;
+        }
+    }
+    return true;
+}
+
+void runClient(client &c, std::chrono::steady_clock::time_point start)
+{
+    c.fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    std::strncpy(addr.sun_path, strSocket.c_str(), sizeof(addr.sun_path) - 1);
+    if(c.fd < 0 || connect(c.fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0)
+    {
+        c.ok = false;
+        return;
+    }
+
+    // create and load all sessions by one exchange each
+    std::vector<uint8_t> out, in;
+    create args{chip8quirks::CHIP8, 0, uint16_t(nCommandsPerFrame), 1};
+    for(size_t s = 0; s < c.sessions.size(); ++s)
+        request(out, CREATE, 0, &args, sizeof(args));
+    c.ok = exchange(c.fd, out, c.sessions.size(), in);
+    for(size_t s = 0, pos = 0; c.ok && s < c.sessions.size(); ++s)
+    {
+        header h;
+        std::memcpy(&h, in.data() + pos, sizeof(h));
+        c.ok = h.status == OK;
+        c.sessions[s] = h.session;
+        pos += h.size;
+    }
+    out.clear();
+    for(uint32_t id : c.sessions)
+        request(out, LOAD, id, rom.data(), rom.size());
+    c.ok = c.ok && exchange(c.fd, out, c.sessions.size(), in);
+    if(!c.ok)
+        return;
+
+    // each tick, sessions whose keys changed get INPUT, then all of them STEP a frame and FRAME their display
+    uint32_t nTicks = uint32_t(nSeconds * nRate);
+    auto period = std::chrono::duration<double>(1.0 / nRate);
+    c.latencies.reserve(nTicks);
+    for(uint32_t t = 0; t < nTicks && c.ok; ++t)
+    {
+        auto due = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(period * t);
+        std::this_thread::sleep_until(due);
+        out.clear();
+        size_t nRequests = 0;
+        uint32_t one = 1;
+        for(size_t s = 0; s < c.sessions.size(); ++s)
+        {
+            uint16_t keys = keysOf(c.first + s, t);
+            if(t == 0 || keys != keysOf(c.first + s, t - 1))
+            {
+                request(out, INPUT, c.sessions[s], &keys, sizeof(keys));
+                ++nRequests;
+            }
+            request(out, STEP, c.sessions[s], &one, sizeof(one));
+            request(out, FRAME, c.sessions[s], nullptr, 0);
+            nRequests += 2;
+        }
+        auto sent = std::chrono::steady_clock::now();
+        c.ok = exchange(c.fd, out, nRequests, in);
+        auto now = std::chrono::steady_clock::now();
+        c.latencies.push_back(std::chrono::duration<double>(now - sent).count());
+        if(now > due + std::chrono::duration_cast<std::chrono::steady_clock::duration>(period))
+            ++c.late;
+
+        for(size_t pos = 0; pos < in.size(); )
+        {
+            header h;
+            std::memcpy(&h, in.data() + pos, sizeof(h));
+            if(h.status != OK)
+                ++c.errors;
+            else if(h.type == STEP)
+            {
+                stepped st;
+                std::memcpy(&st, in.data() + pos + sizeof(h), sizeof(st));
+                c.frames += st.frames;
+            }
+            else if(h.type == FRAME)
+            {
+                uint32_t rows;
+                std::memcpy(&rows, in.data() + pos + sizeof(h), sizeof(rows));
+                c.rows += __builtin_popcount(rows);
+            }
+            pos += h.size;
+        }
+    }
+
+    // state of the first session to compare with a local replay
+    out.clear();
+    request(out, SNAPSHOT, c.sessions[0], nullptr, 0);
+    c.ok = c.ok && exchange(c.fd, out, 1, in);
+    if(c.ok)
+        std::memcpy(&c.stateHash, in.data() + sizeof(header), sizeof(c.stateHash));
+    close(c.fd);
+}
+
+bool parseArgs(int argc, char** argv)
+{
+    // parse commandline arguments
+    for (int i = 1; i < argc; ++i)
+    {
+        // print usage on demand
+        if(!std::strcmp(argv[i], "-h") || !std::strcmp(argv[i], "--help"))
+        {
+            printUsage();
+            return false;
+        }
+        // check for socket of the server
+        if(!std::strcmp(argv[i], "-S") || !std::strcmp(argv[i], "--socket"))
+        {
+            i++;
+            if(i < argc)
+            {
+                strSocket = argv[i];
+            }
+            else
+                return false;
+        }
+        // check for rom
+        if(!std::strcmp(argv[i], "-i") || !std::strcmp(argv[i], "--input"))
+        {
+            i++;
+            if(i < argc)
+            {
+                strFilename = argv[i];
+            }
+            else
+                return false;
+        }
+        // check for number of connections
+        if(!std::strcmp(argv[i], "-c") || !std::strcmp(argv[i], "--connections"))
+        {
+            i++;
+            if(i < argc)
+            {
+                nConnections = atoi(argv[i]);
+            }
+            else
+                return false;
+        }
+        // check for number of sessions
+        if(!std::strcmp(argv[i], "-n") || !std::strcmp(argv[i], "--sessions"))
+        {
+            i++;
+            if(i < argc)
+            {
+                nSessions = std::max(1ul, strtoul(argv[i], nullptr, 10));
+            }
+            else
+                return false;
+        }
+        // check for duration
+        if(!std::strcmp(argv[i], "-d") || !std::strcmp(argv[i], "--duration"))
+        {
+            i++;
+            if(i < argc)
+            {
+                nSeconds = atof(argv[i]);
+            }
+            else
+                return false;
+        }
+        // check for frame rate
+        if(!std::strcmp(argv[i], "-r") || !std::strcmp(argv[i], "--rate"))
+        {
+            i++;
+            if(i < argc)
+            {
+                nRate = std::max(1, atoi(argv[i]));
+            }
+            else
+                return false;
+        }
+        // check for commands per frame
+        if(!std::strcmp(argv[i], "-I") || !std::strcmp(argv[i], "--ipf"))
+        {
+            i++;
+            if(i < argc)
+            {
+                nCommandsPerFrame = atoi(argv[i]);
+            }
+            else
+                return false;
+        }
+    }
+
+    return true;
+}
+
+void printUsage()
+{
+    printf("Usage: chip8-load [OPTION]...\n");
+    printf("Drives sessions of chip8-server at a fixed frame rate and reports the rate and latency it achieved.\n");
+    printf("\nOptions:\n");
+    printf("-h --help                                print usage\n");
+    printf("-S --socket PATH                         socket of the server (default: /tmp/chip8.sock)\n");
+    printf("-i --input PATH/TO/ROM                   ROM every session runs (default: ../roms/BRIX)\n");
+    printf("-c --connections N                       connections, each driven by a thread of its own (default: 8)\n");
+    printf("-n --sessions N                          sessions, spread evenly over the connections (default: 1000)\n");
+    printf("-d --duration SECONDS                    time to drive the sessions for (default: 10)\n");
+    printf("-r --rate N                              frames per second of each session (default: 60)\n");
+    printf("-I --ipf N                               commands per frame (default: 10)\n");
+}
@@ -0,0 +1,194 @@
+#include "chip8movie.h"
+#include "chip8processor.h"
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+bool chip8movie::read_script(const std::string &path, std::vector<event> &events)
+{
+    std::ifstream istream(path.c_str());
+    if(!istream.is_open())
+    {
+        fprintf(stderr, "ERROR: couldn't open key script \"%s\"\n", path.c_str());
+        return false;
+    }
+    events.clear();
+    std::string line;
+    for(int nLine = 1; std::getline(istream, line); ++nLine)
+    {
+        size_t begin = line.find_first_not_of(" \t\r");
+        if(begin == std::string::npos || line[begin] == '#')
+            continue;
+        char keys[32];
+        event e{0, 0, 0};
+        bool valid = sscanf(line.c_str() + begin, "%u %31s", &e.frame, keys) == 2;
+        for(const char *c = keys; valid && *c && std::strcmp(keys, "-"); ++c)
+        {
+            const char *digit = std::strchr("0123456789abcdef", tolower(*c));
+            valid = digit && *digit;
+            if(valid) e.keys |= 1 << (digit - "0123456789abcdef");
+        }
+        if(!valid || (!events.empty() && e.frame <= events.back().frame))
+        {
+            fprintf(stderr, "ERROR: %s:%d: expected FRAME KEYS with increasing frames\n", path.c_str(), nLine);
+            return false;
+        }
+        events.push_back(e);
+    }
+    return true;
+}
+
+chip8movie::chip8movie()
+    : data{nullptr}, length{0}, hdr{nullptr}, events{nullptr}, checksums{nullptr}, rec{}
+{
+}
+
+chip8movie::~chip8movie()
+{
+    close();
+}
+
+void chip8movie::record(const chip8processor &chip8, uint32_t seed, uint16_t commandsPerFrame, uint32_t checksumInterval)
+{
+    close();
+    rec = header{};
+    std::memcpy(rec.magic, "C8MV", 4);
+    rec.version = VERSION;
+    rec.quirks = chip8.get_quirks();
+    rec.commandsPerFrame = commandsPerFrame;
+    rec.seed = seed;
+    rec.romHash = chip8.rom_hash();
+    rec.startHash = chip8.state_hash();
+    rec.checksumInterval = checksumInterval;
+    recEvents.clear();
+    recChecksums.clear();
+    hdr = &rec;
+}
+
+void chip8movie::input(uint16_t keys)
+{
+    // only changes of the key state are stored, keys are up before the first event
+    uint16_t current = recEvents.empty() ? 0 : recEvents.back().keys;
+    if(keys == current)
+        return;
+    if(!recEvents.empty() && recEvents.back().frame == rec.nFrames)
+        recEvents.back().keys = keys;
+    else
+        recEvents.push_back(event{rec.nFrames, keys, 0});
+}
+
+void chip8movie::end_frame(uint64_t stateHash)
+{
+    if(rec.checksumInterval && rec.nFrames % rec.checksumInterval == 0)
+        recChecksums.push_back(stateHash);
+    ++rec.nFrames;
+}
+
+bool chip8movie::write(const std::string &path) const
+{
+    header h = rec;
+    h.nEvents = recEvents.size();
+    h.nChecksums = recChecksums.size();
+    h.offEvents = sizeof(header);
+    h.offChecksums = h.offEvents + sizeof(event) * recEvents.size();
+
+    // write next to the movie and replace it at once, as save states are
+    std::string tmp = path + ".tmp";
+    FILE *pFile = fopen(tmp.c_str(), "wb");
+    if(!pFile)
+    {
+        fprintf(stderr, "ERROR: couldn't write movie \"%s\"\n", path.c_str());
+        return false;
+    }
+    bool ok = fwrite(&h, sizeof(header), 1, pFile) == 1;
+    ok = ok && fwrite(recEvents.data(), sizeof(event), recEvents.size(), pFile) == recEvents.size();
+    ok = ok && fwrite(recChecksums.data(), sizeof(uint64_t), recChecksums.size(), pFile) == recChecksums.size();
+    ok = fclose(pFile) == 0 && ok;
+    ok = ok && rename(tmp.c_str(), path.c_str()) == 0;
+    if(!ok)
+    {
+        fprintf(stderr, "ERROR: couldn't write movie \"%s\"\n", path.c_str());
+        remove(tmp.c_str());
+    }
+    return ok;
+}
+
+bool chip8movie::open(const std::string &path, bool verbose)
+{
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if(fd < 0)
+    {
+        if(verbose) fprintf(stderr, "ERROR: couldn't open movie \"%s\"\n", path.c_str());
+        return false;
+    }
+    struct stat st;
+    if(fstat(fd, &st) != 0 || size_t(st.st_size) < sizeof(header))
+    {
+        if(verbose) fprintf(stderr, "ERROR: \"%s\" is no valid movie\n", path.c_str());
+        ::close(fd);
+        return false;
+    }
+    void *p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd); // NOTE the mapping stays valid after closing the file
+    if(p == MAP_FAILED)
+    {
+        if(verbose) fprintf(stderr, "ERROR: couldn't map movie \"%s\"\n", path.c_str());
+        return false;
+    }
+    data = static_cast<const uint8_t*>(p);
+    length = st.st_size;
+
+    // validate header and tables once, s.t. lookups need no checks
+    hdr = reinterpret_cast<const header*>(data);
+    bool valid = !std::memcmp(hdr->magic, "C8MV", 4) && hdr->version == VERSION &&
+                 hdr->offEvents + uint64_t(sizeof(event)) * hdr->nEvents <= length &&
+                 hdr->offChecksums + uint64_t(sizeof(uint64_t)) * hdr->nChecksums <= length &&
+                 hdr->offEvents % alignof(event) == 0 && hdr->offChecksums % alignof(uint64_t) == 0 &&
+                 (!hdr->checksumInterval || hdr->nChecksums <= (uint64_t(hdr->nFrames) + hdr->checksumInterval - 1) / hdr->checksumInterval);
+    if(valid)
+    {
+        events = reinterpret_cast<const event*>(data + hdr->offEvents);
+        checksums = reinterpret_cast<const uint64_t*>(data + hdr->offChecksums);
+        for(uint32_t i = 1; valid && i < hdr->nEvents; ++i)
+            valid = events[i-1].frame < events[i].frame;
+    }
+    if(!valid)
+    {
+        if(verbose) fprintf(stderr, "ERROR: \"%s\" is no valid movie\n", path.c_str());
+        close();
+        return false;
+    }
+    return true;
+}
+
+void chip8movie::close()
+{
+    if(data)
+        munmap(const_cast<uint8_t*>(data), length);
+    data = nullptr; length = 0; hdr = nullptr; events = nullptr; checksums = nullptr;
+}
+
+uint16_t chip8movie::keys(uint32_t frame) const
+{
+    // last event at or before the frame
+    const event *end = events + hdr->nEvents;
+    const event *e = std::upper_bound(events, end, frame, [](uint32_t f, const event &e) { return f < e.frame; });
+    return e == events ? 0 : (e-1)->keys;
+}
+
+bool chip8movie::checksum(uint32_t frame, uint64_t &hash) const
+{
+    if(!hdr->checksumInterval || frame % hdr->checksumInterval)
+        return false;
+    uint32_t i = frame / hdr->checksumInterval;
+    if(i >= hdr->nChecksums)
+        return false;
+    hash = checksums[i];
+    return true;
+}
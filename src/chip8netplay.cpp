@@ -0,0 +1,476 @@
+#include "chip8netplay.h"
+#include "chip8processor.h"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <netdb.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// seconds without a packet of the peer after which it is given up on
+static const double peerTimeout = 5.0;
+// seconds between packets repeated while waiting for the peer
+static const double resendInterval = 0.005;
+
+chip8netplay::chip8netplay()
+    : sock{-1}, peer{}, window{8}, latency{0}, jitter{0}, loss{0}, commandsPerFrame{0},
+      framePeriod{std::chrono::steady_clock::duration::zero()}, states(RING), hashes{}, local{}, remote{}, received{},
+      used{}, next{0}, confirmed{0}, remoteNext{0}, lastRemote{0}, acked{0}, remoteAdvantage{0},
+      rollbackFrom{UINT32_MAX}, peerCheckFrame{0}, peerCheckHash{0}, checkedFrame{0}, startHash{0}, rolledBack{false},
+      desync{false}, stopping{false}, rollbacks{0}, resimulated{0}, mispredicted{0}, maxDepth{0}, rollbackSeconds{0},
+      maxRollbackSeconds{0}, stalls{0}, stallSeconds{0}, waits{0}, sent{0}, receivedPackets{0}, dropped{0}, lagSum{0},
+      checks{0}
+{
+}
+
+chip8netplay::~chip8netplay()
+{
+    close();
+}
+
+bool chip8netplay::open(const std::string &spec)
+{
+    close();
+    size_t first = spec.find(':'), last = spec.rfind(':');
+    if(first == std::string::npos || first == last)
+    {
+        fprintf(stderr, "ERROR: netplay expects LOCALPORT:HOST:PORT, got \"%s\"\n", spec.c_str());
+        return false;
+    }
+    std::string host = spec.substr(first + 1, last - first - 1);
+    int localPort = atoi(spec.substr(0, first).c_str());
+    addrinfo hints{}, *res = nullptr;
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+    if(getaddrinfo(host.c_str(), spec.c_str() + last + 1, &hints, &res) != 0 || !res)
+    {
+        fprintf(stderr, "ERROR: couldn't resolve netplay peer \"%s\"\n", spec.c_str() + first + 1);
+        return false;
+    }
+    std::memcpy(&peer, res->ai_addr, sizeof(peer));
+    freeaddrinfo(res);
+
+    // NOTE the socket is connected to the peer, s.t. datagrams of anyone else are dropped by the kernel
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(localPort);
+    sock = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if(sock < 0 || bind(sock, (sockaddr*)&addr, sizeof(addr)) != 0 || connect(sock, (sockaddr*)&peer, sizeof(peer)) != 0)
+    {
+        fprintf(stderr, "ERROR: couldn't open UDP port %d for netplay: %s\n", localPort, strerror(errno));
+        close();
+        return false;
+    }
+    if(latency > 0 || jitter > 0 || loss > 0)
+    {
+        // NOTE seeded by the port, s.t. both directions see different impairments, but the same in every run
+        rng.seed(localPort);
+        stopping = false;
+        thread = std::thread(&chip8netplay::injector, this);
+    }
+    return true;
+}
+
+void chip8netplay::close()
+{
+    if(thread.joinable())
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_one();
+        thread.join();
+        delayLine.clear();
+    }
+    if(sock >= 0)
+        ::close(sock);
+    sock = -1;
+}
+
+bool chip8netplay::set_window(uint32_t frames)
+{
+    // NOTE states back to the earliest frame not confirmed and keys not acknowledged must stay in the rings
+    if(frames < 1 || frames > RING - 4)
+    {
+        fprintf(stderr, "ERROR: netplay window must be 1 to %u frames\n", RING - 4);
+        return false;
+    }
+    window = frames;
+    return true;
+}
+
+bool chip8netplay::set_impairment(const std::string &spec)
+{
+    int l = 0, j = 0, p = 0;
+    if(sscanf(spec.c_str(), "%d:%d:%d", &l, &j, &p) < 1 || l < 0 || j < 0 || p < 0 || p > 100)
+    {
+        fprintf(stderr, "ERROR: impairment expects LATENCY[:JITTER[:LOSS]], got \"%s\"\n", spec.c_str());
+        return false;
+    }
+    latency = l;
+    jitter = j;
+    loss = p;
+    return true;
+}
+
+bool chip8netplay::start(chip8processor &chip8, uint16_t keys, int commandsPerFrame, int fps)
+{
+    this->commandsPerFrame = commandsPerFrame;
+    framePeriod = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<double>(1.0 / (fps > 0 ? fps : 60)));
+    std::fill(received, received + RING, UINT32_MAX);
+    next = 0;
+    startHash = chip8.state_hash();
+    save(0, chip8);
+    local[0] = keys;
+
+    // say hello till the peer does, both start emulating once they heard of each other
+    printf("netplay: waiting for peer %s:%u\n", inet_ntoa(peer.sin_addr), ntohs(peer.sin_port));
+    fflush(stdout);
+    lastReceived = std::chrono::steady_clock::now();
+    while(!receivedPackets)
+    {
+        if(since(lastReceived) > 30.0)
+        {
+            fprintf(stderr, "ERROR: netplay peer didn't show up\n");
+            return false;
+        }
+        if(since(lastSent) > 0.02)
+            send();
+        receive(20);
+        if(desync)
+            return false;
+    }
+    send();
+    chip8.set_keys(keys | remoteKeys(0));
+    return true;
+}
+
+bool chip8netplay::end_frame(uint32_t f, chip8processor &chip8, uint16_t keys)
+{
+    rolledBack = false;
+    next = f + 1;
+    lagSum += next - std::min(confirmed, next);
+
+    // correct what was emulated with mispredicted keys, then keep the state the next frame starts from
+    receive(0);
+    if(desync)
+        return false;
+    if(rollbackFrom < next)
+        rollback(chip8);
+    else
+        save(next, chip8);
+    if(!check())
+        return false;
+    local[next % RING] = keys;
+    send();
+
+    // a peer behind by frames sees all of them mispredicted, so wait for it to catch up
+    // NOTE both report how far they are ahead of the keys they have of each other, which differ by twice the frames
+    // one is ahead of the other if latency is the same both ways
+    int32_t advantage = next - remoteNext;
+    if(next % 60 == 0 && advantage - remoteAdvantage >= 2)
+    {
+        int n = std::min((advantage - remoteAdvantage) / 2, 8);
+        std::this_thread::sleep_for(n * framePeriod);
+        waits += n;
+    }
+
+    // don't run further ahead of the peer than the window
+    if(stalled())
+    {
+        ++stalls;
+        auto t = std::chrono::steady_clock::now();
+        while(stalled())
+        {
+            if(since(lastReceived) > peerTimeout)
+            {
+                fprintf(stderr, "ERROR: netplay peer is gone, nothing received for %.0f s\n", peerTimeout);
+                return false;
+            }
+            receive(1);
+            if(desync)
+                return false;
+            if(rollbackFrom < next)
+                rollback(chip8);
+            if(!check())
+                return false;
+            if(since(lastSent) > resendInterval)
+                send();
+        }
+        stallSeconds += since(t);
+    }
+
+    chip8.set_keys(keys | remoteKeys(next));
+    return true;
+}
+
+bool chip8netplay::finish(chip8processor &chip8)
+{
+    rolledBack = false;
+    if(sock < 0 || chip8.state_hash() != hashes[next % RING])
+        return true;
+
+    // wait for the remote keys of all frames emulated
+    while(confirmed < next)
+    {
+        if(since(lastReceived) > peerTimeout)
+        {
+            fprintf(stderr, "ERROR: netplay peer is gone, nothing received for %.0f s\n", peerTimeout);
+            return false;
+        }
+        receive(1);
+        if(desync)
+            return false;
+        if(since(lastSent) > resendInterval)
+            send();
+    }
+    if(rollbackFrom < next)
+        rollback(chip8);
+    if(!check())
+        return false;
+
+    // the peer may still miss some of the local keys
+    auto t = std::chrono::steady_clock::now();
+    while(acked < next && since(t) < 1.0)
+    {
+        receive(1);
+        if(since(lastSent) > resendInterval)
+            send();
+    }
+    send();
+    return check();
+}
+
+void chip8netplay::receive(int timeoutMs)
+{
+    if(timeoutMs > 0)
+    {
+        pollfd p{sock, POLLIN, 0};
+        if(poll(&p, 1, timeoutMs) <= 0)
+            return;
+    }
+    packet pkt;
+    const size_t headerSize = offsetof(packet, keys);
+    for(;;)
+    {
+        ssize_t n = recv(sock, &pkt, sizeof(pkt), MSG_DONTWAIT);
+        if(n < 0)
+        {
+            // NOTE a datagram sent before the peer's port was open comes back as an error, which is consumed by this
+            if(errno == ECONNREFUSED || errno == EINTR)
+                continue;
+            break;
+        }
+        if((size_t)n < headerSize || std::memcmp(pkt.magic, "C8NP", 4) != 0 || pkt.count > RING ||
+           (size_t)n != headerSize + pkt.count * sizeof(uint16_t))
+            continue;
+        ++receivedPackets;
+        lastReceived = std::chrono::steady_clock::now();
+        if(pkt.startHash != startHash)
+        {
+            fprintf(stderr, "ERROR: netplay peer runs another ROM or started from another state (hash %016llx, "
+                    "running %016llx)\n", (unsigned long long)pkt.startHash, (unsigned long long)startHash);
+            desync = true;
+            return;
+        }
+
+        // NOTE keys beyond the ring would overwrite those of frames which may still be emulated again
+        uint32_t limit = std::min(confirmed, rollbackFrom) + RING;
+        for(uint32_t i = 0; i < pkt.count; ++i)
+        {
+            uint32_t k = pkt.first + i;
+            if(k < confirmed || k >= limit || received[k % RING] == k)
+                continue;
+            received[k % RING] = k;
+            remote[k % RING] = pkt.keys[i];
+            remoteNext = std::max(remoteNext, k + 1);
+            if(k < next && used[k % RING] != pkt.keys[i])
+            {
+                ++mispredicted;
+                rollbackFrom = std::min(rollbackFrom, k);
+            }
+        }
+        while(received[confirmed % RING] == confirmed)
+            lastRemote = remote[confirmed++ % RING];
+
+        acked = std::max(acked, pkt.ack);
+        remoteAdvantage = pkt.advantage;
+        if(pkt.checkFrame > peerCheckFrame)
+        {
+            peerCheckFrame = pkt.checkFrame;
+            peerCheckHash = pkt.checkHash;
+        }
+    }
+}
+
+void chip8netplay::send()
+{
+    // all local keys the peer doesn't have yet, up to those of the frame about to be emulated
+    packet pkt;
+    std::memcpy(pkt.magic, "C8NP", 4);
+    pkt.first = std::max(acked, next + 1 > RING ? next + 1 - RING : 0);
+    pkt.count = next + 1 - pkt.first;
+    pkt.ack = confirmed;
+    pkt.advantage = next - remoteNext;
+    // NOTE states from a mispredicted frame on are only right once emulated again
+    pkt.checkFrame = std::min(std::min(confirmed, next), rollbackFrom);
+    pkt.checkHash = hashes[pkt.checkFrame % RING];
+    pkt.startHash = startHash;
+    for(uint32_t i = 0; i < pkt.count; ++i)
+        pkt.keys[i] = local[(pkt.first + i) % RING];
+    transmit(&pkt, offsetof(packet, keys) + pkt.count * sizeof(uint16_t));
+}
+
+void chip8netplay::transmit(const void *data, size_t size)
+{
+    ++sent;
+    lastSent = std::chrono::steady_clock::now();
+    if(!thread.joinable())
+    {
+        ::send(sock, data, size, MSG_DONTWAIT);
+        return;
+    }
+
+    // impairment: drop or delay, jittered packets may overtake each other as on a real network
+    if(loss > 0 && (int)(rng() % 100) < loss)
+    {
+        ++dropped;
+        return;
+    }
+    int delay = latency * 1000;
+    if(jitter > 0)
+        delay += (int)(rng() % (2 * jitter * 1000 + 1)) - jitter * 1000;
+    auto due = lastSent + std::chrono::microseconds(std::max(delay, 0));
+    const uint8_t *bytes = static_cast<const uint8_t*>(data);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        delayLine.emplace(due, std::vector<uint8_t>(bytes, bytes + size));
+    }
+    wake.notify_one();
+}
+
+void chip8netplay::injector()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while(!stopping)
+    {
+        if(delayLine.empty())
+        {
+            wake.wait(lock);
+            continue;
+        }
+        auto due = delayLine.begin()->first;
+        if(due > std::chrono::steady_clock::now())
+        {
+            wake.wait_until(lock, due);
+            continue;
+        }
+        std::vector<uint8_t> bytes = std::move(delayLine.begin()->second);
+        delayLine.erase(delayLine.begin());
+        lock.unlock();
+        ::send(sock, bytes.data(), bytes.size(), MSG_DONTWAIT);
+        lock.lock();
+    }
+}
+
+void chip8netplay::save(uint32_t frame, const chip8processor &chip8)
+{
+    chip8.get_state(states[frame % RING]);
+    hashes[frame % RING] = chip8.state_hash();
+}
+
+void chip8netplay::rollback(chip8processor &chip8)
+{
+    // go back to the state before the first mispredicted frame and emulate all since with the keys known by now
+    auto t = std::chrono::steady_clock::now();
+    uint32_t depth = next - rollbackFrom;
+    chip8.set_state(states[rollbackFrom % RING], hashes[rollbackFrom % RING]);
+    for(uint32_t frame = rollbackFrom; frame < next; ++frame)
+    {
+        emulate(chip8, frame);
+        save(frame + 1, chip8);
+    }
+    rollbackFrom = UINT32_MAX;
+    rolledBack = true;
+
+    double s = since(t);
+    ++rollbacks;
+    resimulated += depth;
+    maxDepth = std::max(maxDepth, depth);
+    rollbackSeconds += s;
+    maxRollbackSeconds = std::max(maxRollbackSeconds, s);
+}
+
+void chip8netplay::emulate(chip8processor &chip8, uint32_t frame)
+{
+    // a frame as chip8supervisor runs it: its commands, then the timers tick once
+    chip8.set_keys(local[frame % RING] | remoteKeys(frame));
+    for(int c = 0; c < commandsPerFrame && chip8.is_running(); ++c)
+    {
+        if(chip8.fetch_command() < 0 || chip8.exec_command() < 0)
+            break;
+    }
+    chip8.tick_timers();
+}
+
+uint16_t chip8netplay::remoteKeys(uint32_t frame)
+{
+    // keys of the peer if received, else predicted to be held since the last frame all are received of
+    uint16_t keys = received[frame % RING] == frame ? remote[frame % RING] : lastRemote;
+    used[frame % RING] = keys;
+    return keys;
+}
+
+bool chip8netplay::check()
+{
+    // compare the latest state the peer has all keys for once all keys of it are here as well
+    uint32_t c = peerCheckFrame;
+    if(c <= checkedFrame || c > confirmed || c > next || next - c >= RING || rollbackFrom < next)
+        return true;
+    checkedFrame = c;
+    ++checks;
+    if(hashes[c % RING] != peerCheckHash)
+    {
+        printf("desync: frame=%u state=%016llx peer=%016llx\n", c, (unsigned long long)hashes[c % RING],
+               (unsigned long long)peerCheckHash);
+        desync = true;
+        return false;
+    }
+    return true;
+}
+
+bool chip8netplay::stalled() const
+{
+    return next - std::min(confirmed, next) > window || next - acked >= RING - 1;
+}
+
+double chip8netplay::since(std::chrono::steady_clock::time_point t) const
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - t).count();
+}
+
+void chip8netplay::print(FILE *out) const
+{
+    // rollback cost is what emulating frames again takes, per rollback and spread over all frames, relative to the
+    // time a frame has
+    double budget = std::chrono::duration<double>(framePeriod).count();
+    double perFrame = next ? rollbackSeconds / next : 0.0;
+    fprintf(out, "netplay: frames=%u rollbacks=%llu resimulated=%llu mispredicted=%llu max_depth=%u lag=%.2f "
+            "stalls=%llu stall_time=%.3fs waits=%llu checks=%llu\n", next, (unsigned long long)rollbacks,
+            (unsigned long long)resimulated, (unsigned long long)mispredicted, maxDepth,
+            next ? (double)lagSum / next : 0.0, (unsigned long long)stalls, stallSeconds, (unsigned long long)waits,
+            (unsigned long long)checks);
+    fprintf(out, "netplay: rollback avg=%.1fus max=%.1fus (%.2f%% of a frame) per_frame=%.2fus (%.3f%%) "
+            "per_resimulated_frame=%.2fus\n", rollbacks ? 1e6 * rollbackSeconds / rollbacks : 0.0,
+            1e6 * maxRollbackSeconds, budget > 0 ? 100.0 * maxRollbackSeconds / budget : 0.0, 1e6 * perFrame,
+            budget > 0 ? 100.0 * perFrame / budget : 0.0, resimulated ? 1e6 * rollbackSeconds / resimulated : 0.0);
+    fprintf(out, "netplay: packets sent=%llu received=%llu dropped=%llu latency=%dms jitter=%dms loss=%d%%\n",
+            (unsigned long long)sent, (unsigned long long)receivedPackets, (unsigned long long)dropped, latency, jitter,
+            loss);
+}
@@ -0,0 +1,326 @@
+#include "chip8optimizer.h"
+#include "chip8processor.h"
+#include <stdio.h>
+
+// helpers to read fields of a CHIP-8 command
+static inline uint8_t opcode(uint16_t w) { return w >> 12; }
+static inline uint16_t target(uint16_t w) { return w & 0x0FFF; }
+static inline uint16_t address(size_t i) { return 0x200 + uint16_t(i*2); }
+
+chip8optimizer::report& chip8optimizer::report::operator+=(const report &o)
+{
+    wordsBefore += o.wordsBefore; wordsAfter += o.wordsAfter;
+    jumpsThreaded += o.jumpsThreaded; jumpsRemoved += o.jumpsRemoved;
+    deadRemoved += o.deadRemoved; foldsApplied += o.foldsApplied; skipsShrunk += o.skipsShrunk;
+    executedBefore += o.executedBefore; executedAfter += o.executedAfter;
+    return *this;
+}
+
+void chip8optimizer::report::print() const
+{
+    printf("#### OPTIMIZER ####\n");
+    printf("static:  %zu -> %zu commands (%zu saved)\n", wordsBefore, wordsAfter, wordsBefore - wordsAfter);
+    printf("         jumps threaded: %zu, jumps to next removed: %zu, dead commands removed: %zu,\n", jumpsThreaded, jumpsRemoved, deadRemoved);
+    printf("         LD/ADD chains folded: %zu, skip-over-jumps shrunk: %zu\n", foldsApplied, skipsShrunk);
+    if(executedBefore > 0)
+        printf("dynamic: %llu -> %llu executed commands (%lld saved)\n", (unsigned long long)executedBefore, (unsigned long long)executedAfter, (long long)executedBefore - (long long)executedAfter);
+}
+
+void chip8optimizer::optimize(std::vector<uint16_t> &code, std::map<std::string, uint16_t> &markers,
+                              const std::vector<bool> &data)
+{
+    this->code = &code;
+    this->markers = &markers;
+    this->data = data;
+    this->data.resize(code.size(), false);
+    stats.wordsBefore += code.size();
+    remap.resize(code.size());
+    for(size_t i=0; i<remap.size(); ++i) remap[i] = i;
+
+    // run all passes till none of them finds anything to improve, one pass can enable the others
+    // NOTE each pass works on freshly analyzed code and removed commands are compacted right after the pass
+    for(int iteration=0; iteration<16; ++iteration)
+    {
+        bool changed = false;
+        analyze(); changed |= threadJumps();
+        analyze(); if(removeJumpsToNext()) { compact(); changed = true; }
+        analyze(); if(removeDeadCode()) { compact(); changed = true; }
+        analyze(); if(foldRegisterChains()) { compact(); changed = true; }
+        analyze(); if(shrinkSkips()) { compact(); changed = true; }
+        if(!changed) break;
+    }
+
+    stats.wordsAfter += code.size();
+}
+
+uint64_t chip8optimizer::countExecuted(const std::vector<uint16_t> &code, uint64_t budget)
+{
+    // run program till it ends up in a jump to itself, which is how CHIP-8 programs usually end
+    chip8processor chip8(true);
+    if(chip8.load_machinecode(code) < 0)
+        return 0;
+    uint64_t n = 0;
+    int last = -1;
+    while(n < budget && chip8.is_running())
+    {
+        int addr = chip8.fetch_command();
+        if(addr == last)
+            break;
+        if(chip8.exec_command() < 0)
+            break;
+        last = addr;
+        n++;
+    }
+    return n;
+}
+
+void chip8optimizer::analyze()
+{
+    const std::vector<uint16_t> &c = *code;
+    size_t n = c.size();
+    removed.assign(n, false);
+    referenced.assign(n, false);
+    pinned.assign(n, false);
+    computedJumps = false;
+
+    auto index = [n](uint16_t addr) { return addr >= 0x200 && size_t(addr - 0x200) / 2 < n ? long(addr - 0x200) / 2 : -1; };
+
+    // markers are treated as referenced, even when no command uses them
+    for(auto it=markers->begin(); it!=markers->end(); ++it)
+        if(index(it->second) >= 0) referenced[index(it->second)] = true;
+    std::vector<long> dataStarts;
+    for(size_t i=0; i<n; ++i)
+    {
+        if(data[i])
+        {
+            pinned[i] = true;
+            continue;
+        }
+        uint8_t op = opcode(c[i]);
+        if(op == 0x1 || op == 0x2 || op == 0xA || op == 0xB)
+        {
+            long t = index(target(c[i]));
+            if(t >= 0) referenced[t] = true;
+            if(op == 0xA && t >= 0) dataStarts.push_back(t);
+        }
+        if(op == 0xB) computedJumps = true;
+    }
+    // memory addressed via I is data and is read relative to its start, so it must stay in one piece till the next reference
+    for(long t : dataStarts)
+    {
+        pinned[t] = true;
+        for(size_t i=t+1; i<n && !referenced[i]; ++i)
+            pinned[i] = true;
+    }
+}
+
+void chip8optimizer::compact()
+{
+    std::vector<uint16_t> &c = *code;
+    size_t n = c.size();
+
+    // new index of every command, removed commands map onto the next command which is kept
+    std::vector<size_t> newIndex(n+1);
+    size_t kept = 0;
+    for(size_t i=0; i<n; ++i)
+    {
+        newIndex[i] = kept;
+        if(!removed[i]) kept++;
+    }
+    newIndex[n] = kept;
+    auto relocate = [&](uint16_t addr) -> uint16_t {
+        if(addr < 0x200 || size_t(addr - 0x200) > 2*n) return addr;
+        return 0x200 + 2*newIndex[(addr - 0x200) / 2] + ((addr - 0x200) & 1);
+    };
+
+    // rewrite all addresses
+    for(size_t i=0; i<n; ++i)
+    {
+        uint8_t op = opcode(c[i]);
+        if(!data[i] && (op == 0x1 || op == 0x2 || op == 0xA || op == 0xB))
+            c[i] = (c[i] & 0xF000) | relocate(target(c[i]));
+    }
+    for(auto it=markers->begin(); it!=markers->end(); ++it)
+        it->second = relocate(it->second);
+    for(size_t r=0; r<remap.size(); ++r)
+        if(remap[r] >= 0)
+            remap[r] = removed[remap[r]] ? -1 : newIndex[remap[r]];
+
+    // drop removed commands
+    size_t j = 0;
+    for(size_t i=0; i<n; ++i)
+        if(!removed[i])
+        {
+            data[j] = data[i];
+            c[j++] = c[i];
+        }
+    c.resize(j);
+    data.resize(j);
+}
+
+bool chip8optimizer::isSkip(size_t i) const
+{
+    uint16_t w = (*code)[i];
+    switch(opcode(w))
+    {
+    case 0x3: case 0x4: return true;
+    case 0x5: case 0x9: return (w & 0x000F) == 0;
+    case 0xE: return (w & 0x00FF) == 0x9E || (w & 0x00FF) == 0xA1;
+    default: return false;
+    }
+}
+
+bool chip8optimizer::followsSkip(size_t i) const
+{
+    // a command right behind a skip can be jumped over, so it can't be moved or merged with its successor
+    return i > 0 && !pinned[i-1] && isSkip(i-1);
+}
+
+bool chip8optimizer::removable(size_t i) const
+{
+    // with JP V0, addr any command could be part of a jump table, which must keep its layout
+    return !pinned[i] && !computedJumps;
+}
+
+bool chip8optimizer::threadJumps()
+{
+    // JP a; ... a: JP b -> JP b, works the same for CALL, JP a; ... a: RET -> RET
+    std::vector<uint16_t> &c = *code;
+    size_t n = c.size();
+    bool changed = false;
+    for(size_t i=0; i<n; ++i)
+    {
+        uint8_t op = opcode(c[i]);
+        if((op != 0x1 && op != 0x2) || pinned[i]) continue;
+        uint16_t t = target(c[i]);
+        for(int steps=0; steps<16; ++steps) // NOTE bounded to stop at jump cycles
+        {
+            size_t k = (t - 0x200) / 2;
+            if(t < 0x200 || (t & 1) || k >= n || pinned[k] || opcode(c[k]) != 0x1 || target(c[k]) == t)
+                break;
+            t = target(c[k]);
+        }
+        size_t k = (t - 0x200) / 2;
+        if(op == 0x1 && t >= 0x200 && !(t & 1) && k < n && !pinned[k] && c[k] == 0x00EE)
+        {
+            c[i] = 0x00EE;
+            stats.jumpsThreaded++;
+            changed = true;
+        }
+        else if(t != target(c[i]))
+        {
+            c[i] = (c[i] & 0xF000) | t;
+            stats.jumpsThreaded++;
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+bool chip8optimizer::removeJumpsToNext()
+{
+    // JP next; next: -> next:
+    const std::vector<uint16_t> &c = *code;
+    bool changed = false;
+    for(size_t i=0; i<c.size(); ++i)
+    {
+        if(opcode(c[i]) == 0x1 && target(c[i]) == address(i+1) && !followsSkip(i) && removable(i))
+        {
+            removed[i] = true;
+            stats.jumpsRemoved++;
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+bool chip8optimizer::removeDeadCode()
+{
+    // commands behind an unconditional JP or RET can only be reached by a reference to them
+    const std::vector<uint16_t> &c = *code;
+    if(computedJumps) return false;
+    bool changed = false;
+    bool dead = false;
+    for(size_t i=0; i<c.size(); ++i)
+    {
+        if(referenced[i]) dead = false;
+        if(dead && !pinned[i])
+        {
+            removed[i] = true;
+            stats.deadRemoved++;
+            changed = true;
+        }
+        else if(!pinned[i] && (opcode(c[i]) == 0x1 || c[i] == 0x00EE) && !followsSkip(i))
+            dead = true;
+    }
+    return changed;
+}
+
+bool chip8optimizer::foldRegisterChains()
+{
+    // LD Vx, a; LD Vx, b -> LD Vx, b
+    // LD Vx, a; ADD Vx, b -> LD Vx, a+b
+    // ADD Vx, a; ADD Vx, b -> ADD Vx, a+b
+    // ADD Vx, 0 and LD Vx, Vx are dropped
+    // NOTE ADD Vx, byte doesn't touch the carry flag, so the sums can be folded modulo 256
+    std::vector<uint16_t> &c = *code;
+    size_t n = c.size();
+    bool changed = false;
+    for(size_t i=0; i<n; ++i)
+    {
+        if(followsSkip(i) || !removable(i)) continue;
+        uint16_t a = c[i];
+        bool noop = (opcode(a) == 0x7 && (a & 0x00FF) == 0) ||
+                    ((a & 0xF00F) == 0x8000 && ((a >> 8) & 0xF) == ((a >> 4) & 0xF));
+        if(noop)
+        {
+            removed[i] = true;
+            stats.foldsApplied++;
+            changed = true;
+            continue;
+        }
+        if(i+1 >= n || referenced[i+1] || !removable(i+1)) continue;
+        uint16_t b = c[i+1];
+        if((a & 0x0F00) != (b & 0x0F00)) continue;
+        uint16_t x = a & 0x0F00;
+        uint8_t sum = (a + b) & 0x00FF;
+        if(opcode(a) == 0x6 && opcode(b) == 0x6)
+            c[i] = b;
+        else if(opcode(a) == 0x6 && opcode(b) == 0x7)
+            c[i] = 0x6000 | x | sum;
+        else if(opcode(a) == 0x7 && opcode(b) == 0x7)
+            c[i] = 0x7000 | x | sum;
+        else
+            continue;
+        removed[++i] = true;
+        stats.foldsApplied++;
+        changed = true;
+    }
+    return changed;
+}
+
+bool chip8optimizer::shrinkSkips()
+{
+    // SNE Vx, k; JP skip; A; skip: -> SE Vx, k; A; skip:
+    std::vector<uint16_t> &c = *code;
+    size_t n = c.size();
+    bool changed = false;
+    for(size_t i=0; i+2<n; ++i)
+    {
+        if(!isSkip(i) || pinned[i] || followsSkip(i)) continue;
+        if(opcode(c[i+1]) != 0x1 || target(c[i+1]) != address(i+3)) continue;
+        if(referenced[i+1] || !removable(i+1) || pinned[i+2]) continue;
+        // invert condition of skip
+        switch(opcode(c[i]))
+        {
+        case 0x3: case 0x4: c[i] ^= 0x7000; break; // 3xkk <-> 4xkk
+        case 0x5: case 0x9: c[i] ^= 0xC000; break; // 5xy0 <-> 9xy0
+        case 0xE: c[i] ^= 0x003F; break;           // Ex9E <-> ExA1
+        }
+        removed[i+1] = true;
+        stats.skipsShrunk++;
+        changed = true;
+        i += 2;
+    }
+    return changed;
+}
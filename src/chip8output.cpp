@@ -0,0 +1,146 @@
+#include "chip8output.h"
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <stdio.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+static const char hexdigits[] = "0123456789abcdef";
+
+// two hex digits of every byte
+static constexpr std::array<char, 512> makeHexPairs()
+{
+    std::array<char, 512> t{};
+    for(int b = 0; b < 256; ++b)
+    {
+        t[2*b] = "0123456789abcdef"[b >> 4];
+        t[2*b+1] = "0123456789abcdef"[b & 0xF];
+    }
+    return t;
+}
+static constexpr std::array<char, 512> hexpairs = makeHexPairs();
+
+chip8output::chip8output(int fd, size_t capacity) : fd(fd), buf(capacity), used(0) {}
+
+chip8output::~chip8output()
+{
+    flush();
+}
+
+void chip8output::grow(size_t n)
+{
+    // hand full buffer to the kernel first, the buffer only grows for requests larger than its capacity
+    flush();
+    if(n > buf.size())
+        buf.resize(n);
+}
+
+bool chip8output::flush()
+{
+    if(used == 0)
+        return true;
+    if(fd == STDOUT_FILENO)
+        fflush(stdout);
+    const char *p = buf.data();
+    size_t left = used;
+    used = 0;
+    while(left > 0)
+    {
+        ssize_t n = write(fd, p, left);
+        if(n < 0)
+        {
+            if(errno == EINTR) continue;
+            return false;
+        }
+        p += n;
+        left -= n;
+    }
+    return true;
+}
+
+void chip8output::put(const char *s)
+{
+    put(s, strlen(s));
+}
+
+void chip8output::put(const char *s, size_t n)
+{
+    memcpy(reserve(n), s, n);
+    used += n;
+}
+
+void chip8output::hex(uint32_t v, int digits)
+{
+    int n = 1;
+    for(uint32_t r = v >> 4; r; r >>= 4) ++n;
+    n = std::max(n, digits);
+    char *p = reserve(n);
+    for(int i = n-1; i >= 0; --i, v >>= 4)
+        p[i] = hexdigits[v & 0xF];
+    used += n;
+}
+
+void chip8output::dec(long v)
+{
+    char tmp[24];
+    int n = 0;
+    unsigned long u = v < 0 ? 0UL - v : v;
+    do { tmp[n++] = '0' + u % 10; u /= 10; } while(u);
+    if(v < 0) tmp[n++] = '-';
+    char *p = reserve(n);
+    for(int i = 0; i < n; ++i)
+        p[i] = tmp[n-1-i];
+    used += n;
+}
+
+void chip8output::hexdump(const uint8_t *data, size_t len, uint32_t addr, int cols)
+{
+    for(size_t row = 0; row < len; row += cols)
+    {
+        size_t n = std::min<size_t>(cols, len - row);
+        put("0x", 2);
+        hex(addr + row, 3);
+        put(": ", 2);
+        used += chip8hexbytes(data + row, n, reserve(3*n + 1));
+        put('\n');
+    }
+}
+
+size_t chip8hexbytes(const uint8_t *src, size_t n, char *dst)
+{
+    char *p = dst;
+    size_t i = 0;
+#ifdef __SSE2__
+    // 16 bytes at once: split into nibbles, map 0-9 to '0'-'9' and 10-15 to 'a'-'f' and interleave them to pairs
+    // NOTE SSE2 has no byte shuffle to insert the separating spaces, so pairs are spread by 16 bit copies
+    const __m128i mask = _mm_set1_epi8(0x0F);
+    const __m128i nine = _mm_set1_epi8(9);
+    const __m128i zero = _mm_set1_epi8('0');
+    const __m128i gap = _mm_set1_epi8('a' - '0' - 10);
+    for(; i + 16 <= n; i += 16)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        __m128i hi = _mm_and_si128(_mm_srli_epi16(v, 4), mask);
+        __m128i lo = _mm_and_si128(v, mask);
+        hi = _mm_add_epi8(_mm_add_epi8(hi, zero), _mm_and_si128(_mm_cmpgt_epi8(hi, nine), gap));
+        lo = _mm_add_epi8(_mm_add_epi8(lo, zero), _mm_and_si128(_mm_cmpgt_epi8(lo, nine), gap));
+        alignas(16) char pairs[32];
+        _mm_store_si128(reinterpret_cast<__m128i*>(pairs), _mm_unpacklo_epi8(hi, lo));
+        _mm_store_si128(reinterpret_cast<__m128i*>(pairs + 16), _mm_unpackhi_epi8(hi, lo));
+        for(int k = 0; k < 16; ++k, p += 3)
+        {
+            memcpy(p, pairs + 2*k, 2);
+            p[2] = ' ';
+        }
+    }
+#endif
+    for(; i < n; ++i, p += 3)
+    {
+        memcpy(p, hexpairs.data() + 2*src[i], 2);
+        p[2] = ' ';
+    }
+    return p - dst;
+}
@@ -0,0 +1,123 @@
+#include "chip8romarchive.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+/* function prototypes */
+bool parseArgs(int argc, char** argv);
+void printUsage();
+
+/* globals */
+std::string strArchive = "roms.c8a";
+std::vector<std::string> inputs;
+bool bList = false;
+
+int main(int argc, char** argv)
+{
+    // read in args from command line
+    if(!parseArgs(argc, argv))
+        return EXIT_FAILURE;
+
+    // pack all regular files of the given directories and the given files
+    if(!inputs.empty())
+    {
+        std::vector<std::string> files;
+        for(const std::string &input : inputs)
+        {
+            std::error_code ec;
+            if(!std::filesystem::is_directory(input, ec))
+            {
+                files.push_back(input);
+                continue;
+            }
+            std::vector<std::string> dir;
+            for(const auto &entry : std::filesystem::directory_iterator(input, ec))
+                if(entry.is_regular_file())
+                    dir.push_back(entry.path().string());
+            if(ec)
+            {
+                fprintf(stderr, "ERROR: couldn't read directory \"%s\"\n", input.c_str());
+                return EXIT_FAILURE;
+            }
+            std::sort(dir.begin(), dir.end());
+            files.insert(files.end(), dir.begin(), dir.end());
+        }
+        if(!chip8romarchive::pack(files, strArchive))
+            return EXIT_FAILURE;
+        printf("packed %zu ROMs into %s\n", files.size(), strArchive.c_str());
+    }
+
+    // list content of archive
+    if(bList)
+    {
+        chip8romarchive archive;
+        if(!archive.open(strArchive))
+            return EXIT_FAILURE;
+        for(uint32_t i=0; i<archive.size(); ++i)
+        {
+            const chip8romarchive::entry &e = archive.at(i);
+            printf("%016llx %6u %8llu %s\n", (unsigned long long)e.hash, e.size, (unsigned long long)e.offset,
+                   archive.name(e));
+        }
+        printf("%u ROMs\n", archive.size());
+    }
+
+    return EXIT_SUCCESS;
+}
+
+bool parseArgs(int argc, char** argv)
+{
+    // if no arg is passed there is nothing to do
+    if(argc == 1)
+    {
+        printUsage();
+        return false;
+    }
+
+    // parse commandline arguments
+    for (int i = 1; i < argc; ++i)
+    {
+        // print usage on demand
+        if(!std::strcmp(argv[i], "-h") || !std::strcmp(argv[i], "--help"))
+        {
+            printUsage();
+            return false;
+        }
+        // check for archive
+        else if(!std::strcmp(argv[i], "-o") || !std::strcmp(argv[i], "--output"))
+        {
+            i++;
+            if(i < argc)
+            {
+                strArchive = argv[i];
+            }
+            else
+                return false;
+        }
+        // check for listing the archive
+        else if(!std::strcmp(argv[i], "-l") || !std::strcmp(argv[i], "--list"))
+        {
+            bList = true;
+        }
+        // everything else is a ROM or a directory of ROMs
+        else
+        {
+            inputs.push_back(argv[i]);
+        }
+    }
+
+    return true;
+}
+
+void printUsage()
+{
+    printf( "Usage: chip8pack [OPTION]... [ROM|DIR]...\n");
+    printf( "Packs ROMs and all files in directories into one archive, which chip8-emulate loads ROMs from by name (-x).\n");
+    printf( "\nOptions:\n");
+    printf( "-h --help                                print usage\n");
+    printf( "-o --output PATH/TO/ARCHIVE              set archive (default: roms.c8a)\n");
+    printf( "-l --list                                list hash, size, offset and name of all ROMs in the archive\n");
+}
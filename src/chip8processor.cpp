@@ -1,10 +1,21 @@
 #include "chip8processor.h"
-#include "utils.h"
+#include "chip8decoder.h"
+#include "chip8hash.h"
+#include "chip8output.h"
+#include "chip8quirks.h"
+#include "chip8savestate.h"
+#include "chip8zobrist.h"
 #include <bits/stdint-uintn.h>
+#include <algorithm>
+#include <ctime>
 #include <cstdlib>
 #include <cstring>
+#include <fcntl.h>
 #include <stdio.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 chip8processor::~chip8processor()
 {
@@ -13,9 +24,12 @@ chip8processor::~chip8processor()
     delete[] V;
 }
 
-chip8processor::chip8processor()
+chip8processor::chip8processor(bool _quiet)
     : memory{new uint8_t[4096]}, V{new uint8_t[16]}, stack{new uint16_t[16]},
-      PC{0x200}, SP{0}, command{0x0000}, I{0x000}, ST{0}, DT{0}, running{true}
+      PC{0x200}, SP{0}, command{0x0000}, I{0x000}, ST{0}, DT{0}, lenProgram{0},
+      display{}, dirtyRows{0xFFFFFFFF}, dirtyCols{0xFF}, rng{1}, keys{0}, quirks{chip8quirks::CLIP}, romHash{0},
+      memoryHash{0}, detectCycles{true},
+      cycleMark{0}, cycleMarkPC{0}, cycleSteps{0}, cyclePower{1}, cyclePeriod{0}, running{true}
 {
   // regular CHIP-8 machines run 4K of memory
   memset(memory, 0, sizeof(uint8_t) * 4096);
@@ -24,19 +38,22 @@ chip8processor::chip8processor()
   // CHIP-8 allowed for maximal 16 nested subroutine calls
   // the stack is not allowed for general purpose usage
   memset(stack, 0, sizeof(uint16_t) * 16);
-  // seed random generator
-  time_t t;
-  srand((unsigned int)time(&t));
+  // seed random generator, the generator is part of the machine s.t. saved states continue identically
+  seed((uint32_t)time(nullptr));
+  memoryHash = hash_memory();
 
   // TODO load fonts in memory at location [0x000, 0x200[
 
-  printf("CHIP-8 System initialized successfully\n");
+  if(!_quiet) printf("CHIP-8 System initialized successfully\n");
 }
 
 chip8processor::chip8processor(const chip8processor &o)
     : memory{new uint8_t[4096]}, V{new uint8_t[16]}, stack{new uint16_t[16]},
       PC{o.PC}, SP{o.SP}, command{o.command}, I{o.I}, ST{o.ST}, DT{o.DT},
-      running{o.running}
+      lenProgram{o.lenProgram}, dirtyRows{o.dirtyRows}, dirtyCols{o.dirtyCols}, rng{o.rng}, keys{o.keys},
+      quirks{o.quirks}, romHash{o.romHash}, memoryHash{o.memoryHash},
+      detectCycles{o.detectCycles}, cycleMark{o.cycleMark}, cycleMarkPC{o.cycleMarkPC}, cycleSteps{o.cycleSteps},
+      cyclePower{o.cyclePower}, cyclePeriod{o.cyclePeriod}, running{o.running}
 {
   // regular CHIP-8 machines run 4K of memory
   std::memcpy(memory, o.memory, sizeof(uint8_t) * 4096);
@@ -45,9 +62,8 @@ chip8processor::chip8processor(const chip8processor &o)
   // CHIP-8 allowed for maximal 16 nested subroutine calls
   // the stack is not allowed for general purpose usage
   std::memcpy(stack, o.stack, sizeof(uint16_t) * 16);
-  // seed random generator
-  time_t t;
-  srand((unsigned int)time(&t));
+  std::memcpy(display, o.display, sizeof(display));
+  // NOTE the random generator is copied as well, s.t. copies run identically
 
   // TODO load fonts in memory at location [0x000, 0x200[
 }
@@ -56,8 +72,12 @@ chip8processor::chip8processor(chip8processor &&o) noexcept
     : memory{std::move(o.memory)}, V{std::move(o.V)}, stack{std::move(o.stack)},
       PC{std::move(o.PC)}, SP{std::move(o.SP)}, command{std::move(o.command)},
       I{std::move(o.I)}, ST{std::move(o.ST)}, DT{std::move(o.DT)},
-      running{std::move(o.running)}
+      lenProgram{std::move(o.lenProgram)}, dirtyRows{o.dirtyRows}, dirtyCols{o.dirtyCols}, rng{o.rng}, keys{o.keys},
+      quirks{o.quirks}, romHash{o.romHash},
+      memoryHash{o.memoryHash}, detectCycles{o.detectCycles}, cycleMark{o.cycleMark}, cycleMarkPC{o.cycleMarkPC},
+      cycleSteps{o.cycleSteps}, cyclePower{o.cyclePower}, cyclePeriod{o.cyclePeriod}, running{std::move(o.running)}
 {
+    std::memcpy(display, o.display, sizeof(display));
     o.memory = nullptr;
     o.V = nullptr;
     o.stack = nullptr;
@@ -67,14 +87,18 @@ chip8processor& chip8processor::operator=(const chip8processor &o)
 {
     if(this == &o) return *this;
 
-    delete[] memory; delete[] V; delete[] stack;
-    memory = nullptr; V = nullptr; stack = nullptr;
+    // NOTE buffers of both machines have the same size, so they are reused
     std::memcpy(memory, o.memory, sizeof(uint8_t) * 4096);
     std::memcpy(V, o.V, sizeof(uint8_t) * 16);
     std::memcpy(stack, o.stack, sizeof(uint16_t) * 16);
+    std::memcpy(display, o.display, sizeof(display));
 
     PC = o.PC; SP = o.SP; command = o.command; I = o.I;
-    ST = o.ST; DT = o.DT; running = o.running;
+    ST = o.ST; DT = o.DT; lenProgram = o.lenProgram; running = o.running;
+    rng = o.rng; keys = o.keys; quirks = o.quirks; romHash = o.romHash; memoryHash = o.memoryHash;
+    dirtyRows = o.dirtyRows; dirtyCols = o.dirtyCols;
+    detectCycles = o.detectCycles; cycleMark = o.cycleMark; cycleMarkPC = o.cycleMarkPC; cycleSteps = o.cycleSteps;
+    cyclePower = o.cyclePower; cyclePeriod = o.cyclePeriod;
 
     return *this;
 }
@@ -89,49 +113,185 @@ chip8processor &chip8processor::operator=(chip8processor &&o) noexcept
 
     PC = std::move(o.PC); SP = std::move(o.SP); command = std::move(o.command);
     I = std::move(o.I); ST = std::move(o.ST); DT = std::move(o.DT);
-    running = std::move(o.running);
+    lenProgram = std::move(o.lenProgram); running = std::move(o.running);
+    std::memcpy(display, o.display, sizeof(display));
+    rng = o.rng; keys = o.keys; quirks = o.quirks; romHash = o.romHash; memoryHash = o.memoryHash;
+    dirtyRows = o.dirtyRows; dirtyCols = o.dirtyCols;
+    detectCycles = o.detectCycles; cycleMark = o.cycleMark; cycleMarkPC = o.cycleMarkPC; cycleSteps = o.cycleSteps;
+    cyclePower = o.cyclePower; cyclePeriod = o.cyclePeriod;
 
     return *this;
 }
 
 int chip8processor::load_ROM(std::string _filename) {
-  // open file stream
-  FILE *pfRom;
-  pfRom = fopen(_filename.c_str(), "rb");
-  if (!pfRom) {
+  // map file instead of reading it through stdio, the only copy made is into CHIP-8 memory
+  int fd = open(_filename.c_str(), O_RDONLY);
+  if (fd < 0) {
     printf("couldn't open file \"%s\"\n", _filename.c_str());
     return -1;
   }
-
-  // get length of file
-  fseek(pfRom, 0L, SEEK_END);
-  size_t nBytesFile = ftell(pfRom);
-  fseek(pfRom, 0L, SEEK_SET);
-
-  // copy rom bytes into CHIP-8 memory starting from address 0x200
-  size_t nRead = fread(memory + 0x200, sizeof(uint8_t), nBytesFile, pfRom);
-  if (nRead != nBytesFile) {
-    printf("number bytes read from file (%li) differs from file size (%li)\n",
-           nRead, nBytesFile);
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    printf("couldn't stat file \"%s\"\n", _filename.c_str());
+    close(fd);
+    return -1;
+  }
+  size_t nBytesFile = st.st_size;
+  if (nBytesFile > 0x1000 - 0x200) {
+    printf("ROM \"%s\" doesn't fit into CHIP-8 memory (%zu bytes)\n",
+           _filename.c_str(), nBytesFile);
+    close(fd);
     return -1;
   }
 
-  // close file stream
-  fclose(pfRom);
+  // copy rom bytes into CHIP-8 memory starting from address 0x200
+  // NOTE empty files can't be mapped, but there is nothing to copy anyway
+  if (nBytesFile > 0) {
+    void *p = mmap(nullptr, nBytesFile, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (p == MAP_FAILED) {
+      printf("couldn't map file \"%s\"\n", _filename.c_str());
+      close(fd);
+      return -1;
+    }
+    std::memcpy(memory + 0x200, p, nBytesFile);
+    munmap(p, nBytesFile);
+  }
+  close(fd);
 
   // print name of ROM just loaded
-  std::set<char> delim{'/'};
-  std::vector<std::string> path;
-  splitpath(_filename, path, delim);
-  printf("load ROM \"%s\"\n", path.back().c_str());
+  size_t slash = _filename.rfind('/');
+  printf("load ROM \"%s\"\n", _filename.c_str() + (slash == std::string::npos ? 0 : slash + 1));
 
   // return size of file in bytes
+  lenProgram = nBytesFile;
+  romHash = chip8hash(memory + 0x200, lenProgram);
+  memoryHash = hash_memory();
+  restart_cycle_detection();
   return nBytesFile;
 }
 
+int chip8processor::load_program(const uint8_t *_data, size_t _len)
+{
+    // programs start at address 0x200 and must fit into the 4K of memory
+    if(_len > 0x1000 - 0x200)
+    {
+        fprintf(stderr, "ERROR: program doesn't fit into CHIP-8 memory (%zu bytes)\n", _len);
+        return -1;
+    }
+    std::memcpy(memory + 0x200, _data, _len);
+    lenProgram = _len;
+    romHash = chip8hash(memory + 0x200, lenProgram);
+    memoryHash = hash_memory();
+    restart_cycle_detection();
+    return _len;
+}
+
+int chip8processor::load_machinecode(const std::vector<uint16_t> &_code)
+{
+    // machine code of chip8assembler is in host order, CHIP-8 memory is big endian
+    if(_code.size() * 2 > 0x1000 - 0x200)
+    {
+        fprintf(stderr, "ERROR: program doesn't fit into CHIP-8 memory (%zu bytes)\n", _code.size() * 2);
+        return -1;
+    }
+    for(size_t i=0; i<_code.size(); ++i)
+    {
+        memory[0x200 + 2*i]     = _code[i] >> 8;
+        memory[0x200 + 2*i + 1] = _code[i] & 0x00FF;
+    }
+    lenProgram = _code.size() * 2;
+    romHash = chip8hash(memory + 0x200, lenProgram);
+    memoryHash = hash_memory();
+    restart_cycle_detection();
+    return lenProgram;
+}
+
+int chip8processor::patch_machinecode(const std::vector<uint16_t> &_code, const std::function<int(uint16_t)> &_relocate)
+{
+    // replace program while the emulation keeps running, registers, I, timers and memory outside of the program stay untouched
+    uint16_t lenOld = lenProgram;
+    if(load_machinecode(_code) < 0)
+        return -1;
+    // clear remains of the old program if the new one is shorter
+    if(lenOld > lenProgram)
+        memset(memory + 0x200 + lenProgram, 0, lenOld - lenProgram);
+
+    // move PC and return addresses on stack to the same spots in the new program
+    // NOTE if any of them has no counterpart in the new program the machine restarts the program, but keeps its registers
+    int newPC = _relocate(PC);
+    bool relocated = newPC >= 0;
+    uint16_t newStack[16];
+    for(int i=0; relocated && i<SP; ++i)
+    {
+        int addr = _relocate(stack[i]);
+        relocated = addr >= 0;
+        newStack[i] = addr;
+    }
+    if(!relocated)
+    {
+        PC = 0x200; SP = 0;
+        memoryHash = hash_memory();
+        return 0;
+    }
+    PC = newPC;
+    std::memcpy(stack, newStack, sizeof(uint16_t) * SP);
+    memoryHash = hash_memory();
+    return 1;
+}
+
 bool chip8processor::is_running()
 {
-    return running; // TODO figure out when to end emulation
+    // NOTE besides errors emulation ends in an infinite loop, which is found by comparing state hashes (see exec_command)
+    return running;
+}
+
+uint64_t chip8processor::state_hash() const
+{
+    return memoryHash ^ hash_registers();
+}
+
+uint64_t chip8processor::hash_registers() const
+{
+    // registers change with almost every command, so they are hashed on demand instead of after every command
+    uint64_t h = 0;
+    for(uint32_t i = 0; i < 16; ++i)
+        h ^= chip8zobrist::key(chip8zobrist::V + i, V[i]);
+    h ^= chip8zobrist::key(chip8zobrist::PC, PC) ^ chip8zobrist::key(chip8zobrist::I, I);
+    h ^= chip8zobrist::key(chip8zobrist::SP, SP) ^ chip8zobrist::key(chip8zobrist::DT, DT);
+    h ^= chip8zobrist::key(chip8zobrist::ST, ST) ^ chip8zobrist::key(chip8zobrist::RNG, rng);
+    return h;
+}
+
+uint64_t chip8processor::hash_memory() const
+{
+    uint64_t h = 0;
+    for(uint32_t a = 0; a < 4096; ++a)
+        h ^= chip8zobrist::key(chip8zobrist::RAM + a, memory[a]);
+    for(uint32_t i = 0; i < 16; ++i)
+        h ^= chip8zobrist::key(chip8zobrist::STACK + i, stack[i]);
+    for(uint32_t r = 0; r < 32; ++r)
+        h ^= chip8zobrist::key(chip8zobrist::DISPLAY + r, display[r]);
+    return h;
+}
+
+void chip8processor::restart_cycle_detection()
+{
+    cycleMark = state_hash(); cycleMarkPC = PC; cycleSteps = 0; cyclePower = 1; cyclePeriod = 0;
+}
+
+void chip8processor::set_keys(uint16_t _keys)
+{
+    // NOTE keys are input rather than state, so they aren't hashed, but a state only repeats for good while they stay
+    if(_keys != keys)
+        restart_cycle_detection();
+    keys = _keys;
+}
+
+void chip8processor::poke(uint16_t addr, uint8_t value)
+{
+    addr &= 0xFFF;
+    memoryHash ^= chip8zobrist::key(chip8zobrist::RAM + addr, memory[addr]) ^ chip8zobrist::key(chip8zobrist::RAM + addr, value);
+    memory[addr] = value;
 }
 
 int chip8processor::fetch_command()
@@ -163,461 +323,342 @@ int chip8processor::exec_command()
         return -1;
     }
 
-    // read opcode (most significant nibble at chip-8)
-    uint8_t opcode = command >> 12;
+    // decode command, this is a single table lookup
+    const chip8decoder::instruction ins = chip8decoder::decode(command);
+    const uint8_t x = ins.x, y = ins.y;
 
-    // handle each opcode
-    switch(opcode)
-    {
-    case 0x0:
+    // handle each command
+    switch(ins.k)
     {
-        if(command == 0x00E0)
-            // TODO cmd: CLS
-            fprintf(stderr, "WARNING opcode not implemented: 0x%03x: CLS\n", PC-2);
-        else if(command == 0x00EE)
+    case chip8decoder::CLS:
+        // cmd: CLS
+        for(uint32_t r = 0; r < 32; ++r)
         {
-            // cmd: RET
-            if(PC > 0)
-                PC = stack[--SP];
-            else
-            {
-                fprintf(stderr, "ERROR at 0x%03x: stack is empty, but it is tried to return from subroutine. Command: RET\n", PC-2);
-                running = false;
-                return -1;
-            }
+            if(!display[r]) continue;
+            memoryHash ^= chip8zobrist::key(chip8zobrist::DISPLAY + r, display[r]) ^ chip8zobrist::key(chip8zobrist::DISPLAY + r, 0);
+            dirtyRows |= 1u << r;
+            dirtyCols = 0xFF;
         }
+        memset(display, 0, sizeof(display));
+        break;
+    case chip8decoder::RET:
+        // cmd: RET
+        if(SP > 0)
+            PC = stack[--SP];
         else
         {
-            // cmd: SYS addr
-            // NOTE this opcode was only used on hardware implementations of CHIP8, this emulator will ignore it
-            uint16_t addr = command & 0x0FFF;
-            fprintf(stderr, "WARNING opcode not implemented: 0x%03x: SYS %03x\n", PC-2, addr);
+            fprintf(stderr, "ERROR at 0x%03x: stack is empty, but it is tried to return from subroutine. Command: RET\n", PC-2);
+            running = false;
+            return -1;
         }
         break;
-    }
-    case 0x1:
-    {
+    case chip8decoder::SYS:
+        // cmd: SYS addr
+        // NOTE this opcode was only used on hardware implementations of CHIP8, this emulator will ignore it
+        fprintf(stderr, "WARNING opcode not implemented: 0x%03x: SYS %03x\n", PC-2, ins.nnn);
+        break;
+    case chip8decoder::JP_addr:
         // cmd: JP addr
         // NOTE memory is not yet checked -> make it robust for segfaults
-        uint16_t addr = command & 0x0FFF;
-        PC = addr;
+        PC = ins.nnn;
         break;
-    }
-    case 0x2:
-    {
+    case chip8decoder::CALL_addr:
         // cmd: CALL addr
         // NOTE memory is not yet checked -> make it robust for segfaults
-        uint16_t addr = command & 0x0FFF;
+        if(SP >= 16)
+        {
+            fprintf(stderr, "ERROR at 0x%03x: stack overflow, more than 16 nested subroutine calls. Command: CALL\n", PC-2);
+            running = false;
+            return -1;
+        }
+        memoryHash ^= chip8zobrist::key(chip8zobrist::STACK + SP, stack[SP]) ^ chip8zobrist::key(chip8zobrist::STACK + SP, PC);
         stack[SP++] = PC; // NOTE PC already points to next command (see chip8processor::fetch_command())
-        PC = addr;
+        PC = ins.nnn;
         break;
-    }
-    case 0x3:
-    {
+    case chip8decoder::SE_Vx_byte:
         // cmd: SE Vx, byte
-        // NOTE memory is not yet checked -> make it robust for segfaults
-        uint8_t byte = command & 0x00FF;
-        uint8_t x  = (command & 0x0F00) >> 8;
-        if(V[x] == byte) PC += 2;
+        if(V[x] == ins.kk) PC += 2;
         break;
-    }
-    case 0x4:
-    {
+    case chip8decoder::SNE_Vx_byte:
         // cmd: SNE Vx, byte
-        // NOTE memory is not yet checked -> make it robust for segfaults
-        uint8_t byte = command & 0x00FF;
-        uint8_t x  = (command & 0x0F00) >> 8;
-        if(V[x] != byte) PC += 2;
+        if(V[x] != ins.kk) PC += 2;
         break;
-    }
-    case 0x5:
-    {
+    case chip8decoder::SE_Vx_Vy:
         // cmd: SE Vx, Vy
-        // NOTE memory is not yet checked -> make it robust for segfaults
-        uint8_t x = (command & 0x0F00) >> 8;
-        uint8_t y  = (command & 0x00F0) >> 4;
         if(V[x] == V[y]) PC += 2;
         break;
-    }
-    case 0x6:
-    {
+    case chip8decoder::LD_Vx_byte:
         // cmd: LD Vx, byte
-        uint8_t byte = command & 0x00FF;
-        uint8_t x  = (command & 0x0F00) >> 8;
-        V[x] = byte;
+        V[x] = ins.kk;
         break;
-    }
-    case 0x7:
-    {
+    case chip8decoder::ADD_Vx_byte:
         // cmd: ADD Vx, byte
         // NOTE according to all specs I could find with this ADD operation the carry flag is not changed
-        uint8_t byte = command & 0x00FF;
-        uint8_t x  = (command & 0x0F00) >> 8;
-        V[x] += byte;
+        V[x] += ins.kk;
         break;
-    }
-    case 0x8:
+    case chip8decoder::LD_Vx_Vy:
+        // cmd: LD Vx, Vy
+        V[x] = V[y];
+        break;
+    case chip8decoder::OR_Vx_Vy:
+        // cmd: OR Vx, Vy
+        V[x] |= V[y];
+        if(quirks & chip8quirks::VF_RESET) V[0xF] = 0;
+        break;
+    case chip8decoder::AND_Vx_Vy:
+        // cmd: AND Vx, Vy
+        V[x] &= V[y];
+        if(quirks & chip8quirks::VF_RESET) V[0xF] = 0;
+        break;
+    case chip8decoder::XOR_Vx_Vy:
+        // cmd: XOR Vx, Vy
+        V[x] ^= V[y];
+        if(quirks & chip8quirks::VF_RESET) V[0xF] = 0;
+        break;
+    case chip8decoder::ADD_Vx_Vy:
     {
-        uint8_t x = (command & 0x0F00) >> 8;
-        uint8_t y = (command & 0x00F0) >> 4;
-        uint8_t nibble = command & 0x000F;
-        switch(nibble)
-        {
-        case 0x0:
-            // cmd: LD Vx, Vy
-            V[x] = V[y];
-            break;
-        case 0x1:
-            // cmd: OR Vx, Vy
-            V[x] |= V[y];
-            break;
-        case 0x2:
-            // cmd: AND Vx, Vy
-            V[x] &= V[y];
-            break;
-        case 0x3:
-            // cmd: XOR Vx, Vy
-            V[x] ^= V[y];
-            break;
-        case 0x4:
-        {
-            // cmd: ADD Vx, Vy
-            uint16_t tmp = V[x] + V[y];
-            if(tmp > 255)
-                V[0xF] = 1;
-            else
-                V[0xF] = 0;
-            V[x] = tmp;
-            break;
-        }
-        case 0x5:
-            // cmd: SUB Vx, Vy
-            if(V[x] > V[y])
-                V[0xF] = 1;
-            else
-                V[0xF] = 0;
-            V[x] -= V[y];
-            break;
-        case 0x6:
-            // cmd: SHR Vx {, Vy}
-            V[0xF] = V[x] & 0x01;
-            V[x] >>= 1;
-            break;
-        case 0x7:
-            // cmd: SUBN Vx, Vy
-            if(V[y] > V[x])
-                V[0xF] = 1;
-            else
-                V[0xF] = 0;
-            V[x] = V[y] - V[x];
-            break;
-        case 0xE:
-            // cmd: SHL Vx {, Vy}
-            V[0xF] = (V[x] & 0x80) >> 7;
-            V[x] <<= 1;
-            break;
-        default:
-            fprintf(stderr, "WARNING unknown opcode: 0x%03x: %04x\n", PC-2, command);
-        }
+        // cmd: ADD Vx, Vy
+        uint16_t tmp = V[x] + V[y];
+        if(tmp > 255)
+            V[0xF] = 1;
+        else
+            V[0xF] = 0;
+        V[x] = tmp;
         break;
     }
-    case 0x9:
-    {
+    case chip8decoder::SUB_Vx_Vy:
+        // cmd: SUB Vx, Vy
+        if(V[x] > V[y])
+            V[0xF] = 1;
+        else
+            V[0xF] = 0;
+        V[x] -= V[y];
+        break;
+    case chip8decoder::SHR_Vx:
+        // cmd: SHR Vx {, Vy}
+        if(quirks & chip8quirks::SHIFT_VY) V[x] = V[y];
+        V[0xF] = V[x] & 0x01;
+        V[x] >>= 1;
+        break;
+    case chip8decoder::SUBN_Vx_Vy:
+        // cmd: SUBN Vx, Vy
+        if(V[y] > V[x])
+            V[0xF] = 1;
+        else
+            V[0xF] = 0;
+        V[x] = V[y] - V[x];
+        break;
+    case chip8decoder::SHL_Vx:
+        // cmd: SHL Vx {, Vy}
+        if(quirks & chip8quirks::SHIFT_VY) V[x] = V[y];
+        V[0xF] = (V[x] & 0x80) >> 7;
+        V[x] <<= 1;
+        break;
+    case chip8decoder::SNE_Vx_Vy:
         // cmd: SNE Vx, Vy
-        // NOTE memory is not yet checked -> make it robust for segfaults
-        uint8_t x = (command & 0x0F00) >> 8;
-        uint8_t y  = (command & 0x00F0) >> 4;
         if(V[x] != V[y]) PC += 2;
         break;
-    }
-    case 0xA:
-    {
+    case chip8decoder::LD_I_addr:
         // cmd LD I, addr
         // NOTE memory is not yet checked -> make it robust for segfaults
-        uint16_t addr = command & 0x0FFF;
-        I = addr;
+        I = ins.nnn;
         break;
-    }
-    case 0xB:
-    {
+    case chip8decoder::JP_V0_addr:
         // cmd: JP V0, addr
         // NOTE memory is not yet checked -> make it robust for segfaults
-        uint16_t addr = command & 0x0FFF;
-        PC = V[0] + addr;
+        PC = V[quirks & chip8quirks::JUMP_VX ? x : 0] + ins.nnn;
         break;
-    }
-    case 0xC:
+    case chip8decoder::RND_Vx_byte:
     {
         // cmd: RND Vx, byte
-        uint8_t byte = command & 0x00FF;
-        uint8_t x   = (command & 0x0F00) >> 8;
-        uint8_t rnd = rand() % 255;
-        V[x] = rnd & byte;
+        // NOTE xorshift32, its state is saved along with the machine
+        rng ^= rng << 13; rng ^= rng >> 17; rng ^= rng << 5;
+        V[x] = (rng >> 24) & ins.kk;
         break;
     }
-    case 0xD:
+    case chip8decoder::DRW_Vx_Vy_nibble:
     {
-        // TODO cmd: DRW Vx, Vy, nibble
-        uint8_t Vx = (command & 0x0F00) >> 8;
-        uint8_t Vy = (command & 0x00F0) >> 4;
-        uint8_t nibble = command & 0x000F;
-        fprintf(stderr, "WARNING opcode not implemented: 0x%03x: DRW V%x, V%x, %x\n", PC-2, Vx, Vy, nibble);
-        break;
-    }
-    case 0xE:
-    {
-        uint8_t Vx = (command & 0x0F00) >> 8;
-        uint8_t byte = command & 0x00FF;
-        if(byte == 0x9E)
+        // cmd: DRW Vx, Vy, nibble
+        // each sprite row is moved to its column in a display row and XORed in at once, VF is set on collision
+        // NOTE the start position wraps around, the sprite itself is clipped or wrapped at the borders depending on quirks
+        const int col = V[x] % 64, row = V[y] % 32;
+        const bool clip = quirks & chip8quirks::CLIP;
+        V[0xF] = 0;
+        for(int r = 0; r < ins.n; ++r)
         {
-            // TODO cmd: SKP Vx
-            fprintf(stderr, "WARNING: opcode not implemented: 0x%03x: SKP V%x\n", PC-2, Vx);
+            if(clip && row + r >= 32) break;
+            uint64_t bits = uint64_t(memory[(I + r) & 0xFFF]) << 56;
+            bits = clip || col == 0 ? bits >> col : (bits >> col) | (bits << (64 - col));
+            uint64_t &line = display[(row + r) % 32];
+            if(line & bits) V[0xF] = 1;
+            memoryHash ^= chip8zobrist::key(chip8zobrist::DISPLAY + (row + r) % 32, line) ^
+                         chip8zobrist::key(chip8zobrist::DISPLAY + (row + r) % 32, line ^ bits);
+            line ^= bits;
+            dirtyRows |= 1u << ((row + r) % 32);
         }
-        else if(byte == 0xA1)
-        {
-            // TODO cmd: SKNP Vx
-            fprintf(stderr, "WARNING: opcode not implemented: 0x%03x: SKNP V%x\n", PC-2, Vx);
-        }
-        else
-            fprintf(stderr, "WARNING: unknown opcode: 0x%03x: %04x\n", PC-2, command);
+        // a sprite row spans at most two blocks of 8 columns
+        dirtyCols |= (1 << (col >> 3)) | (clip && col > 56 ? 0 : 1 << (((col + 7) >> 3) & 7));
         break;
     }
-    case 0xF:
-    {
-        uint8_t x = (command & 0x0F00) >> 8;
-        uint8_t byte = command & 0x00FF;
-        switch(byte)
-        {
-        case 0x07:
-            // cmd: LD Vx, DT
-            V[x] = DT;
-            break;
-        case 0x0A:
-            // TODO cmd: LD Vx, K
-            fprintf(stderr, "WARNING opcode not implemented: 0x%03x: LD V%x, K\n", PC-2, x); break;
-        case 0x15:
-            // cmd: LD DT, Vx
-            DT = V[x];
-            break;
-        case 0x18:
-            // cmd: LD ST, Vx
-            ST = V[x];
-            break;
-        case 0x1E:
-            // cmd: ADD I, Vx
-            // NOTE memory is not yet checked -> make it robust for segfaults
-            I += V[x];
-            break;
-        case 0x29:
-            // TODO cmd: LD F, Vx
-            fprintf(stderr, "WARNING opcode not implemented: 0x%03x: LD F, V%x\n", PC-2, x); break;
-        case 0x33:
-            // cmd: LD B, Vx
-            // NOTE memory is not yet checked -> make it robust for segfaults
-            memory[I]   = (V[x]-(V[x]%100))/100;
-            memory[I+1] = ((V[x]-(V[x]%10))-((V[x]-(V[x]%100))))/10;
-            memory[I+2] = V[x] % 10;
-            break;
-        case 0x55:
-            // cmd: LD [I], Vx
-            // NOTE memory is not yet checked -> make it robust for segfaults
-            for(int i=0; i<=V[x]; ++i) // TODO check wether if i<=V[x] or i<=x is correct
-                memory[I+i] = V[i];
-            break;
-        case 0x65:
-            // cmd: LD Vx, [I]
-            // NOTE memory is not yet checked -> make it robust for segfaults
-            for(int i=0; i<=V[x]; ++i) // TODO check wether if i<=V[x] or i<=x is correct
-                V[i] = memory[I+i];
-            break;
-        default:
-            fprintf(stderr, "WARNING unknown opcode: 0x%03x: %04x\n", PC-2, command);
-        }
+    case chip8decoder::SKP_Vx:
+        // cmd: SKP Vx
+        if(keys & (1 << (V[x] & 0xF))) PC += 2;
         break;
-    }
-    default:
-        fprintf(stderr, "WARNING unknown opcode: 0x%03x: %04x\n", PC-2, command);
-    }
-
-    return 0;
-}
-
-void chip8processor::disassemble_command()
-{
-    // read opcode (most significant nibble at chip-8)
-    uint8_t opcode = command >> 12;
-
-    // handle each opcode
-    switch(opcode)
-    {
-    case 0x0:
-    {
-        if(command == 0x00E0)
-            printf("0x%03x: CLS\n", PC-2);
-        else if(command == 0x00EE)
-            printf("0x%03x: RET\n", PC-2);
-        else
+    case chip8decoder::SKNP_Vx:
+        // cmd: SKNP Vx
+        if(!(keys & (1 << (V[x] & 0xF)))) PC += 2;
+        break;
+    case chip8decoder::LD_Vx_DT:
+        // cmd: LD Vx, DT
+        V[x] = DT;
+        break;
+    case chip8decoder::LD_Vx_K:
+        // cmd: LD Vx, K
+        // NOTE waiting is done by executing the command again until a key is down, s.t. timers keep running and the
+        // wait takes the same number of commands whenever the same input is replayed
+        if(!keys)
         {
-            uint16_t addr = command & 0x0FFF;
-            printf("0x%03x: SYS %03x\n", PC-2, addr);
+            PC -= 2;
+            break;
         }
+        for(uint8_t k = 0; k < 16; ++k)
+            if(keys & (1 << k))
+            {
+                V[x] = k;
+                break;
+            }
         break;
-    }
-    case 0x1:
-    {
-        uint16_t addr = command & 0x0FFF;
-        printf("0x%03x: JP %03x\n", PC-2, addr);
+    case chip8decoder::LD_DT_Vx:
+        // cmd: LD DT, Vx
+        DT = V[x];
         break;
-    }
-    case 0x2:
-    {
-        uint16_t addr = command & 0x0FFF;
-        printf("0x%03x: CALL %03x\n", PC-2, addr);
+    case chip8decoder::LD_ST_Vx:
+        // cmd: LD ST, Vx
+        ST = V[x];
         break;
-    }
-    case 0x3:
-    {
-        uint8_t byte = command & 0x00FF;
-        uint8_t Vx  = (command & 0x0F00) >> 8;
-        printf("0x%03x: SE V%x, %02x\n", PC-2, Vx, byte);
+    case chip8decoder::ADD_I_Vx:
+        // cmd: ADD I, Vx
+        // NOTE memory is not yet checked -> make it robust for segfaults
+        I += V[x];
         break;
-    }
-    case 0x4:
-    {
-        uint8_t byte = command & 0x00FF;
-        uint8_t Vx  = (command & 0x0F00) >> 8;
-        printf("0x%03x: SNE V%x, %02x\n", PC-2, Vx, byte);
+    case chip8decoder::LD_F_Vx:
+        // TODO cmd: LD F, Vx
+        fprintf(stderr, "WARNING opcode not implemented: 0x%03x: LD F, V%x\n", PC-2, x);
         break;
-    }
-    case 0x5:
-    {
-        uint8_t Vx = (command & 0x0F00) >> 8;
-        uint8_t Vy  = (command & 0x00F0) >> 4;
-        printf("0x%03x: SE V%x, V%x\n", PC-2, Vx, Vy);
+    case chip8decoder::LD_B_Vx:
+        // cmd: LD B, Vx
+        // NOTE memory is not yet checked -> make it robust for segfaults
+        poke(I,   (V[x]-(V[x]%100))/100);
+        poke(I+1, ((V[x]-(V[x]%10))-((V[x]-(V[x]%100))))/10);
+        poke(I+2, V[x] % 10);
         break;
-    }
-    case 0x6:
-    {
-        uint8_t byte = command & 0x00FF;
-        uint8_t Vx  = (command & 0x0F00) >> 8;
-        printf("0x%03x: LD V%x, %02x\n", PC-2, Vx, byte);
+    case chip8decoder::LD_I_Vx:
+        // cmd: LD [I], Vx
+        // NOTE memory is not yet checked -> make it robust for segfaults
+        for(int i=0; i<=x; ++i)
+            poke(I+i, V[i]);
+        if(quirks & chip8quirks::INCREMENT_I) I += x + 1;
         break;
-    }
-    case 0x7:
-    {
-        uint8_t byte = command & 0x00FF;
-        uint8_t Vx  = (command & 0x0F00) >> 8;
-        printf("0x%03x: ADD V%x, %02x\n", PC-2, Vx, byte);
+    case chip8decoder::LD_Vx_I:
+        // cmd: LD Vx, [I]
+        // NOTE memory is not yet checked -> make it robust for segfaults
+        for(int i=0; i<=x; ++i)
+            V[i] = memory[(I+i) & 0xFFF];
+        if(quirks & chip8quirks::INCREMENT_I) I += x + 1;
         break;
+    default:
+        fprintf(stderr, "WARNING unknown opcode: 0x%03x: %04x\n", PC-2, command);
     }
-    case 0x8:
+
+    // detect infinite loops by Brent's algorithm: the state is compared with a mark, which is moved to the current state
+    // after 1, 2, 4, ... commands, s.t. a loop is found after at most twice the commands till its second iteration ends
+    // NOTE the complete hash is only needed if PC matches, equal hashes of different states are unlikely enough
+    // (2^-64 per comparison) to not keep states for comparison
+    // NOTE running timers change the state from outside (see tick_timers()), so states only repeat for good if they are off
+    if(detectCycles)
     {
-        uint8_t Vx = (command & 0x0F00) >> 8;
-        uint8_t Vy = (command & 0x00F0) >> 4;
-        uint8_t nibble = command & 0x000F;
-        switch(nibble)
+        ++cycleSteps;
+        if(PC == cycleMarkPC && !DT && !ST && state_hash() == cycleMark)
         {
-        case 0x0:
-            printf("0x%03x: LD V%x, V%x\n", PC-2, Vx, Vy); break;
-        case 0x1:
-            printf("0x%03x: OR V%x, V%x\n", PC-2, Vx, Vy); break;
-        case 0x2:
-            printf("0x%03x: AND V%x, V%x\n", PC-2, Vx, Vy); break;
-        case 0x3:
-            printf("0x%03x: XOR V%x, V%x\n", PC-2, Vx, Vy); break;
-        case 0x4:
-            printf("0x%03x: ADD V%x, V%x\n", PC-2, Vx, Vy); break;
-        case 0x5:
-            printf("0x%03x: SUB V%x, V%x\n", PC-2, Vx, Vy); break;
-        case 0x6:
-            printf("0x%03x: SHR V%x\n", PC-2, Vx); break;
-        case 0x7:
-            printf("0x%03x: SUBN V%x, V%x\n", PC-2, Vx, Vy); break;
-        case 0xE:
-            printf("0x%03x: SHL V%x\n", PC-2, Vx); break;
-        default:
-            printf("0x%03x: unknown command %04x\n", PC-2, command);
+            cyclePeriod = cycleSteps;
+            running = false;
         }
-        break;
-    }
-    case 0x9:
-    {
-        uint8_t Vx = (command & 0x0F00) >> 8;
-        uint8_t Vy  = (command & 0x00F0) >> 4;
-        printf("0x%03x: SNE V%x, V%x\n", PC-2, Vx, Vy);
-        break;
-    }
-    case 0xA:
-    {
-        uint16_t addr = command & 0x0FFF;
-        printf("0x%03x: LD I, %03x\n", PC-2, addr);
-        break;
-    }
-    case 0xB:
-    {
-        uint16_t addr = command & 0x0FFF;
-        printf("0x%03x: JP V0, %03x\n", PC-2, addr);
-        break;
-    }
-    case 0xC:
-    {
-        uint8_t byte = command & 0x00FF;
-        uint8_t Vx   = (command & 0x0F00) >> 8;
-        printf("0x%03x: RND V%x, %02x\n", PC-2, Vx, byte);
-        break;
-    }
-    case 0xD:
-    {
-        uint8_t Vx = (command & 0x0F00) >> 8;
-        uint8_t Vy = (command & 0x00F0) >> 4;
-        uint8_t nibble = command & 0x000F;
-        printf("0x%03x: DRW V%x, V%x, %x\n", PC-2, Vx, Vy, nibble);
-        break;
-    }
-    case 0xE:
-    {
-        uint8_t Vx = (command & 0x0F00) >> 8;
-        uint8_t byte = command & 0x00FF;
-        if(byte == 0x9E)
-            printf("0x%03x: SKP V%x\n", PC-2, Vx);
-        else if(byte == 0xA1)
-            printf("0x%03x: SKNP V%x\n", PC-2, Vx);
-        else
-            printf("0x%03x: unknown command %04x\n", PC-2, command);
-        break;
-    }
-    case 0xF:
-    {
-        uint8_t Vx = (command & 0x0F00) >> 8;
-        uint8_t byte = command & 0x00FF;
-        switch(byte)
+        else if(cycleSteps == cyclePower)
         {
-        case 0x07:
-            printf("0x%03x: LD V%x, DT\n", PC-2, Vx); break;
-        case 0x0A:
-            printf("0x%03x: LD V%x, K\n", PC-2, Vx); break;
-        case 0x15:
-            printf("0x%03x: LD DT, V%x\n", PC-2, Vx); break;
-        case 0x18:
-            printf("0x%03x: LD ST, V%x\n", PC-2, Vx); break;
-        case 0x1E:
-            printf("0x%03x: ADD I, V%x\n", PC-2, Vx); break;
-        case 0x29:
-            printf("0x%03x: LD F, V%x\n", PC-2, Vx); break;
-        case 0x33:
-            printf("0x%03x: LD B, V%x\n", PC-2, Vx); break;
-        case 0x55:
-            printf("0x%03x: LD [I], V%x\n", PC-2, Vx); break;
-        case 0x65:
-            printf("0x%03x: LD V%x, [I]\n", PC-2, Vx); break;
-        default:
-            printf("0x%03x: unknown command %04x\n", PC-2, command);
+            cycleMark = state_hash();
+            cycleMarkPC = PC;
+            cyclePower *= 2;
+            cycleSteps = 0;
         }
-        break;
-    }
-    default:
-        printf("0x%03x: unknown command %04x\n", PC-2, command);
     }
+
+    return 0;
+}
+
+void chip8processor::get_state(chip8state &_state) const
+{
+    std::memcpy(_state.ram, memory, sizeof(_state.ram));
+    std::memcpy(_state.registers.V, V, sizeof(_state.registers.V));
+    _state.registers.PC = PC;
+    _state.registers.I = I;
+    _state.registers.SP = SP;
+    _state.registers.running = running;
+    _state.registers.lenProgram = lenProgram;
+    _state.registers.command = command;
+    std::memset(_state.registers.reserved, 0, sizeof(_state.registers.reserved));
+    std::memcpy(_state.stack, stack, sizeof(_state.stack));
+    _state.timers.DT = DT;
+    _state.timers.ST = ST;
+    _state.rng = rng;
+    std::memcpy(_state.framebuffer, display, sizeof(_state.framebuffer));
+}
+
+void chip8processor::copy_state(const chip8state &_state)
+{
+    std::memcpy(memory, _state.ram, sizeof(_state.ram));
+    std::memcpy(V, _state.registers.V, sizeof(_state.registers.V));
+    PC = _state.registers.PC;
+    I = _state.registers.I;
+    SP = std::min<uint8_t>(_state.registers.SP, 16);
+    running = _state.registers.running;
+    lenProgram = _state.registers.lenProgram;
+    command = _state.registers.command;
+    std::memcpy(stack, _state.stack, sizeof(_state.stack));
+    DT = _state.timers.DT;
+    ST = _state.timers.ST;
+    rng = _state.rng ? _state.rng : 1;
+    std::memcpy(display, _state.framebuffer, sizeof(display));
+    dirtyRows = 0xFFFFFFFF;
+    dirtyCols = 0xFF;
+}
+
+void chip8processor::set_state(const chip8state &_state)
+{
+    copy_state(_state);
+    memoryHash = hash_memory();
+    restart_cycle_detection();
+}
+
+void chip8processor::set_state(const chip8state &_state, uint64_t _hash)
+{
+    copy_state(_state);
+    memoryHash = _hash ^ hash_registers();
+    restart_cycle_detection();
+}
+
+void chip8processor::disassemble_command()
+{
+    // print mnemonic of current command at address of current command
+    // NOTE the line is formatted in place and handed to stdio at once, since it is interleaved with other trace output
+    char line[48] = "0x";
+    int n = 2;
+    for(int d = 2; d >= 0; --d)
+        line[n++] = "0123456789abcdef"[((PC-2) >> (4*d)) & 0xF];
+    line[n++] = ':';
+    line[n++] = ' ';
+    n += chip8decoder::format(command, line + n, sizeof(line) - n - 1);
+    line[n++] = '\n';
+    fwrite(line, 1, n, stdout);
 }
 
 void chip8processor::print_complete_memory_map(int _cols)
@@ -626,41 +667,53 @@ void chip8processor::print_complete_memory_map(int _cols)
     this->print_registers();
 }
 
+// buffer of the dumps below, shared by all processors of the process and flushed after each dump
+// NOTE tracing prints the registers after every command, a buffer of its own per dump would allocate and zero 64K each time
+static chip8output& dumpOutput()
+{
+    static chip8output out;
+    return out;
+}
+
 void chip8processor::print_memory(int _cols)
 {
-    printf("######## MEMORY MAP ########\n");
+    chip8output &out = dumpOutput();
+    out.put("######## MEMORY MAP ########\n");
     int rows = 4096/_cols;
-    for(int iy = 0; iy < rows; ++iy)
-    {
-        printf("0x%03x: ", _cols*iy);
-        for(int ix = 0; ix < _cols; ++ix)
-            printf("%02x ", memory[_cols*iy + ix]);
-        printf("\n");
-    }
+    out.hexdump(memory, rows*_cols, 0x000, _cols);
+    out.flush();
 }
 
 void chip8processor::print_registers()
 {
-    printf("######## REGISTERS ########\n");
-    printf("PC: 0x%03x\nSP: 0x%03x\nI: %i\nST: %i\nDT: %i\n", PC, SP, I, ST, DT);
+    chip8output &out = dumpOutput();
+    out.put("######## REGISTERS ########\n");
+    out.put("PC: 0x"); out.hex(PC, 3);
+    out.put("\nSP: 0x"); out.hex(SP, 3);
+    out.put("\nI: "); out.dec(I);
+    out.put("\nST: "); out.dec(ST);
+    out.put("\nDT: "); out.dec(DT);
+    out.put('\n');
     for(int i=0; i<16; ++i)
-        printf("V%x: %i |", i, V[i]);
-    printf("\n######## STACK ########\n");
+    {
+        out.put('V'); out.hex(i, 1); out.put(": "); out.dec(V[i]); out.put(" |");
+    }
+    out.put("\n######## STACK ########\n");
     for(int i=0; i<16; ++i)
-        printf("0x%03x: 0x%03x |", i, stack[i]);
-    printf("\n");
+    {
+        out.put("0x"); out.hex(i, 3); out.put(": 0x"); out.hex(stack[i], 3); out.put(" |");
+    }
+    out.put('\n');
+    out.flush();
 }
 
 void chip8processor::print_ROM(int _len, int _cols)
 {
-    printf("######## ROM CODE ########\n");
+    chip8output &out = dumpOutput();
+    out.put("######## ROM CODE ########\n");
     int rows;
     _len % _cols == 0 ? rows = _len/_cols : rows = _len/_cols + 1;
-    for(int iy = 0; iy < rows; ++iy)
-    {
-        printf("0x%03x: ", 0x200+(_cols*iy));
-        for(int ix = 0; ix < _cols; ++ix)
-            printf("%02x ", memory[0x200+(_cols*iy + ix)]);
-        printf("\n");
-    }
+    // NOTE full rows are printed, which may show memory behind the ROM
+    out.hexdump(memory + 0x200, std::min(rows*_cols, 4096 - 0x200), 0x200, _cols);
+    out.flush();
 }
@@ -0,0 +1,165 @@
+#include "chip8romarchive.h"
+#include "chip8hash.h"
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <iterator>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+bool chip8romarchive::pack(const std::vector<std::string> &files, const std::string &path)
+{
+    // read all ROMs, named by their file names
+    struct rom
+    {
+        std::string name;
+        std::vector<uint8_t> content;
+    };
+    std::vector<rom> roms(files.size());
+    for(size_t i=0; i<files.size(); ++i)
+    {
+        size_t slash = files[i].rfind('/');
+        roms[i].name = slash == std::string::npos ? files[i] : files[i].substr(slash + 1);
+        std::ifstream istream(files[i].c_str(), std::ios::binary);
+        roms[i].content.assign(std::istreambuf_iterator<char>(istream), std::istreambuf_iterator<char>());
+        if(!istream.good() && !istream.eof())
+        {
+            fprintf(stderr, "ERROR: couldn't read file \"%s\"\n", files[i].c_str());
+            return false;
+        }
+    }
+    std::sort(roms.begin(), roms.end(), [](const rom &a, const rom &b) { return a.name < b.name; });
+    for(size_t i=1; i<roms.size(); ++i)
+    {
+        if(roms[i].name == roms[i-1].name)
+        {
+            fprintf(stderr, "ERROR: ROM \"%s\" is given twice\n", roms[i].name.c_str());
+            return false;
+        }
+    }
+
+    // assemble string table, offset 0 is the empty string
+    std::string strings(1, '\0');
+    std::vector<entry> entryTable(roms.size());
+    for(size_t i=0; i<roms.size(); ++i)
+    {
+        entryTable[i].name = strings.size();
+        strings += roms[i].name;
+        strings += '\0';
+    }
+
+    header hdr;
+    std::memcpy(hdr.magic, "C8RA", 4);
+    hdr.version = VERSION;
+    hdr.nEntries = entryTable.size();
+    hdr.offEntries = sizeof(header);
+    hdr.offStrings = hdr.offEntries + sizeof(entry) * entryTable.size();
+    hdr.lenStrings = strings.size();
+    uint64_t offset = hdr.offStrings + hdr.lenStrings;
+    for(size_t i=0; i<roms.size(); ++i)
+    {
+        entryTable[i].size = roms[i].content.size();
+        entryTable[i].hash = chip8hash(roms[i].content.data(), roms[i].content.size());
+        entryTable[i].offset = offset;
+        offset += roms[i].content.size();
+    }
+
+    // write next to the archive and replace it at once, s.t. running instances keep their mapping of the old one
+    std::string tmp = path + ".tmp";
+    FILE *pFile = fopen(tmp.c_str(), "wb");
+    if(!pFile)
+    {
+        fprintf(stderr, "ERROR: couldn't write archive \"%s\"\n", path.c_str());
+        return false;
+    }
+    bool ok = fwrite(&hdr, sizeof(header), 1, pFile) == 1;
+    ok = ok && fwrite(entryTable.data(), sizeof(entry), entryTable.size(), pFile) == entryTable.size();
+    ok = ok && fwrite(strings.data(), 1, strings.size(), pFile) == strings.size();
+    for(size_t i=0; ok && i<roms.size(); ++i)
+        ok = fwrite(roms[i].content.data(), 1, roms[i].content.size(), pFile) == roms[i].content.size();
+    ok = fclose(pFile) == 0 && ok;
+    ok = ok && rename(tmp.c_str(), path.c_str()) == 0;
+    if(!ok)
+    {
+        fprintf(stderr, "ERROR: couldn't write archive \"%s\"\n", path.c_str());
+        remove(tmp.c_str());
+    }
+    return ok;
+}
+
+chip8romarchive::chip8romarchive()
+    : data{nullptr}, length{0}, hdr{nullptr}, entries{nullptr}, strings{nullptr}
+{
+}
+
+chip8romarchive::~chip8romarchive()
+{
+    close();
+}
+
+bool chip8romarchive::open(const std::string &path, bool verbose)
+{
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if(fd < 0)
+    {
+        if(verbose) fprintf(stderr, "ERROR: couldn't open archive \"%s\"\n", path.c_str());
+        return false;
+    }
+    struct stat st;
+    if(fstat(fd, &st) != 0 || size_t(st.st_size) < sizeof(header))
+    {
+        if(verbose) fprintf(stderr, "ERROR: \"%s\" is no valid archive\n", path.c_str());
+        ::close(fd);
+        return false;
+    }
+    void *p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd); // NOTE the mapping stays valid after closing the file
+    if(p == MAP_FAILED)
+    {
+        if(verbose) fprintf(stderr, "ERROR: couldn't map archive \"%s\"\n", path.c_str());
+        return false;
+    }
+    data = static_cast<const uint8_t*>(p);
+    length = st.st_size;
+
+    // validate header and ranges, s.t. all later lookups can go without checks
+    hdr = reinterpret_cast<const header*>(data);
+    bool valid = !std::memcmp(hdr->magic, "C8RA", 4) && hdr->version == VERSION &&
+                 hdr->offEntries + uint64_t(sizeof(entry)) * hdr->nEntries <= length &&
+                 hdr->offStrings + uint64_t(hdr->lenStrings) <= length && hdr->lenStrings > 0 &&
+                 data[hdr->offStrings + hdr->lenStrings - 1] == '\0';
+    entries = reinterpret_cast<const entry*>(data + hdr->offEntries);
+    for(uint32_t i=0; valid && i<hdr->nEntries; ++i)
+        valid = entries[i].name < hdr->lenStrings && entries[i].offset <= length &&
+                entries[i].size <= length - entries[i].offset;
+    if(!valid)
+    {
+        if(verbose) fprintf(stderr, "ERROR: \"%s\" is no valid archive\n", path.c_str());
+        close();
+        return false;
+    }
+    strings = reinterpret_cast<const char*>(data + hdr->offStrings);
+    return true;
+}
+
+void chip8romarchive::close()
+{
+    if(data)
+        munmap(const_cast<uint8_t*>(data), length);
+    data = nullptr; length = 0; hdr = nullptr; entries = nullptr; strings = nullptr;
+}
+
+const chip8romarchive::entry* chip8romarchive::find(const std::string &name) const
+{
+    if(!is_open())
+        return nullptr;
+    const entry *end = entries + hdr->nEntries;
+    const entry *it = std::lower_bound(entries, end, name, [this](const entry &e, const std::string &n) {
+        return std::strcmp(this->name(e), n.c_str()) < 0;
+    });
+    return it != end && name == this->name(*it) ? it : nullptr;
+}
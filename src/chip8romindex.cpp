@@ -0,0 +1,360 @@
+#include "chip8romindex.h"
+#include "chip8analyzer.h"
+#include "chip8hash.h"
+#include "chip8parallel.h"
+#include "chip8quirks.h"
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <iterator>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// max. number of commands hashed per subroutine
+static const uint16_t nMaxPattern = 256;
+
+
+static bool isSkip(chip8decoder::kind k)
+{
+    return k == chip8decoder::SE_Vx_byte || k == chip8decoder::SNE_Vx_byte || k == chip8decoder::SE_Vx_Vy ||
+           k == chip8decoder::SNE_Vx_Vy || k == chip8decoder::SKP_Vx || k == chip8decoder::SKNP_Vx;
+}
+
+static uint64_t pattern(const chip8analyzer &a, uint32_t entry, uint16_t &n)
+{
+    // hash commands from entry till the first RET or JP which isn't skipped
+    // NOTE addresses are masked out, s.t. the same subroutine is found wherever it is placed
+    uint64_t h = chip8hashOffset;
+    bool skipped = false;
+    n = 0;
+    for(uint32_t addr = entry; n < nMaxPattern && (a.flags(addr) & chip8analyzer::CODE); addr += a.length(addr))
+    {
+        uint16_t w = a.word(addr);
+        chip8decoder::kind k = chip8decoder::decode(w).k;
+        bool jumps = k == chip8decoder::JP_addr || k == chip8decoder::JP_V0_addr;
+        if(jumps || k == chip8decoder::CALL_addr || k == chip8decoder::LD_I_addr)
+            w &= 0xF000;
+        uint8_t bytes[2] = { uint8_t(w >> 8), uint8_t(w & 0xFF) };
+        h = chip8hash(bytes, 2, h);
+        n++;
+        if(!skipped && (jumps || k == chip8decoder::RET || chip8decoder::classifyExtension(w) == chip8decoder::EXIT))
+            break;
+        skipped = isSkip(k);
+    }
+    return h;
+}
+
+bool chip8romindex::analyze(const uint8_t *data, size_t len, rom &r, std::vector<uint16_t> &words,
+                            std::vector<subroutine> &subroutines)
+{
+    chip8analyzer a(data, len);
+    a.analyze();
+
+    std::fill(std::begin(r.histogram), std::end(r.histogram), 0);
+    r.extensions = 0;
+    r.codeBytes = a.codeBytes;
+    r.dataBytes = a.dataBytes;
+    words.clear();
+    subroutines.clear();
+
+    // commands reached from the entry point
+    bool shiftsInPlace = false;
+    for(uint32_t addr = 0x200; addr < 0x200 + len; ++addr)
+    {
+        uint8_t f = a.flags(addr);
+        if(!(f & chip8analyzer::CODE))
+            continue;
+        uint16_t w = a.word(addr);
+        chip8decoder::instruction ins = chip8decoder::decode(w);
+        chip8decoder::extension ext = chip8decoder::classifyExtension(w);
+        if(ext != chip8decoder::NO_EXTENSION)
+            r.extensions |= 1u << ext;
+        else
+            r.histogram[ins.k]++;
+        // SHR Vx as written by chip8assembler leaves y at 0, which only makes sense if Vx is shifted in place
+        if((ins.k == chip8decoder::SHR_Vx || ins.k == chip8decoder::SHL_Vx) && ins.x != 0 && ins.y == 0)
+            shiftsInPlace = true;
+        words.push_back(w);
+        if(f & chip8analyzer::FUNCTION)
+        {
+            subroutine s{0, uint16_t(addr), 0, 0};
+            s.pattern = pattern(a, addr, s.length);
+            subroutines.push_back(s);
+        }
+    }
+    std::sort(words.begin(), words.end());
+    words.erase(std::unique(words.begin(), words.end()), words.end());
+
+    // recommend the quirks of the platform whose extensions are used
+    bool xochip = false;
+    for(int e = 1; e < chip8decoder::NUM_EXTENSIONS; ++e)
+        xochip = xochip || ((r.extensions >> e & 1) && chip8decoder::isXOCHIP(chip8decoder::extension(e)));
+    if(xochip)
+        r.quirks = chip8quirks::XOCHIP;
+    else if(r.extensions)
+        r.quirks = chip8quirks::SCHIP;
+    else
+        r.quirks = chip8quirks::CHIP8 & (shiftsInPlace ? ~chip8quirks::SHIFT_VY : 0xFF);
+    return true;
+}
+
+void chip8romindex::builder::scan(const std::vector<std::string> &files, const chip8romindex *previous)
+{
+    entries.clear();
+    entries.resize(files.size());
+    for(size_t i=0; i<files.size(); ++i)
+        entries[i].name = files[i];
+
+    // each worker analyzes files into their entries, reusing its buffer for the contents
+    auto worker = [&](chip8parallel::cursor &c) {
+        std::vector<uint8_t> content;
+        for(size_t i; c.next(i); )
+        {
+            entry &e = entries[i];
+            std::memset(&e.r, 0, sizeof(rom));
+            struct stat st;
+            if(stat(e.name.c_str(), &st) != 0)
+            {
+                e.error = "ERROR: couldn't stat file \"" + e.name + "\"\n";
+                continue;
+            }
+            e.r.size = st.st_size;
+            e.r.mtime = int64_t(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+
+            // take over entries of unchanged files
+            const rom *old = previous ? previous->find(e.name) : nullptr;
+            if(old && old->size == e.r.size && old->mtime == e.r.mtime)
+            {
+                e.r = *old;
+                e.words.assign(previous->words(*old), previous->words(*old) + old->nWords);
+                e.subroutines.assign(previous->subroutines(*old), previous->subroutines(*old) + old->nSubroutines);
+                e.ok = e.reused = true;
+                continue;
+            }
+
+            std::ifstream istream(e.name.c_str(), std::ios::binary);
+            content.assign(std::istreambuf_iterator<char>(istream), std::istreambuf_iterator<char>());
+            if(!istream.good() && !istream.eof())
+            {
+                e.error = "ERROR: couldn't read file \"" + e.name + "\"\n";
+                continue;
+            }
+            if(content.empty() || content.size() > 0x10000 - 0x200)
+            {
+                e.error = "ERROR: \"" + e.name + "\" is empty or doesn't fit into 64K of memory\n";
+                continue;
+            }
+            e.r.hash = chip8hash(content.data(), content.size());
+            e.ok = analyze(content.data(), content.size(), e.r, e.words, e.subroutines);
+        }
+    };
+
+    chip8parallel::run(chip8parallel::threads(nthreads, entries.size()), entries.size(), worker);
+
+    // roms are kept sorted by name, s.t. lookups can bisect
+    std::sort(entries.begin(), entries.end(), [](const entry &a, const entry &b) { return a.name < b.name; });
+    nScanned = nReused = nFailed = 0;
+    errors.clear();
+    for(const entry &e : entries)
+    {
+        if(!e.ok)
+        {
+            nFailed++;
+            errors += e.error;
+        }
+        else if(e.reused)
+            nReused++;
+        else
+            nScanned++;
+    }
+}
+
+bool chip8romindex::builder::write(const std::string &path) const
+{
+    // assemble string table, offset 0 is the empty string
+    std::string strings(1, '\0');
+    std::vector<rom> romTable;
+    std::vector<uint16_t> wordTable;
+    std::vector<subroutine> subroutineTable;
+    for(const entry &e : entries)
+    {
+        if(!e.ok) continue;
+        rom r = e.r;
+        r.name = strings.size();
+        strings += e.name;
+        strings += '\0';
+        r.firstWord = wordTable.size();
+        r.nWords = e.words.size();
+        r.firstSubroutine = subroutineTable.size();
+        r.nSubroutines = e.subroutines.size();
+        wordTable.insert(wordTable.end(), e.words.begin(), e.words.end());
+        subroutineTable.insert(subroutineTable.end(), e.subroutines.begin(), e.subroutines.end());
+        romTable.push_back(r);
+    }
+
+    header hdr;
+    std::memcpy(hdr.magic, "C8IX", 4);
+    hdr.version = VERSION;
+    hdr.nRoms = romTable.size();
+    hdr.nWords = wordTable.size();
+    hdr.nSubroutines = subroutineTable.size();
+    hdr.offRoms = sizeof(header);
+    hdr.offSubroutines = hdr.offRoms + sizeof(rom) * romTable.size();
+    hdr.offWords = hdr.offSubroutines + sizeof(subroutine) * subroutineTable.size();
+    hdr.offStrings = hdr.offWords + sizeof(uint16_t) * wordTable.size();
+    hdr.lenStrings = strings.size();
+
+    // write next to the index and replace it at once, s.t. readers never see a partial index
+    std::string tmp = path + ".tmp";
+    FILE *pFile = fopen(tmp.c_str(), "wb");
+    if(!pFile)
+        return false;
+    bool ok = fwrite(&hdr, sizeof(header), 1, pFile) == 1;
+    ok = ok && fwrite(romTable.data(), sizeof(rom), romTable.size(), pFile) == romTable.size();
+    ok = ok && fwrite(subroutineTable.data(), sizeof(subroutine), subroutineTable.size(), pFile) == subroutineTable.size();
+    ok = ok && fwrite(wordTable.data(), sizeof(uint16_t), wordTable.size(), pFile) == wordTable.size();
+    ok = ok && fwrite(strings.data(), 1, strings.size(), pFile) == strings.size();
+    ok = fclose(pFile) == 0 && ok;
+    ok = ok && rename(tmp.c_str(), path.c_str()) == 0;
+    if(!ok)
+        remove(tmp.c_str());
+    return ok;
+}
+
+chip8romindex::chip8romindex()
+    : data{nullptr}, length{0}, hdr{nullptr}, roms{nullptr}, words_{nullptr}, subroutines_{nullptr}, strings{nullptr}
+{
+}
+
+chip8romindex::~chip8romindex()
+{
+    close();
+}
+
+bool chip8romindex::open(const std::string &path, bool verbose)
+{
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if(fd < 0)
+    {
+        if(verbose) fprintf(stderr, "ERROR: couldn't open index \"%s\"\n", path.c_str());
+        return false;
+    }
+    struct stat st;
+    if(fstat(fd, &st) != 0 || size_t(st.st_size) < sizeof(header))
+    {
+        if(verbose) fprintf(stderr, "ERROR: \"%s\" is no valid index\n", path.c_str());
+        ::close(fd);
+        return false;
+    }
+    void *p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd); // NOTE the mapping stays valid after closing the file
+    if(p == MAP_FAILED)
+    {
+        if(verbose) fprintf(stderr, "ERROR: couldn't map index \"%s\"\n", path.c_str());
+        return false;
+    }
+    data = static_cast<const uint8_t*>(p);
+    length = st.st_size;
+
+    // validate header and ranges, s.t. all later queries can go without checks
+    hdr = reinterpret_cast<const header*>(data);
+    bool valid = !std::memcmp(hdr->magic, "C8IX", 4) && hdr->version == VERSION &&
+                 hdr->offRoms + uint64_t(sizeof(rom)) * hdr->nRoms <= length &&
+                 hdr->offSubroutines + uint64_t(sizeof(subroutine)) * hdr->nSubroutines <= length &&
+                 hdr->offWords + uint64_t(sizeof(uint16_t)) * hdr->nWords <= length &&
+                 hdr->offStrings + uint64_t(hdr->lenStrings) <= length && hdr->lenStrings > 0 &&
+                 data[hdr->offStrings + hdr->lenStrings - 1] == '\0';
+    roms = reinterpret_cast<const rom*>(data + hdr->offRoms);
+    for(uint32_t i=0; valid && i<hdr->nRoms; ++i)
+        valid = roms[i].name < hdr->lenStrings &&
+                uint64_t(roms[i].firstWord) + roms[i].nWords <= hdr->nWords &&
+                uint64_t(roms[i].firstSubroutine) + roms[i].nSubroutines <= hdr->nSubroutines;
+    if(!valid)
+    {
+        if(verbose) fprintf(stderr, "ERROR: \"%s\" is no valid index\n", path.c_str());
+        close();
+        return false;
+    }
+    subroutines_ = reinterpret_cast<const subroutine*>(data + hdr->offSubroutines);
+    words_ = reinterpret_cast<const uint16_t*>(data + hdr->offWords);
+    strings = reinterpret_cast<const char*>(data + hdr->offStrings);
+    return true;
+}
+
+void chip8romindex::close()
+{
+    if(data)
+        munmap(const_cast<uint8_t*>(data), length);
+    data = nullptr; length = 0; hdr = nullptr;
+    roms = nullptr; words_ = nullptr; subroutines_ = nullptr; strings = nullptr;
+}
+
+const char* chip8romindex::name(const rom &r) const
+{
+    return strings + r.name;
+}
+
+const chip8romindex::rom* chip8romindex::find(const std::string &name) const
+{
+    if(!is_open())
+        return nullptr;
+    const rom *end = roms + hdr->nRoms;
+    const rom *it = std::lower_bound(roms, end, name, [this](const rom &r, const std::string &n) {
+        return std::strcmp(this->name(r), n.c_str()) < 0;
+    });
+    return it != end && name == this->name(*it) ? it : nullptr;
+}
+
+std::vector<const chip8romindex::rom*> chip8romindex::usingOpcode(uint16_t mask, uint16_t value) const
+{
+    std::vector<const rom*> result;
+    for(uint32_t i=0; i<size(); ++i)
+    {
+        const uint16_t *w = words(roms[i]);
+        if(std::any_of(w, w + roms[i].nWords, [=](uint16_t c) { return (c & mask) == value; }))
+            result.push_back(&roms[i]);
+    }
+    return result;
+}
+
+std::vector<const chip8romindex::rom*> chip8romindex::usingExtensions(uint32_t extensions) const
+{
+    std::vector<const rom*> result;
+    for(uint32_t i=0; i<size(); ++i)
+        if(roms[i].extensions & extensions)
+            result.push_back(&roms[i]);
+    return result;
+}
+
+std::vector<const chip8romindex::rom*> chip8romindex::withSubroutine(uint64_t pattern) const
+{
+    std::vector<const rom*> result;
+    for(uint32_t i=0; i<size(); ++i)
+    {
+        const subroutine *s = subroutines(roms[i]);
+        if(std::any_of(s, s + roms[i].nSubroutines, [=](const subroutine &x) { return x.pattern == pattern; }))
+            result.push_back(&roms[i]);
+    }
+    return result;
+}
+
+bool parseOpcodePattern(const std::string &pattern, uint16_t &mask, uint16_t &value)
+{
+    if(pattern.size() != 4)
+        return false;
+    mask = value = 0;
+    for(char c : pattern)
+    {
+        int d = -1;
+        if(c >= '0' && c <= '9') d = c - '0';
+        else if(c >= 'a' && c <= 'f') d = c - 'a' + 10;
+        else if(c >= 'A' && c <= 'F') d = c - 'A' + 10;
+        mask = (mask << 4) | (d >= 0 ? 0xF : 0x0);
+        value = (value << 4) | (d >= 0 ? d : 0x0);
+    }
+    return true;
+}
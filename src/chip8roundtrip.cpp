@@ -0,0 +1,126 @@
+#include "chip8roundtrip.h"
+#include "chip8analyzer.h"
+#include "chip8assembler.h"
+#include "chip8parallel.h"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iterator>
+#include <stdio.h>
+#include <stdlib.h>
+
+chip8roundtrip::chip8roundtrip(const std::vector<std::string> &inputs, int nthreads, bool keepSource)
+    : nthreads{nthreads}, keepSource{keepSource}, seconds{0.0}
+{
+    jobs.resize(inputs.size());
+    for(size_t i=0; i<inputs.size(); ++i)
+        jobs[i].input = inputs[i];
+    this->nthreads = chip8parallel::threads(nthreads, jobs.size());
+}
+
+bool chip8roundtrip::run()
+{
+    auto t0 = std::chrono::steady_clock::now();
+
+    chip8parallel::run(nthreads, jobs.size(), [this](chip8parallel::cursor &c) { worker(c); });
+
+    seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+    return std::all_of(jobs.begin(), jobs.end(), [](const job &j) { return j.ok; });
+}
+
+void chip8roundtrip::worker(chip8parallel::cursor &c)
+{
+    // each worker reuses its assembler and buffers for all of its ROMs
+    chip8assembler assembler(false);
+    assembler.quiet = true;
+    std::vector<uint8_t> rom, result;
+    std::string source;
+
+    for(size_t i; c.next(i); )
+    {
+        job &j = jobs[i];
+
+        // read ROM, which may fill the complete address space behind 0x200
+        std::ifstream istream(j.input.c_str(), std::ios::binary);
+        if(!istream)
+        {
+            j.errors = "ERROR: couldn't open file \"" + j.input + "\"\n";
+            continue;
+        }
+        rom.assign(std::istreambuf_iterator<char>(istream), std::istreambuf_iterator<char>());
+        if(rom.empty() || rom.size() > 0x10000 - 0x200)
+        {
+            j.errors = "ERROR: ROM is empty or doesn't fit into 64K of memory\n";
+            continue;
+        }
+        j.bytes = rom.size();
+
+        // disassemble to source in memory
+        chip8analyzer analyzer(rom.data(), rom.size());
+        analyzer.analyze();
+        char *buf = nullptr;
+        size_t len = 0;
+        FILE *out = open_memstream(&buf, &len);
+        if(!out)
+        {
+            j.errors = "ERROR: couldn't allocate source buffer\n";
+            continue;
+        }
+        analyzer.printSource(out);
+        fclose(out);
+        source.assign(buf, len);
+        free(buf);
+        if(keepSource)
+        {
+            std::ofstream ostream((j.input + ".s").c_str());
+            ostream << source;
+        }
+
+        // assemble source again and compare the result with the original ROM
+        assembler.errors.clear();
+        assembler.loadSource(source, j.input);
+        j.lines = assembler.lines();
+        if(!assembler.compile())
+        {
+            j.errors = assembler.errors;
+            continue;
+        }
+        assembler.swapEndian();
+        const uint8_t *code = reinterpret_cast<const uint8_t*>(assembler.machinecode.data());
+        result.assign(code, code + assembler.bytes());
+        auto diff = std::mismatch(rom.begin(), rom.end(), result.begin(), result.end());
+        if(diff.first != rom.end() || diff.second != result.end())
+        {
+            j.mismatch = diff.first - rom.begin();
+            j.errors = "ERROR: reassembled ROM differs at offset " + std::to_string(j.mismatch) +
+                       " (" + std::to_string(rom.size()) + " bytes original, " + std::to_string(result.size()) + " bytes reassembled)\n";
+            continue;
+        }
+        j.ok = true;
+    }
+}
+
+void chip8roundtrip::printSummary()
+{
+    size_t nBytes = 0, nLines = 0, nFailed = 0;
+    for(const job &j : jobs)
+    {
+        nBytes += j.bytes;
+        nLines += j.lines;
+        if(!j.ok) nFailed++;
+    }
+
+    printf("round trip of %zu ROMs (%zu bytes, %zu source lines) in %.3f s with %i threads: %zu identical, %zu failed\n",
+           jobs.size(), nBytes, nLines, seconds, nthreads, jobs.size() - nFailed, nFailed);
+
+    if(nFailed == 0)
+        return;
+
+    // errors of each ROM are reported in the order the ROMs were passed
+    for(const job &j : jobs)
+    {
+        if(j.ok) continue;
+        fprintf(stderr, "#### %s ####\n%s", j.input.c_str(), j.errors.c_str());
+    }
+}
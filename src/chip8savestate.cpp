@@ -0,0 +1,256 @@
+#include "chip8savestate.h"
+#include "chip8processor.h"
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// LZ4 block format: sequences of token | literal length | literals | offset | match length
+// NOTE as in LZ4 the last 5 bytes are always literals and no match starts within the last 12 bytes
+static const size_t nMinMatch = 4;
+static const size_t nLastLiterals = 5;
+static const size_t nMatchLimit = 12;
+static const int nHashBits = 12;
+
+static void putLength(std::vector<uint8_t> &dst, size_t len)
+{
+    for(; len >= 255; len -= 255)
+        dst.push_back(255);
+    dst.push_back(len);
+}
+
+static void putSequence(std::vector<uint8_t> &dst, const uint8_t *literals, size_t nLiterals, size_t offset, size_t matchLen)
+{
+    size_t m = offset ? matchLen - nMinMatch : 0;
+    dst.push_back((std::min<size_t>(nLiterals, 15) << 4) | std::min<size_t>(m, 15));
+    if(nLiterals >= 15)
+        putLength(dst, nLiterals - 15);
+    dst.insert(dst.end(), literals, literals + nLiterals);
+    if(!offset)
+        return;
+    dst.push_back(offset & 0xFF);
+    dst.push_back(offset >> 8);
+    if(m >= 15)
+        putLength(dst, m - 15);
+}
+
+size_t chip8lzCompress(const uint8_t *src, size_t len, std::vector<uint8_t> &dst)
+{
+    // greedy matching against the last position of each hashed 4 byte sequence
+    dst.clear();
+    std::vector<int64_t> table(1 << nHashBits, -1);
+    size_t anchor = 0;
+    for(size_t i = 0; i + nMatchLimit <= len; )
+    {
+        uint32_t seq;
+        std::memcpy(&seq, src + i, 4);
+        uint32_t h = (seq * 2654435761u) >> (32 - nHashBits);
+        int64_t candidate = table[h];
+        table[h] = i;
+        if(candidate < 0 || i - candidate > 0xFFFF || std::memcmp(src + candidate, src + i, nMinMatch))
+        {
+            ++i;
+            continue;
+        }
+        size_t matchLen = nMinMatch;
+        while(i + matchLen < len - nLastLiterals && src[candidate + matchLen] == src[i + matchLen])
+            ++matchLen;
+        putSequence(dst, src + anchor, i - anchor, i - candidate, matchLen);
+        i += matchLen;
+        anchor = i;
+    }
+    putSequence(dst, src + anchor, len - anchor, 0, 0);
+    return dst.size();
+}
+
+static bool getLength(const uint8_t *&p, const uint8_t *end, size_t &len)
+{
+    uint8_t b;
+    do
+    {
+        if(p == end) return false;
+        b = *p++;
+        len += b;
+    } while(b == 255);
+    return true;
+}
+
+bool chip8lzDecompress(const uint8_t *src, size_t len, uint8_t *dst, size_t dstLen)
+{
+    const uint8_t *p = src, *end = src + len;
+    size_t o = 0;
+    while(p < end)
+    {
+        uint8_t token = *p++;
+        size_t nLiterals = token >> 4;
+        if(nLiterals == 15 && !getLength(p, end, nLiterals))
+            return false;
+        if(nLiterals > size_t(end - p) || nLiterals > dstLen - o)
+            return false;
+        std::memcpy(dst + o, p, nLiterals);
+        p += nLiterals;
+        o += nLiterals;
+        if(p == end)
+            break; // last sequence has no match
+        if(end - p < 2)
+            return false;
+        size_t offset = p[0] | (p[1] << 8);
+        p += 2;
+        size_t matchLen = token & 0xF;
+        if(matchLen == 15 && !getLength(p, end, matchLen))
+            return false;
+        matchLen += nMinMatch;
+        if(offset == 0 || offset > o || matchLen > dstLen - o)
+            return false;
+        // NOTE matches may overlap the bytes they produce, so they are copied bytewise
+        for(size_t i = 0; i < matchLen; ++i, ++o)
+            dst[o] = dst[o - offset];
+    }
+    return o == dstLen;
+}
+
+bool chip8savestate::save(const chip8processor &chip8, const std::string &path, bool compress)
+{
+    std::unique_ptr<chip8state> state(new chip8state());
+    chip8.get_state(*state);
+
+    std::vector<uint8_t> packed;
+    const uint8_t *payload = reinterpret_cast<const uint8_t*>(state.get());
+    size_t size = sizeof(chip8state);
+    if(compress)
+    {
+        chip8lzCompress(payload, size, packed);
+        payload = packed.data();
+        size = packed.size();
+    }
+
+    header hdr;
+    std::memcpy(hdr.magic, "C8SS", 4);
+    hdr.version = VERSION;
+    hdr.quirks = chip8.get_quirks();
+    hdr.compressed = compress;
+    hdr.reserved = 0;
+    hdr.size = size;
+    hdr.romHash = chip8.rom_hash();
+    hdr.stateHash = chip8.state_hash();
+
+    // write next to the state and replace it at once, s.t. a crash never leaves a broken checkpoint behind
+    std::string tmp = path + ".tmp";
+    FILE *pFile = fopen(tmp.c_str(), "wb");
+    if(!pFile)
+    {
+        fprintf(stderr, "ERROR: couldn't write state \"%s\"\n", path.c_str());
+        return false;
+    }
+    bool ok = fwrite(&hdr, sizeof(header), 1, pFile) == 1;
+    ok = ok && fwrite(payload, 1, size, pFile) == size;
+    ok = fclose(pFile) == 0 && ok;
+    ok = ok && rename(tmp.c_str(), path.c_str()) == 0;
+    if(!ok)
+    {
+        fprintf(stderr, "ERROR: couldn't write state \"%s\"\n", path.c_str());
+        remove(tmp.c_str());
+    }
+    return ok;
+}
+
+chip8savestate::chip8savestate()
+    : data{nullptr}, length{0}, hdr{nullptr}, pState{nullptr}
+{
+}
+
+chip8savestate::~chip8savestate()
+{
+    close();
+}
+
+bool chip8savestate::open(const std::string &path, bool verbose)
+{
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if(fd < 0)
+    {
+        if(verbose) fprintf(stderr, "ERROR: couldn't open state \"%s\"\n", path.c_str());
+        return false;
+    }
+    struct stat st;
+    if(fstat(fd, &st) != 0 || size_t(st.st_size) < sizeof(header))
+    {
+        if(verbose) fprintf(stderr, "ERROR: \"%s\" is no valid state\n", path.c_str());
+        ::close(fd);
+        return false;
+    }
+    void *p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd); // NOTE the mapping stays valid after closing the file
+    if(p == MAP_FAILED)
+    {
+        if(verbose) fprintf(stderr, "ERROR: couldn't map state \"%s\"\n", path.c_str());
+        return false;
+    }
+    data = static_cast<const uint8_t*>(p);
+    length = st.st_size;
+
+    // validate header and registers, s.t. the state can be restored without checks
+    hdr = reinterpret_cast<const header*>(data);
+    bool valid = !std::memcmp(hdr->magic, "C8SS", 4) && hdr->version == VERSION &&
+                 sizeof(header) + uint64_t(hdr->size) <= length &&
+                 (hdr->compressed || hdr->size == sizeof(chip8state));
+    if(valid && hdr->compressed)
+    {
+        // compressed states are unpacked once, uncompressed ones are used from the mapping
+        decompressed.reset(new chip8state());
+        valid = chip8lzDecompress(data + sizeof(header), hdr->size, reinterpret_cast<uint8_t*>(decompressed.get()),
+                                  sizeof(chip8state));
+    }
+    if(valid)
+    {
+        // registers are taken over as they are, s.t. those addressing memory must stay inside of it
+        pState = hdr->compressed ? decompressed.get() : reinterpret_cast<const chip8state*>(data + sizeof(header));
+        valid = pState->registers.PC < 0x1000 && pState->registers.I < 0x1000 &&
+                pState->registers.lenProgram <= 0x1000 - 0x200;
+    }
+    if(!valid)
+    {
+        if(verbose) fprintf(stderr, "ERROR: \"%s\" is no valid state\n", path.c_str());
+        close();
+        return false;
+    }
+    return true;
+}
+
+void chip8savestate::close()
+{
+    if(data)
+        munmap(const_cast<uint8_t*>(data), length);
+    data = nullptr; length = 0; hdr = nullptr; pState = nullptr;
+    decompressed.reset();
+}
+
+bool chip8savestate::restore(chip8processor &chip8, bool verify) const
+{
+    if(!is_open())
+        return false;
+    if(chip8.rom_hash() != hdr->romHash)
+    {
+        fprintf(stderr, "ERROR: state belongs to another ROM (hash %016llx, running %016llx)\n",
+                (unsigned long long)hdr->romHash, (unsigned long long)chip8.rom_hash());
+        return false;
+    }
+    chip8.set_quirks(hdr->quirks);
+    if(!verify)
+    {
+        chip8.set_state(*pState, hdr->stateHash);
+        return true;
+    }
+    chip8.set_state(*pState);
+    if(chip8.state_hash() != hdr->stateHash)
+    {
+        fprintf(stderr, "ERROR: restored state differs from the saved one (hash %016llx, saved %016llx)\n",
+                (unsigned long long)chip8.state_hash(), (unsigned long long)hdr->stateHash);
+        return false;
+    }
+    return true;
+}
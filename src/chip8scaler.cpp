@@ -0,0 +1,212 @@
+#include "chip8scaler.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CHIP8_X86
+#endif
+
+// NOTE the leftmost pixel of a display row is its highest bit, so masks select bits from the highest downwards
+
+static void maskColorsScalar(uint64_t bits, uint32_t on, uint32_t off, uint32_t *colors)
+{
+    for(int p = 0; p < 64; ++p)
+        colors[p] = (bits >> (63 - p)) & 1 ? on : off;
+}
+
+static void decayScalar(uint8_t *intensity, uint64_t bits, int decay)
+{
+    for(int p = 0; p < 64; ++p)
+        intensity[p] = (bits >> (63 - p)) & 1 ? 255 : (intensity[p] * decay) >> 8;
+}
+
+#ifdef CHIP8_X86
+static void maskColorsSSE2(uint64_t bits, uint32_t on, uint32_t off, uint32_t *colors)
+{
+    // 4 pixels at once: broadcast their nibble, a lane is on if its bit is set
+    const __m128i select = _mm_setr_epi32(8, 4, 2, 1);
+    const __m128i vOn = _mm_set1_epi32(on), vOff = _mm_set1_epi32(off);
+    for(int p = 0; p < 64; p += 4)
+    {
+        __m128i nibble = _mm_set1_epi32((bits >> (60 - p)) & 0xF);
+        __m128i mask = _mm_cmpeq_epi32(_mm_and_si128(nibble, select), select);
+        _mm_store_si128(reinterpret_cast<__m128i*>(colors + p),
+                        _mm_or_si128(_mm_and_si128(mask, vOn), _mm_andnot_si128(mask, vOff)));
+    }
+}
+
+__attribute__((target("avx2")))
+static void maskColorsAVX2(uint64_t bits, uint32_t on, uint32_t off, uint32_t *colors)
+{
+    // 8 pixels at once: broadcast their byte, a lane is on if its bit is set
+    const __m256i select = _mm256_setr_epi32(128, 64, 32, 16, 8, 4, 2, 1);
+    const __m256i vOn = _mm256_set1_epi32(on), vOff = _mm256_set1_epi32(off);
+    for(int p = 0; p < 64; p += 8)
+    {
+        __m256i byte = _mm256_set1_epi32((bits >> (56 - p)) & 0xFF);
+        __m256i mask = _mm256_cmpeq_epi32(_mm256_and_si256(byte, select), select);
+        _mm256_store_si256(reinterpret_cast<__m256i*>(colors + p), _mm256_blendv_epi8(vOff, vOn, mask));
+    }
+}
+
+static void decaySSE2(uint8_t *intensity, uint64_t bits, int decay)
+{
+    // 16 pixels at once: bytes of lit pixels become 0xFF, the others are scaled by decay/256 in 16 bit lanes
+    const __m128i select = _mm_setr_epi8(char(0x80), 0x40, 0x20, 0x10, 8, 4, 2, 1,
+                                         char(0x80), 0x40, 0x20, 0x10, 8, 4, 2, 1);
+    const __m128i vDecay = _mm_set1_epi16(decay), zero = _mm_setzero_si128();
+    for(int p = 0; p < 64; p += 16)
+    {
+        __m128i v = _mm_unpacklo_epi64(_mm_set1_epi8(char(bits >> (56 - p))), _mm_set1_epi8(char(bits >> (48 - p))));
+        __m128i lit = _mm_cmpeq_epi8(_mm_and_si128(v, select), select);
+        __m128i i = _mm_loadu_si128(reinterpret_cast<const __m128i*>(intensity + p));
+        __m128i lo = _mm_srli_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(i, zero), vDecay), 8);
+        __m128i hi = _mm_srli_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(i, zero), vDecay), 8);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(intensity + p), _mm_or_si128(_mm_packus_epi16(lo, hi), lit));
+    }
+}
+
+static void streamSSE2(const uint32_t *line, uint32_t *dst, size_t n)
+{
+    for(size_t i = 0; i < n; i += 4)
+        _mm_stream_si128(reinterpret_cast<__m128i*>(dst + i), _mm_load_si128(reinterpret_cast<const __m128i*>(line + i)));
+}
+
+__attribute__((target("avx2")))
+static void streamAVX2(const uint32_t *line, uint32_t *dst, size_t n)
+{
+    for(size_t i = 0; i < n; i += 8)
+        _mm256_stream_si256(reinterpret_cast<__m256i*>(dst + i),
+                            _mm256_load_si256(reinterpret_cast<const __m256i*>(line + i)));
+}
+#endif
+
+chip8scaler::chip8scaler(int scale, uint32_t on, uint32_t off, int decay, isa use, bool streaming)
+    : scale{std::max(1, scale)}, on{on}, off{off}, decay{std::min(std::max(decay, 0), 255)}, use{use},
+      streaming{streaming}, intensity{}, fadingRows{0}
+{
+    // NOTE rows are 256 bytes per zoom step, so with the buffer aligned to a cache line every row is aligned for
+    // streaming stores
+    buffer = static_cast<uint32_t*>(std::aligned_alloc(64, size()));
+    line = static_cast<uint32_t*>(std::aligned_alloc(64, width() * sizeof(uint32_t)));
+    std::fill(buffer, buffer + size_t(width()) * height(), off);
+
+#ifdef CHIP8_X86
+    bool avx2 = __builtin_cpu_supports("avx2");
+    if(this->use == AUTO || (this->use == AVX2 && !avx2))
+        this->use = avx2 && this->use != SSE2 ? AVX2 : SSE2;
+#else
+    this->use = SCALAR;
+#endif
+    if(this->use == SCALAR)
+        this->streaming = false;
+
+    // colors between off and on by intensity, per channel
+    for(int i = 0; i < 256; ++i)
+    {
+        uint32_t c = 0;
+        for(int shift = 0; shift < 32; shift += 8)
+        {
+            int a = (off >> shift) & 0xFF, b = (on >> shift) & 0xFF;
+            c |= uint32_t(a + ((b - a) * i + 127) / 255) << shift;
+        }
+        palette[i] = c;
+    }
+}
+
+chip8scaler::~chip8scaler()
+{
+    std::free(buffer);
+    std::free(line);
+}
+
+const char* chip8scaler::name(isa i)
+{
+    static const char *names[] = {"auto", "scalar", "sse2", "avx2"};
+    return names[i];
+}
+
+void chip8scaler::colorRow(int row, uint64_t bits, uint32_t *colors)
+{
+    if(decay)
+    {
+        uint8_t *rowIntensity = intensity + 64 * row;
+#ifdef CHIP8_X86
+        if(use != SCALAR)
+            decaySSE2(rowIntensity, bits, decay);
+        else
+#endif
+            decayScalar(rowIntensity, bits, decay);
+        // NOTE lit pixels are at full intensity and any decay takes them below it, so a row is fading as long as it has
+        // intensities between both
+        bool fading = false;
+        for(int p = 0; p < 64; ++p)
+        {
+            colors[p] = palette[rowIntensity[p]];
+            fading |= uint8_t(rowIntensity[p] + 1) > 1;
+        }
+        fadingRows = fading ? fadingRows | (1u << row) : fadingRows & ~(1u << row);
+        return;
+    }
+#ifdef CHIP8_X86
+    if(use == AVX2)
+        maskColorsAVX2(bits, on, off, colors);
+    else if(use == SSE2)
+        maskColorsSSE2(bits, on, off, colors);
+    else
+#endif
+        maskColorsScalar(bits, on, off, colors);
+}
+
+void chip8scaler::store(uint32_t *dst, const uint32_t *src, size_t n)
+{
+#ifdef CHIP8_X86
+    if(streaming && use == AVX2)
+        streamAVX2(src, dst, n);
+    else if(streaming)
+        streamSSE2(src, dst, n);
+    else
+#endif
+        std::memcpy(dst, src, n * sizeof(uint32_t));
+}
+
+int chip8scaler::render(const uint64_t *framebuffer, uint32_t dirtyRows, uint8_t dirtyCols)
+{
+    alignas(32) uint32_t colors[64];
+    size_t w = width(), block = 8 * scale;
+    int rendered = 0;
+    // rows fading are rendered again although not written, and entirely since they may fade anywhere
+    for(uint32_t rows = dirtyRows | fadingRows; rows; rows &= rows - 1, ++rendered)
+    {
+        int row = __builtin_ctz(rows);
+        uint8_t cols = (fadingRows >> row) & 1 ? 0xFF : dirtyCols;
+        colorRow(row, framebuffer[row], colors);
+        for(int p = 0; p < 64; ++p)
+            std::fill_n(line + p * scale, scale, colors[p]);
+        // store runs of dirty column blocks, a block is 32 bytes per zoom step and so stays aligned for streaming
+        uint32_t *dst = buffer + size_t(row) * scale * w;
+        for(int y = 0; y < scale; ++y, dst += w)
+        {
+            for(int b = 0; b < 8; )
+            {
+                if(!((cols >> b) & 1))
+                {
+                    ++b;
+                    continue;
+                }
+                int e = b;
+                while(e < 8 && ((cols >> e) & 1))
+                    ++e;
+                store(dst + b * block, line + b * block, (e - b) * block);
+                b = e;
+            }
+        }
+    }
+#ifdef CHIP8_X86
+    // streaming stores are weakly ordered, they have to be visible before the buffer is handed on
+    if(streaming)
+        _mm_sfence();
+#endif
+    return rendered;
+}
@@ -0,0 +1,473 @@
+#include "chip8server.h"
+#include "chip8savestate.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace chip8protocol;
+
+// session ids are the slot in the slab of the worker and the generation of the slot above it
+static const int SLOT_BITS = 20;
+static const uint32_t SLOT_MASK = (1u << SLOT_BITS) - 1;
+// a STEP is cut to a minute of frames, s.t. one session can't hold up the others of its worker for long
+static const uint32_t MAX_STEP = 3600;
+
+chip8server::chip8server(int nWorkers, size_t nSessions)
+    : blank{true}, listener{-1}, epoll{-1}, stopping{false}, wakeup{-1}
+{
+    nWorkers = std::max(1, nWorkers);
+    size_t perWorker = std::min<size_t>(std::max<size_t>(1, (nSessions + nWorkers - 1) / nWorkers), SLOT_MASK + 1);
+    int nCores = std::max(1u, std::thread::hardware_concurrency());
+    for(int i = 0; i < nWorkers; ++i)
+    {
+        std::unique_ptr<worker> w(new worker);
+        w->core = i % nCores;
+        w->epoll = w->wakeup = -1;
+        w->slab.resize(perWorker);
+        // NOTE the lowest slots are handed out first, s.t. few sessions only touch the start of the slab
+        for(size_t s = perWorker; s-- > 0; )
+            w->freeSlots.push_back(s);
+        w->nConnections = w->requests = w->frames = w->peakSessions = 0;
+        workers.push_back(std::move(w));
+    }
+}
+
+chip8server::~chip8server()
+{
+    if(listener >= 0)
+    {
+        ::close(listener);
+        unlink(path.c_str());
+    }
+    if(epoll >= 0) ::close(epoll);
+    if(wakeup >= 0) ::close(wakeup);
+    for(std::unique_ptr<worker> &w : workers)
+    {
+        if(w->epoll >= 0) ::close(w->epoll);
+        if(w->wakeup >= 0) ::close(w->wakeup);
+    }
+}
+
+bool chip8server::listen(const std::string &path)
+{
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if(path.size() >= sizeof(addr.sun_path))
+    {
+        fprintf(stderr, "ERROR: socket path \"%s\" is too long\n", path.c_str());
+        return false;
+    }
+    std::strcpy(addr.sun_path, path.c_str());
+
+    // a socket left behind by a server which didn't end cleanly is replaced, anything else is left alone
+    struct stat st;
+    if(lstat(path.c_str(), &st) == 0)
+    {
+        if(!S_ISSOCK(st.st_mode))
+        {
+            fprintf(stderr, "ERROR: \"%s\" exists and is no socket\n", path.c_str());
+            return false;
+        }
+        unlink(path.c_str());
+    }
+    listener = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if(listener < 0 || bind(listener, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+       ::listen(listener, SOMAXCONN) != 0)
+    {
+        fprintf(stderr, "ERROR: couldn't listen on \"%s\"\n", path.c_str());
+        if(listener >= 0) ::close(listener);
+        listener = -1;
+        return false;
+    }
+    this->path = path;
+    return true;
+}
+
+void chip8server::run()
+{
+    epoll = epoll_create1(EPOLL_CLOEXEC);
+    wakeup = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.fd = listener;
+    epoll_ctl(epoll, EPOLL_CTL_ADD, listener, &ev);
+    ev.data.fd = wakeup;
+    epoll_ctl(epoll, EPOLL_CTL_ADD, wakeup, &ev);
+
+    for(std::unique_ptr<worker> &w : workers)
+    {
+        w->epoll = epoll_create1(EPOLL_CLOEXEC);
+        w->wakeup = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        ev.events = EPOLLIN;
+        ev.data.ptr = nullptr;
+        epoll_ctl(w->epoll, EPOLL_CTL_ADD, w->wakeup, &ev);
+        w->thread = std::thread(&chip8server::serve, this, std::ref(*w));
+    }
+
+    // hand connections to the workers in turn
+    size_t next = 0;
+    while(!stopping)
+    {
+        epoll_event events[2];
+        if(epoll_wait(epoll, events, 2, -1) < 0 && errno != EINTR)
+            break;
+        for(;;)
+        {
+            int fd = accept4(listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if(fd < 0)
+            {
+                if(errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+                    fprintf(stderr, "ERROR: couldn't accept connection (%s)\n", strerror(errno));
+                break;
+            }
+            worker &w = *workers[next++ % workers.size()];
+            if(!w.accepted.push(fd))
+                ::close(fd);
+            else
+                eventfd_write(w.wakeup, 1);
+        }
+    }
+
+    stopping = true;
+    for(std::unique_ptr<worker> &w : workers)
+        eventfd_write(w->wakeup, 1);
+    for(std::unique_ptr<worker> &w : workers)
+        w->thread.join();
+}
+
+void chip8server::stop()
+{
+    // NOTE only an atomic store and write() are done, which are safe in signal handlers
+    stopping = true;
+    if(wakeup >= 0)
+        eventfd_write(wakeup, 1);
+}
+
+void chip8server::serve(worker &w)
+{
+    cpu_set_t cores;
+    CPU_ZERO(&cores);
+    CPU_SET(w.core, &cores);
+    pthread_setaffinity_np(pthread_self(), sizeof(cores), &cores);
+
+    epoll_event events[256];
+    while(!stopping)
+    {
+        int n = epoll_wait(w.epoll, events, 256, -1);
+        if(n < 0 && errno != EINTR)
+            break;
+        for(int i = 0; i < n; ++i)
+        {
+            if(!events[i].data.ptr)
+            {
+                // new connections handed over by the main thread, or stopping
+                eventfd_t value;
+                eventfd_read(w.wakeup, &value);
+                int fd;
+                while(w.accepted.pop(fd))
+                {
+                    std::unique_ptr<connection> c(new connection{fd, {}, {}, 0, false, {}});
+                    epoll_event ev{};
+                    ev.events = EPOLLIN;
+                    ev.data.ptr = c.get();
+                    epoll_ctl(w.epoll, EPOLL_CTL_ADD, fd, &ev);
+                    w.connections[fd] = std::move(c);
+                    ++w.nConnections;
+                }
+                continue;
+            }
+            // NOTE a socket is reported once per epoll_wait(), so a connection closed here isn't met again in events
+            connection &c = *static_cast<connection*>(events[i].data.ptr);
+            bool ok = true;
+            if(events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+                ok = receive(w, c);
+            if(ok && (events[i].events & EPOLLOUT))
+                ok = send(w, c);
+            if(!ok)
+                close(w, c);
+        }
+    }
+    while(!w.connections.empty())
+        close(w, *w.connections.begin()->second);
+}
+
+bool chip8server::receive(worker &w, connection &c)
+{
+    uint8_t buffer[65536];
+    for(;;)
+    {
+        ssize_t n = read(c.fd, buffer, sizeof(buffer));
+        if(n > 0)
+        {
+            c.in.insert(c.in.end(), buffer, buffer + n);
+            if(size_t(n) < sizeof(buffer))
+                break;
+        }
+        else if(n == 0)
+            return false;
+        else if(errno == EAGAIN || errno == EWOULDBLOCK)
+            break;
+        else if(errno != EINTR)
+            return false;
+    }
+
+    // answer all complete requests, a malformed one ends the connection since the stream can't be followed anymore
+    size_t pos = 0;
+    while(c.in.size() - pos >= sizeof(header))
+    {
+        header req;
+        std::memcpy(&req, c.in.data() + pos, sizeof(req));
+        if(req.size < sizeof(header) || req.size > MAX_REQUEST)
+            return false;
+        if(c.in.size() - pos < req.size)
+            break;
+        handle(w, c, req, c.in.data() + pos + sizeof(header), req.size - sizeof(header));
+        pos += req.size;
+        ++w.requests;
+    }
+    c.in.erase(c.in.begin(), c.in.begin() + pos);
+    return send(w, c);
+}
+
+bool chip8server::send(worker &w, connection &c)
+{
+    while(c.outDone < c.out.size())
+    {
+        ssize_t n = ::send(c.fd, c.out.data() + c.outDone, c.out.size() - c.outDone, MSG_NOSIGNAL);
+        if(n > 0)
+            c.outDone += n;
+        else if(n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            break;
+        else if(n < 0 && errno != EINTR)
+            return false;
+    }
+
+    // wait for the socket to take more only while responses are left
+    bool left = c.outDone < c.out.size();
+    if(!left)
+    {
+        c.out.clear();
+        c.outDone = 0;
+    }
+    if(left != c.writing)
+    {
+        epoll_event ev{};
+        ev.events = left ? EPOLLIN | EPOLLOUT : EPOLLIN;
+        ev.data.ptr = &c;
+        epoll_ctl(w.epoll, EPOLL_CTL_MOD, c.fd, &ev);
+        c.writing = left;
+    }
+    return true;
+}
+
+void chip8server::reset(session &s)
+{
+    // NOTE sessions wait for input in loops, which must not end them as it ends standalone emulation
+    s.chip8 = blank;
+    s.chip8.detect_cycles(false);
+    s.chip8.set_quirks(s.quirks);
+    s.chip8.seed(s.seed);
+    std::memset(s.sent, 0, sizeof(s.sent));
+    s.halted = false;
+}
+
+chip8server::session* chip8server::find(worker &w, connection &c, uint32_t id)
+{
+    uint32_t slot = id & SLOT_MASK;
+    if(slot >= w.slab.size())
+        return nullptr;
+    session &s = w.slab[slot];
+    return s.owner == c.fd && s.generation == id >> SLOT_BITS ? &s : nullptr;
+}
+
+void chip8server::handle(worker &w, connection &c, const header &req, const uint8_t *payload, size_t n)
+{
+    // the response is built in place in the output buffer, its header is completed once the payload is known
+    size_t at = c.out.size();
+    header resp{0, req.type, OK, req.tag, req.session};
+    c.out.resize(at + sizeof(header));
+    auto append = [&c](const void *data, size_t len) {
+        const uint8_t *p = static_cast<const uint8_t*>(data);
+        c.out.insert(c.out.end(), p, p + len);
+    };
+
+    session *s = req.type == CREATE ? nullptr : find(w, c, req.session);
+    if(req.type != CREATE && !s)
+        resp.status = NO_SESSION;
+    else switch(req.type)
+    {
+    case CREATE:
+    {
+        create args;
+        if(n != sizeof(args))
+        {
+            resp.status = BAD_REQUEST;
+            break;
+        }
+        if(w.freeSlots.empty())
+        {
+            resp.status = FULL;
+            break;
+        }
+        std::memcpy(&args, payload, sizeof(args));
+        uint32_t slot = w.freeSlots.back();
+        w.freeSlots.pop_back();
+        s = &w.slab[slot];
+        s->quirks = args.quirks;
+        s->seed = args.seed;
+        reset(*s);
+        s->owner = c.fd;
+        s->commandsPerFrame = args.commandsPerFrame ? args.commandsPerFrame : 10;
+        s->loaded = false;
+        s->commands = 0;
+        resp.session = slot | s->generation << SLOT_BITS;
+        c.sessions.push_back(resp.session);
+        w.peakSessions = std::max(w.peakSessions, w.slab.size() - w.freeSlots.size());
+        break;
+    }
+    case LOAD:
+        if(n == 0 || n > MAX_ROM)
+            resp.status = BAD_REQUEST;
+        else
+        {
+            // a programme always starts from scratch, even if the session ran or halted with another one before
+            reset(*s);
+            s->chip8.load_program(payload, n);
+            s->loaded = true;
+        }
+        break;
+    case INPUT:
+    {
+        uint16_t keys;
+        if(n != sizeof(keys))
+        {
+            resp.status = BAD_REQUEST;
+            break;
+        }
+        std::memcpy(&keys, payload, sizeof(keys));
+        s->chip8.set_keys(keys);
+        break;
+    }
+    case STEP:
+    {
+        uint32_t frames;
+        if(n != sizeof(frames))
+        {
+            resp.status = BAD_REQUEST;
+            break;
+        }
+        if(!s->loaded)
+        {
+            resp.status = NO_ROM;
+            break;
+        }
+        std::memcpy(&frames, payload, sizeof(frames));
+        stepped result{0, 0, 0};
+        frames = std::min(frames, MAX_STEP);
+        while(result.frames < frames && !s->halted)
+        {
+            for(int i = 0; i < s->commandsPerFrame && !s->halted; ++i)
+            {
+                s->halted = s->chip8.fetch_command() < 0 || s->chip8.exec_command() < 0 || !s->chip8.is_running();
+                ++s->commands;
+            }
+            if(s->halted)
+                break;
+            s->chip8.tick_timers();
+            ++result.frames;
+        }
+        w.frames += result.frames;
+        result.commands = s->commands;
+        resp.status = s->halted ? HALTED : OK;
+        append(&result, sizeof(result));
+        break;
+    }
+    case FRAME:
+    {
+        if(n != 0)
+        {
+            resp.status = BAD_REQUEST;
+            break;
+        }
+        // rows differing from the display sent last, compared in full since dirty rows only say what was drawn
+        const uint64_t *fb = s->chip8.framebuffer();
+        uint32_t rows = 0;
+        for(int r = 0; r < 32; ++r)
+            rows |= uint32_t(fb[r] != s->sent[r]) << r;
+        append(&rows, sizeof(rows));
+        for(uint32_t left = rows; left; left &= left - 1)
+        {
+            int r = __builtin_ctz(left);
+            append(&fb[r], sizeof(uint64_t));
+            s->sent[r] = fb[r];
+        }
+        break;
+    }
+    case SNAPSHOT:
+    {
+        if(n != 0)
+        {
+            resp.status = BAD_REQUEST;
+            break;
+        }
+        uint64_t hash = s->chip8.state_hash();
+        append(&hash, sizeof(hash));
+        size_t state = c.out.size();
+        c.out.resize(state + sizeof(chip8state));
+        chip8state st;
+        s->chip8.get_state(st);
+        std::memcpy(c.out.data() + state, &st, sizeof(st));
+        break;
+    }
+    case DESTROY:
+        c.sessions.erase(std::find(c.sessions.begin(), c.sessions.end(), req.session));
+        s->owner = -1;
+        s->generation = (s->generation + 1) & (0xFFFFFFFFu >> SLOT_BITS);
+        w.freeSlots.push_back(&*s - w.slab.data());
+        break;
+    default:
+        resp.status = BAD_REQUEST;
+        break;
+    }
+
+    resp.size = c.out.size() - at;
+    std::memcpy(c.out.data() + at, &resp, sizeof(resp));
+}
+
+void chip8server::close(worker &w, connection &c)
+{
+    for(uint32_t id : c.sessions)
+    {
+        session &s = w.slab[id & SLOT_MASK];
+        s.owner = -1;
+        s.generation = (s.generation + 1) & (0xFFFFFFFFu >> SLOT_BITS);
+        w.freeSlots.push_back(id & SLOT_MASK);
+    }
+    epoll_ctl(w.epoll, EPOLL_CTL_DEL, c.fd, nullptr);
+    ::close(c.fd);
+    w.connections.erase(c.fd); // NOTE destroys c
+}
+
+void chip8server::print(FILE *out) const
+{
+    uint64_t connections = 0, requests = 0, frames = 0;
+    size_t peak = 0, slots = 0;
+    for(const std::unique_ptr<worker> &w : workers)
+    {
+        connections += w->nConnections;
+        requests += w->requests;
+        frames += w->frames;
+        peak += w->peakSessions;
+        slots += w->slab.size();
+    }
+    fprintf(out, "server: workers=%zu slots=%zu connections=%llu requests=%llu frames=%llu peak_sessions=%zu\n",
+            workers.size(), slots, (unsigned long long)connections, (unsigned long long)requests,
+            (unsigned long long)frames, peak);
+}
@@ -0,0 +1,158 @@
+#include "chip8shm.h"
+#include "chip8processor.h"
+#include "chip8supervisor.h"
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "sequence of chip8shm must be lock-free to be shared");
+
+// shm_open() takes names of a single leading slash
+static std::string segmentName(const std::string &name)
+{
+    return !name.empty() && name[0] == '/' ? name : "/" + name;
+}
+
+chip8shm::chip8shm()
+    : hdr{nullptr}, owner{false}
+{
+}
+
+chip8shm::~chip8shm()
+{
+    close();
+}
+
+bool chip8shm::create(const std::string &name, const std::string &rom, const chip8processor &chip8,
+                      int commandsPerFrame)
+{
+    close();
+    this->name = segmentName(name);
+    int fd = shm_open(this->name.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if(fd < 0 || ftruncate(fd, sizeof(header)) != 0)
+    {
+        fprintf(stderr, "ERROR: couldn't create shared memory \"%s\"\n", this->name.c_str());
+        if(fd >= 0)
+        {
+            ::close(fd);
+            shm_unlink(this->name.c_str());
+        }
+        return false;
+    }
+    void *p = mmap(nullptr, sizeof(header), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd); // NOTE the mapping stays valid after closing the segment
+    if(p == MAP_FAILED)
+    {
+        fprintf(stderr, "ERROR: couldn't map shared memory \"%s\"\n", this->name.c_str());
+        shm_unlink(this->name.c_str());
+        return false;
+    }
+    hdr = static_cast<header*>(p);
+    owner = true;
+
+    // NOTE the segment is zeroed by ftruncate(), i.e. the sequence starts at 0 and the snapshot is blank
+    std::memcpy(hdr->magic, "C8SH", 4);
+    hdr->version = VERSION;
+    hdr->size = sizeof(header);
+    hdr->pid = getpid();
+    hdr->romHash = chip8.rom_hash();
+    hdr->quirks = chip8.get_quirks();
+    hdr->commandsPerFrame = commandsPerFrame;
+    size_t slash = rom.rfind('/');
+    std::strncpy(hdr->rom, rom.c_str() + (slash == std::string::npos ? 0 : slash + 1), sizeof(hdr->rom) - 1);
+    return true;
+}
+
+void chip8shm::publish(const chip8processor &chip8, const chip8supervisor &supervisor)
+{
+    // the odd sequence has to be visible before any of the snapshot and the snapshot before the even one
+    uint64_t seq = hdr->sequence.load(std::memory_order_relaxed);
+    hdr->sequence.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    snapshot &s = hdr->data;
+    std::memcpy(s.framebuffer, chip8.framebuffer(), sizeof(s.framebuffer));
+    std::memcpy(s.V, chip8.registers(), sizeof(s.V));
+    std::memcpy(s.stack, chip8.call_stack(), sizeof(s.stack));
+    s.PC = chip8.program_counter();
+    s.I = chip8.index_register();
+    s.DT = chip8.delay_timer();
+    s.ST = chip8.sound_timer();
+    s.SP = chip8.stack_pointer();
+    s.reason = supervisor.exit_reason();
+    s.keys = chip8.get_keys();
+    s.commands = supervisor.commands;
+    s.frames = supervisor.frames;
+    s.displayChanges = supervisor.displayChanges;
+    s.stateHash = chip8.state_hash();
+
+    hdr->sequence.store(seq + 2, std::memory_order_release);
+}
+
+bool chip8shm::attach(const std::string &name)
+{
+    close();
+    this->name = segmentName(name);
+    int fd = shm_open(this->name.c_str(), O_RDONLY, 0);
+    if(fd < 0)
+    {
+        fprintf(stderr, "ERROR: couldn't open shared memory \"%s\"\n", this->name.c_str());
+        return false;
+    }
+    struct stat st;
+    if(fstat(fd, &st) != 0 || size_t(st.st_size) < sizeof(header))
+    {
+        fprintf(stderr, "ERROR: \"%s\" is no chip8 shared memory\n", this->name.c_str());
+        ::close(fd);
+        return false;
+    }
+    void *p = mmap(nullptr, sizeof(header), PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if(p == MAP_FAILED)
+    {
+        fprintf(stderr, "ERROR: couldn't map shared memory \"%s\"\n", this->name.c_str());
+        return false;
+    }
+    hdr = static_cast<header*>(p);
+    if(std::memcmp(hdr->magic, "C8SH", 4) || hdr->version != VERSION || hdr->size != sizeof(header))
+    {
+        fprintf(stderr, "ERROR: \"%s\" is no chip8 shared memory\n", this->name.c_str());
+        close();
+        return false;
+    }
+    return true;
+}
+
+void chip8shm::close()
+{
+    if(!hdr)
+        return;
+    munmap(hdr, sizeof(header));
+    // NOTE readers attached keep their mapping, they only can't attach anymore
+    if(owner)
+        shm_unlink(name.c_str());
+    hdr = nullptr;
+    owner = false;
+}
+
+int chip8shm::read(snapshot &s) const
+{
+    // a publisher takes well below a microsecond for a snapshot, so a reader only gives up if it died while writing
+    const int maxAttempts = 100000;
+    for(int attempts = 1; attempts <= maxAttempts; ++attempts)
+    {
+        uint64_t seq = hdr->sequence.load(std::memory_order_acquire);
+        if(!(seq & 1))
+        {
+            std::memcpy(&s, &hdr->data, sizeof(s));
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if(hdr->sequence.load(std::memory_order_relaxed) == seq)
+                return attempts;
+        }
+        std::this_thread::yield();
+    }
+    return 0;
+}
@@ -0,0 +1,133 @@
+#include "chip8supervisor.h"
+#include <cstring>
+
+chip8supervisor::chip8supervisor(chip8processor &chip8, const conditions &cond)
+    : commands{0}, frames{0}, displayChanges{0}, chip8(chip8), cond(cond), why{RUNNING}, commandsInFrame{0},
+      idleFrames{0}, frameDirtyRows{0xFFFFFFFF}, frameDirtyCols{0xFF}, lastPC{0}, start{std::chrono::steady_clock::now()}, seconds{0}
+{
+    std::memcpy(lastDisplay, chip8.framebuffer(), sizeof(lastDisplay));
+    chip8.detect_cycles(cond.steadyState);
+}
+
+bool chip8supervisor::before_exec(int PC)
+{
+    if(PC < 0)
+    {
+        stop(ERROR);
+        return false;
+    }
+    lastPC = PC;
+    if(cond.breakpoint >= 0 && PC == cond.breakpoint)
+    {
+        stop(BREAKPOINT);
+        return false;
+    }
+    if(cond.selfJump && chip8.current_command() == (0x1000 | PC))
+    {
+        stop(SELF_JUMP);
+        return false;
+    }
+    return true;
+}
+
+bool chip8supervisor::after_exec(int result)
+{
+    ++commands;
+    lastPC = chip8.program_counter();
+    if(result < 0)
+    {
+        stop(ERROR);
+        return false;
+    }
+    if(!chip8.is_running())
+    {
+        // the processor only stops by itself on errors and in infinite loops
+        stop(chip8.cycle_period() ? STEADY_STATE : ERROR);
+        return false;
+    }
+
+    // end of frame: tick timers and compare display with the one of the last frame
+    if(cond.commandsPerFrame > 0 && ++commandsInFrame == cond.commandsPerFrame)
+    {
+        commandsInFrame = 0;
+        ++frames;
+        chip8.tick_timers();
+        // only rows written during the frame are compared, most frames write none or a few
+        frameDirtyRows = chip8.dirty_rows();
+        frameDirtyCols = chip8.dirty_columns();
+        chip8.clear_dirty();
+        bool changed = false;
+        for(uint32_t rows = frameDirtyRows; rows; rows &= rows - 1)
+        {
+            int r = __builtin_ctz(rows);
+            changed = changed || lastDisplay[r] != chip8.framebuffer()[r];
+            lastDisplay[r] = chip8.framebuffer()[r];
+        }
+        if(changed)
+        {
+            ++displayChanges;
+            idleFrames = 0;
+        }
+        else if(cond.idleFrames > 0 && ++idleFrames >= cond.idleFrames)
+        {
+            stop(IDLE_DISPLAY);
+            return false;
+        }
+    }
+
+    if(cond.maxCommands > 0 && commands >= cond.maxCommands)
+    {
+        stop(BUDGET);
+        return false;
+    }
+    return true;
+}
+
+void chip8supervisor::stop(reason r)
+{
+    if(why != RUNNING)
+        return;
+    why = r;
+    seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+const char* chip8supervisor::name(reason r)
+{
+    static const char *names[NUM_REASONS] = {
+        "running", "error", "self-jump", "steady-state", "idle-display", "breakpoint", "budget", "interrupted",
+        "end-of-movie", "desync"
+    };
+    return r < NUM_REASONS ? names[r] : "unknown";
+}
+
+int chip8supervisor::exit_code() const
+{
+    switch(why)
+    {
+    case SELF_JUMP:
+    case STEADY_STATE:
+    case IDLE_DISPLAY:
+    case BREAKPOINT:
+    case END_OF_MOVIE:
+        return 0;
+    case BUDGET:
+        return 2;
+    case INTERRUPTED:
+        return 3;
+    case DESYNC:
+        return 4;
+    default:
+        return 1;
+    }
+}
+
+void chip8supervisor::print(FILE *out) const
+{
+    double s = why == RUNNING ? std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() : seconds;
+    fprintf(out, "exit: reason=%s pc=0x%03x commands=%llu frames=%llu display_changes=%llu", name(why), lastPC,
+            (unsigned long long)commands, (unsigned long long)frames, (unsigned long long)displayChanges);
+    if(why == STEADY_STATE)
+        fprintf(out, " period=%llu", (unsigned long long)chip8.cycle_period());
+    fprintf(out, " state=%016llx time=%.3fs rate=%.0f/s\n", (unsigned long long)chip8.state_hash(), s,
+            s > 0 ? commands / s : 0.0);
+}
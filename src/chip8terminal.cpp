@@ -0,0 +1,133 @@
+#include "chip8terminal.h"
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+
+// UTF-8 of the glyph showing a cell, indexed by top pixel | bottom pixel << 1
+static const char *glyphs[4] = {" ", "\xe2\x96\x80", "\xe2\x96\x84", "\xe2\x96\x88"};
+static const size_t glyphSize[4] = {1, 3, 3, 3};
+
+static int glyphOf(const uint64_t *framebuffer, int row, int col)
+{
+    return ((framebuffer[2*row] >> (63 - col)) & 1) | (((framebuffer[2*row + 1] >> (63 - col)) & 1) << 1);
+}
+
+chip8terminal::chip8terminal(int fd)
+    : fd{fd}, opened{false}, shown{}, cursorRow{-1}, cursorCol{-1}, frames{0}, presented{0}, skipped{0}, bytes{0}
+{
+    out.reserve(4096);
+}
+
+chip8terminal::~chip8terminal()
+{
+    close();
+}
+
+bool chip8terminal::open()
+{
+    // a cleared terminal shows a blank display, so that is what the first frame is compared with
+    out = "\033[2J\033[?25l";
+    std::memset(shown, 0, sizeof(shown));
+    cursorRow = cursorCol = -1;
+    opened = flush();
+    if(!opened)
+        fprintf(stderr, "ERROR: couldn't write to terminal\n");
+    return opened;
+}
+
+void chip8terminal::close()
+{
+    if(!opened)
+        return;
+    out = "\033[" + std::to_string(ROWS + 1) + ";1H\033[?25h";
+    flush();
+    opened = false;
+}
+
+bool chip8terminal::flush()
+{
+    // NOTE a terminal takes everything at once unless interrupted, the loop only continues partial writes
+    for(size_t done = 0; done < out.size(); )
+    {
+        ssize_t n = write(fd, out.data() + done, out.size() - done);
+        if(n < 0 && errno != EINTR)
+            return false;
+        if(n > 0) done += n;
+    }
+    bytes += out.size();
+    return true;
+}
+
+void chip8terminal::put(int glyph)
+{
+    out.append(glyphs[glyph], glyphSize[glyph]);
+    // NOTE the cursor stays on the last column after drawing it, so its position is unknown thereafter
+    if(++cursorCol == COLS)
+        cursorRow = cursorCol = -1;
+}
+
+void chip8terminal::moveTo(const uint64_t *framebuffer, int row, int col)
+{
+    if(row == cursorRow && col == cursorCol)
+        return;
+    if(row == cursorRow && col > cursorCol)
+    {
+        // skip unchanged cells by drawing them again if that is shorter than moving the cursor forward
+        int gap = col - cursorCol;
+        size_t redraw = 0;
+        for(int c = cursorCol; c < col; ++c)
+            redraw += glyphSize[glyphOf(framebuffer, row, c)];
+        size_t move = gap == 1 ? 3 : 3 + std::to_string(gap).size();
+        if(redraw <= move)
+        {
+            for(int c = cursorCol; c < col; ++c)
+                put(glyphOf(framebuffer, row, c));
+            return;
+        }
+        out += gap == 1 ? "\033[C" : "\033[" + std::to_string(gap) + "C";
+    }
+    else
+        out += "\033[" + std::to_string(row + 1) + ";" + std::to_string(col + 1) + "H";
+    cursorRow = row;
+    cursorCol = col;
+}
+
+size_t chip8terminal::present(const uint64_t *framebuffer, uint32_t dirtyRows)
+{
+    ++frames;
+    if(!dirtyRows)
+    {
+        ++skipped;
+        return 0;
+    }
+    out.clear();
+    for(int r = 0; r < ROWS; ++r)
+    {
+        if(!((dirtyRows >> (2*r)) & 3))
+            continue;
+        // cells of both pixel rows in one word, the leftmost cell is the highest bit
+        uint64_t changed = (shown[2*r] ^ framebuffer[2*r]) | (shown[2*r + 1] ^ framebuffer[2*r + 1]);
+        while(changed)
+        {
+            int c = __builtin_clzll(changed);
+            changed &= ~(1ULL << (63 - c));
+            moveTo(framebuffer, r, c);
+            put(glyphOf(framebuffer, r, c));
+        }
+        shown[2*r] = framebuffer[2*r];
+        shown[2*r + 1] = framebuffer[2*r + 1];
+    }
+    if(out.empty())
+        return 0;
+    if(!flush())
+        return 0;
+    ++presented;
+    return out.size();
+}
+
+void chip8terminal::print(FILE *out) const
+{
+    fprintf(out, "display: frames=%llu presented=%llu skipped=%llu bytes=%llu bytes_per_presented=%.1f\n",
+            (unsigned long long)frames, (unsigned long long)presented, (unsigned long long)skipped,
+            (unsigned long long)bytes, presented ? double(bytes) / presented : 0.0);
+}
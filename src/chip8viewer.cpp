@@ -0,0 +1,163 @@
+#include "chip8shm.h"
+#include "chip8supervisor.h"
+#include "chip8terminal.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <thread>
+
+/* function prototypes */
+bool parseArgs(int argc, char** argv);
+void printUsage();
+void onInterrupt(int);
+void printSnapshot(const chip8shm &shm, const chip8shm::snapshot &s, bool alive);
+
+/* globals */
+std::string strName = "chip8";
+int nFps = 30;
+bool bOnce = false;
+volatile sig_atomic_t bInterrupted = 0;
+
+int main(int argc, char** argv)
+{
+    // read in args from command line
+    if(!parseArgs(argc, argv))
+        return EXIT_FAILURE;
+
+    chip8shm shm;
+    if(!shm.attach(strName))
+        return EXIT_FAILURE;
+    chip8shm::snapshot s{};
+
+    // print a single snapshot as KEY=VALUE lines, e.g. for scripts scraping instances
+    if(bOnce)
+    {
+        if(!shm.read(s))
+        {
+            fprintf(stderr, "ERROR: publisher died while writing a snapshot\n");
+            return EXIT_FAILURE;
+        }
+        printf("rom=%s\npid=%d\nrunning=%d\nreason=%s\n", shm.info()->rom, shm.info()->pid,
+               s.reason == chip8supervisor::RUNNING, chip8supervisor::name(chip8supervisor::reason(s.reason)));
+        printf("frames=%llu\ncommands=%llu\ndisplay_changes=%llu\nstate=%016llx\n", (unsigned long long)s.frames,
+               (unsigned long long)s.commands, (unsigned long long)s.displayChanges, (unsigned long long)s.stateHash);
+        printf("pc=0x%03x\ni=0x%03x\nsp=%u\ndt=%u\nst=%u\nkeys=0x%04x\n", s.PC, s.I, s.SP, s.DT, s.ST, s.keys);
+        for(int r = 0; r < 16; ++r)
+            printf("v%x=0x%02x\n", r, s.V[r]);
+        return EXIT_SUCCESS;
+    }
+
+    chip8terminal terminal;
+    if(!terminal.open())
+        return EXIT_FAILURE;
+    signal(SIGINT, onInterrupt);
+
+    // draw whenever the sequence moved on, an idle emulator costs the viewer no more than reading it
+    uint64_t shown = ~0ull;
+    bool alive = true;
+    auto period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<double>(1.0 / std::max(1, nFps)));
+    auto next = std::chrono::steady_clock::now();
+    while(!bInterrupted)
+    {
+        uint64_t seq = shm.sequence();
+        if(seq != shown)
+        {
+            if(!shm.read(s))
+            {
+                alive = false;
+                break;
+            }
+            terminal.present(s.framebuffer);
+            printSnapshot(shm, s, true);
+            shown = seq;
+        }
+        // NOTE a publisher killed doesn't publish its end, so it is asked for besides
+        alive = kill(shm.info()->pid, 0) == 0 || errno != ESRCH;
+        if(s.reason != chip8supervisor::RUNNING || !alive)
+            break;
+        next += period;
+        std::this_thread::sleep_until(next);
+    }
+    printSnapshot(shm, s, alive);
+    terminal.close();
+    printf("\033[%d;1H", chip8terminal::ROWS + 4);
+    return EXIT_SUCCESS;
+}
+
+void onInterrupt(int)
+{
+    bInterrupted = 1;
+}
+
+void printSnapshot(const chip8shm &shm, const chip8shm::snapshot &s, bool alive)
+{
+    // status below the display, each line is cleared to its end since it may have been longer before
+    const char *status = !alive ? "gone" : s.reason == chip8supervisor::RUNNING ? "running"
+                                : chip8supervisor::name(chip8supervisor::reason(s.reason));
+    printf("\033[%d;1H%s (pid %d) %s  frames %llu  commands %llu  display changes %llu\033[K\n", chip8terminal::ROWS + 1,
+           shm.info()->rom, shm.info()->pid, status, (unsigned long long)s.frames, (unsigned long long)s.commands,
+           (unsigned long long)s.displayChanges);
+    printf("PC %03x  I %03x  SP %x  DT %02x  ST %02x  keys %04x  state %016llx\033[K\n", s.PC, s.I, s.SP, s.DT, s.ST,
+           s.keys, (unsigned long long)s.stateHash);
+    for(int r = 0; r < 16; ++r)
+        printf("V%X %02x ", r, s.V[r]);
+    printf("\033[K");
+    fflush(stdout);
+}
+
+bool parseArgs(int argc, char** argv)
+{
+    // parse commandline arguments
+    for (int i = 1; i < argc; ++i)
+    {
+        // print usage on demand
+        if(!std::strcmp(argv[i], "-h") || !std::strcmp(argv[i], "--help"))
+        {
+            printUsage();
+            return false;
+        }
+        // check for name of the segment
+        if(!std::strcmp(argv[i], "-n") || !std::strcmp(argv[i], "--name"))
+        {
+            i++;
+            if(i < argc)
+            {
+                strName = argv[i];
+            }
+            else
+                return false;
+        }
+        // check for refresh rate
+        if(!std::strcmp(argv[i], "-F") || !std::strcmp(argv[i], "--fps"))
+        {
+            i++;
+            if(i < argc)
+            {
+                nFps = atoi(argv[i]);
+            }
+            else
+                return false;
+        }
+        // check for printing a single snapshot
+        if(!std::strcmp(argv[i], "-1") || !std::strcmp(argv[i], "--once"))
+        {
+            bOnce = true;
+        }
+    }
+
+    return true;
+}
+
+void printUsage()
+{
+    printf("Usage: chip8-viewer [OPTION]...\n");
+    printf("Shows an emulator publishing itself by \"chip8-emulate -P NAME\" in the terminal till it stops.\n");
+    printf("\nOptions:\n");
+    printf("-h --help                                print usage\n");
+    printf("-n --name NAME                           shared memory segment to attach to (default: chip8)\n");
+    printf("-F --fps N                               refresh rate (default: 30)\n");
+    printf("-1 --once                                print a snapshot as KEY=VALUE lines instead and exit\n");
+}